@@ -0,0 +1,147 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdint>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "common.h"
+
+// Сегмент общей памяти, растущий по требованию.
+// В начале сегмента лежит SharedMemory (кольцо, слоты клиентов, таблица кусков),
+// за ним - куски таблицы игр, которые сервер добавляет в конец через ftruncate.
+// Адресное пространство под весь предел арены резервируется сразу (PROT_NONE),
+// выросшая часть домапливается поверх резерва на то же место: указатели
+// в сегмент (слоты, игры) при росте не меняются. О росте сервер сообщает
+// через SharedMemory::arenaGeneration, клиент по ней домапливает хвост (refresh).
+class SharedArena {
+public:
+    SharedArena() : fd(-1), base(nullptr), mapped(0), generation(0) {}
+
+    ~SharedArena() {
+        close();
+    }
+
+    // Сервер: создаем сегмент с одним заголовком
+    bool create(const char* name) {
+        fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+        if (fd == -1) {
+            return false;
+        }
+        uint64_t size = headerSize();
+        if (ftruncate(fd, (off_t)size) == -1 || !reserve() || !mapUpTo(size)) {
+            close();
+            return false;
+        }
+        memory()->arenaSize.store(size, std::memory_order_relaxed);
+        memory()->arenaGeneration.store(0, std::memory_order_release);
+        return true;
+    }
+
+    // Клиент: подключаемся к сегменту сервера
+    bool open(const char* name) {
+        fd = shm_open(name, O_RDWR, 0666);
+        if (fd == -1) {
+            return false;
+        }
+        if (!reserve() || !mapUpTo(headerSize()) || !refresh()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    SharedMemory* memory() const {
+        return reinterpret_cast<SharedMemory*>(base);
+    }
+
+    // Сервер: отводим в конце сегмента size байт (с точностью до страницы).
+    // Возвращает смещение от начала сегмента, 0 - предел арены или ошибка.
+    // Вызывается под мьютексом роста сервера
+    uint64_t grow(size_t size) {
+        uint64_t offset = mapped;
+        uint64_t newSize = offset + pageAlign(size);
+        if (newSize > reserveSize() || ftruncate(fd, (off_t)newSize) == -1 || !mapUpTo(newSize)) {
+            return 0;
+        }
+        memory()->arenaSize.store(newSize, std::memory_order_relaxed);
+        generation = memory()->arenaGeneration.load(std::memory_order_relaxed) + 1;
+        memory()->arenaGeneration.store(generation, std::memory_order_release);
+        return offset;
+    }
+
+    // Клиент: если сервер вырастил сегмент, домапливаем новый хвост
+    bool refresh() {
+        uint32_t current = memory()->arenaGeneration.load(std::memory_order_acquire);
+        if (current == generation) {
+            return true;
+        }
+        if (!mapUpTo(memory()->arenaSize.load(std::memory_order_relaxed))) {
+            return false;
+        }
+        generation = current;
+        return true;
+    }
+
+    void close() {
+        if (base != nullptr) {
+            munmap(base, reserveSize());
+            base = nullptr;
+        }
+        if (fd != -1) {
+            ::close(fd);
+            fd = -1;
+        }
+        mapped = 0;
+        generation = 0;
+    }
+
+    // Предел арены: заголовок и все куски таблицы игр
+    static uint64_t reserveSize() {
+        return headerSize() + (uint64_t)MAX_GAME_CHUNKS * pageAlign(MAX_GAME_CHUNK_BYTES);
+    }
+
+private:
+    static uint64_t pageAlign(uint64_t size) {
+        uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+        return (size + page - 1) / page * page;
+    }
+
+    static uint64_t headerSize() {
+        return pageAlign(sizeof(SharedMemory));
+    }
+
+    bool reserve() {
+        void* address = mmap(nullptr, reserveSize(), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+        base = static_cast<char*>(address);
+        return true;
+    }
+
+    // Отображаем сегмент до size байт: только хвост, уже отображенное не трогаем
+    bool mapUpTo(uint64_t size) {
+        if (size <= mapped) {
+            return true;
+        }
+        if (size > reserveSize()) {
+            return false;
+        }
+        void* address = mmap(base + mapped, size - mapped, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_FIXED, fd, (off_t)mapped);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+        mapped = size;
+        return true;
+    }
+
+    int fd;
+    char* base;           // Начало резерва = начало сегмента
+    uint64_t mapped;      // Сколько байт сегмента отображено
+    uint32_t generation;  // arenaGeneration, до которой домаплено
+};
+
+#endif // ARENA_H
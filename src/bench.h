@@ -0,0 +1,91 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+// Общая обвязка бенчмарков и проверок (цели make рядом с сервером): разбор
+// позиционных аргументов с проверкой и замер времени. Неверный аргумент -
+// строка использования и выход с кодом 1.
+
+// Секундомер: время с создания или с последнего restart()
+class Stopwatch {
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    void restart() {
+        start = std::chrono::steady_clock::now();
+    }
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double microseconds() const {
+        return seconds() * 1e6;
+    }
+
+    double nanoseconds() const {
+        return seconds() * 1e9;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Позиционные аргументы: args.integer(1, 1000, 1) - первый аргумент, по
+// умолчанию 1000, не меньше 1
+class BenchArgs {
+public:
+    BenchArgs(int argc, char* argv[], const char* usage) : argc(argc), argv(argv), usage(usage) {}
+
+    int count() const {
+        return argc;
+    }
+
+    const char* text(int index, const char* defaultValue) const {
+        return index < argc ? argv[index] : defaultValue;
+    }
+
+    long integer(int index, long defaultValue, long minimum, long maximum = LONG_MAX) const {
+        if (index >= argc) {
+            return defaultValue;
+        }
+        char* end;
+        errno = 0;
+        long value = strtol(argv[index], &end, 10);
+        if (errno != 0 || end == argv[index] || *end != '\0' || value < minimum || value > maximum) {
+            fail();
+        }
+        return value;
+    }
+
+    uint64_t seed(int index, uint64_t defaultValue) const {
+        if (index >= argc) {
+            return defaultValue;
+        }
+        char* end;
+        errno = 0;
+        unsigned long long value = strtoull(argv[index], &end, 10);
+        if (errno != 0 || end == argv[index] || *end != '\0') {
+            fail();
+        }
+        return value;
+    }
+
+    [[noreturn]] void fail() const {
+        std::cerr << "Usage: " << argv[0] << " " << usage << std::endl;
+        exit(1);
+    }
+
+private:
+    int argc;
+    char** argv;
+    const char* usage;
+};
+
+#endif // BENCH_H
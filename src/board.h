@@ -0,0 +1,186 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include "common.h"
+
+// Правила игры на одном поле: расстановка кораблей и обработка выстрелов.
+// Без ввода-вывода, используется и сервером, и клиентом.
+
+// Положение корабля на поле: его клетки (footprint) и ореол (сами клетки плюс соседи)
+template <class Mask>
+struct ShipPosition {
+    Mask footprint;
+    Mask halo;
+};
+
+// Все положения кораблей варианта: [длина][0 - горизонтально, 1 - вертикально][клетка начала].
+// Положения, где корабль не помещается, - нулевые. starts - клетки, с которых
+// корабль такой длины и ориентации помещается на поле
+template <class Rules>
+struct PlacementTable {
+    typedef typename Rules::Mask Mask;
+
+    ShipPosition<Mask> positions[BATTLESHIP + 1][2][Rules::CELLS];
+    Mask starts[BATTLESHIP + 1][2];
+};
+
+template <class Rules>
+constexpr PlacementTable<Rules> buildPlacementTable() {
+    PlacementTable<Rules> table = {};
+    for (int length = SUBMARINE; length <= BATTLESHIP; length++) {
+        for (int orientation = 0; orientation < 2; orientation++) {
+            bool horizontal = orientation == 0;
+            for (int y = 0; y < Rules::SIZE; y++) {
+                for (int x = 0; x < Rules::SIZE; x++) {
+                    if ((horizontal ? x : y) + length > Rules::SIZE) {
+                        continue;
+                    }
+                    ShipPosition<typename Rules::Mask>& position = table.positions[length][orientation][y * Rules::SIZE + x];
+                    for (int i = -1; i <= length; i++) {
+                        for (int j = -1; j <= 1; j++) {
+                            int cellX = horizontal ? x + i : x + j;
+                            int cellY = horizontal ? y + j : y + i;
+                            if (cellX < 0 || cellX >= Rules::SIZE || cellY < 0 || cellY >= Rules::SIZE) {
+                                continue;
+                            }
+                            position.halo |= cellBit<Rules>(cellX, cellY);
+                            if (j == 0 && i >= 0 && i < length) {
+                                position.footprint |= cellBit<Rules>(cellX, cellY);
+                            }
+                        }
+                    }
+                    table.starts[length][orientation] |= cellBit<Rules>(x, y);
+                }
+            }
+        }
+    }
+    return table;
+}
+
+// Таблица каждого варианта считается при компиляции
+template <class Rules>
+inline constexpr PlacementTable<Rules> g_placementTable = buildPlacementTable<Rules>();
+
+// Положение корабля по таблице; нулевое, если корабль не помещается на поле
+template <class Rules>
+inline const ShipPosition<typename Rules::Mask>& shipPosition(int x, int y, int length, bool horizontal) {
+    static constexpr ShipPosition<typename Rules::Mask> outside = {};
+    if (x < 0 || y < 0 || x >= Rules::SIZE || y >= Rules::SIZE || length < SUBMARINE || length > BATTLESHIP) {
+        return outside;
+    }
+    return g_placementTable<Rules>.positions[length][horizontal ? 0 : 1][y * Rules::SIZE + x];
+}
+
+// Размещение корабля на поле: границы и соседей проверяем пересечением масок из таблицы
+template <class Rules>
+inline bool placeShip(GameBoard<Rules>& board, int x, int y, int length, bool horizontal) {
+    const ShipPosition<typename Rules::Mask>& position = shipPosition<Rules>(x, y, length, horizontal);
+    if (position.footprint == 0) {
+        return false; // корабль не помещается на поле
+    }
+
+    // Проверка пересечения с другими кораблями (включая соседние клетки)
+    if (position.halo & board.shipMask) {
+        return false;
+    }
+
+    // Размещаем корабль на поле
+    if (board.shipsPlaced >= Rules::TOTAL_SHIPS) {
+        return false; // все корабли уже размещены
+    }
+
+    int id = board.shipsPlaced;
+    board.ships[id].x = x;
+    board.ships[id].y = y;
+    board.ships[id].length = length;
+    board.ships[id].horizontal = horizontal;
+    board.ships[id].hits = 0;
+    board.shipMask |= position.footprint;
+    for (int i = 0; i < length; i++) {
+        board.shipAt[horizontal ? y * Rules::SIZE + x + i : (y + i) * Rules::SIZE + x] = (uint8_t)(id + 1);
+    }
+
+    board.shipsPlaced++;
+    return true;
+}
+
+// Остались ли у игрока неразмещенные корабли такой длины
+template <class Rules>
+inline bool canPlaceShipOfLength(const GameBoard<Rules>& board, int length) {
+    if (length < SUBMARINE || length > BATTLESHIP) {
+        return false;
+    }
+    int placed = 0;
+    for (int i = 0; i < board.shipsPlaced; i++) {
+        placed += board.ships[i].length == length;
+    }
+    return placed < Rules::shipCount(length);
+}
+
+// Проверка, что все корабли размещены
+template <class Rules>
+inline bool areAllShipsPlaced(const GameBoard<Rules>& board) {
+    int actual[BATTLESHIP + 1] = {0}; // Индекс - длина корабля
+
+    for (int i = 0; i < board.shipsPlaced; i++) {
+        if (board.ships[i].length >= SUBMARINE && board.ships[i].length <= BATTLESHIP) {
+            actual[board.ships[i].length]++;
+        }
+    }
+
+    for (int length = SUBMARINE; length <= BATTLESHIP; length++) {
+        if (actual[length] != Rules::shipCount(length)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Номер корабля, занимающего клетку, -1 - клетка пуста (по плоскости shipAt)
+template <class Rules>
+inline int shipAtCell(const GameBoard<Rules>& board, int x, int y) {
+    return board.shipAt[y * Rules::SIZE + x] - 1;
+}
+
+// Обработка хода игрока
+template <class Rules>
+inline int processMove(GameBoard<Rules>& opponentBoard, int x, int y) {
+    if (x < 0 || y < 0 || x >= Rules::SIZE || y >= Rules::SIZE) {
+        return -1; // недопустимые координаты
+    }
+
+    typename Rules::Mask bit = cellBit<Rules>(x, y);
+
+    // Уже стреляли в эту клетку
+    if (opponentBoard.shotMask & bit) {
+        return -2;
+    }
+    opponentBoard.shotMask |= bit;
+
+    // Промах
+    if (!(opponentBoard.shipMask & bit)) {
+        return 0;
+    }
+
+    // Попадание
+    Ship& ship = opponentBoard.ships[shipAtCell(opponentBoard, x, y)];
+    ship.hits++;
+
+    // Корабль уничтожен, если все его клетки поражены (в одну клетку дважды не стреляют)
+    if (!ship.isDestroyed()) {
+        return 1; // попадание
+    }
+
+    // Помечаем все клетки корабля как уничтоженные
+    opponentBoard.destroyedMask |= shipPosition<Rules>(ship.x, ship.y, ship.length, ship.horizontal).footprint;
+
+    // Проверяем, все ли корабли уничтожены
+    if (opponentBoard.allShipsDestroyed()) {
+        return 3; // победа
+    }
+    return 2; // корабль уничтожен
+}
+
+#endif // BOARD_H
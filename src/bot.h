@@ -0,0 +1,242 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <thread>
+#include <sched.h>
+#include "common.h"
+#include "engine.h"
+#include "ipc.h"
+#include "log.h"
+#include "transport.h"
+
+#define BOT_NAME "[bot]"                 // Имя бота в таблице игроков; войти под ним нельзя
+#define BOT_MAX_MOVES 256                // Ходов бота в работе у шардов одновременно
+#define BOT_REPORT_INTERVAL_MS 10000     // Как часто бот пишет в журнал свою скорость
+#define BOT_COMPLETION 0x80000000u       // Метка ответа на ход бота в его очереди
+#define BOT_INBOX_SIZE 131072            // Очередь бота: ответы на все ходы и по извещению на каждую игру
+#define BOT_RETRY_MS 1                   // Повтор ходов, не влезших в кольцо сервера
+#define BOT_REJECTED_RETRY_MS 100        // Повтор ходов, которые сервер не смог сохранить (ERROR)
+
+// Шарды не должны ждать бота: в игре не больше одного извещения "ход бота"
+// (следующее - только после хода бота), ответов - не больше BOT_MAX_MOVES
+static_assert(BOT_INBOX_SIZE >= BOT_MAX_MOVES + MAX_GAMES, "Bot inbox can overflow");
+
+// Бот - второй игрок в играх PLAY_VS_BOT.
+// Работает в своем потоке и ходит как обычный клиент: кладет MAKE_MOVE в общее
+// кольцо запросов, а ход применяет шард игры, поэтому игры по-прежнему меняет
+// только их шард. Для диспетчера бот - еще один транспорт (TRANSPORT_BOT).
+// В очередь бота приходят номера игр, где ход перешел к нему (от шардов), и ответы
+// на его ходы: после попадания бот ходит снова. Выбор клетки (botChooseShot)
+// считается в потоке бота и не задерживает запросы других игроков.
+// Поток бота никогда не ждет кольца сервера: диспетчер, который его разгребает,
+// может сам ждать шарда, а шард - очереди бота. Ход, не влезший в кольцо,
+// ждет в unsent и отправляется после разбора очереди
+class BotPlayer : public Transport {
+public:
+    BotPlayer() : sharedMem(nullptr), log(nullptr), player(NO_PLAYER), freeCount(0),
+                  moveCount(0), thinkNs(0) {}
+
+    void start(SharedMemory* mem, PlayerId botPlayer, AsyncLogger* logger) {
+        sharedMem = mem;
+        player = botPlayer;
+        log = logger;
+        inbox.init();
+        for (int i = 0; i < BOT_MAX_MOVES; i++) {
+            freeMoves[freeCount++] = BOT_MAX_MOVES - 1 - i;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &reportStart);
+        random.seed((uint64_t)reportStart.tv_sec * 1000000000ull + reportStart.tv_nsec);
+        std::thread(&BotPlayer::run, this).detach();
+    }
+
+    PlayerId id() const {
+        return player;
+    }
+
+    // Шард: в игре с ботом ход перешел к боту
+    void takeTurn(int gameIdx) {
+        while (!inbox.push((uint32_t)gameIdx)) {
+            sched_yield();
+        }
+    }
+
+    Message* receive(uint32_t localId) override {
+        return message(localId);
+    }
+
+    Message* message(uint32_t localId) override {
+        return localId < BOT_MAX_MOVES ? &moves[localId] : nullptr;
+    }
+
+    void complete(uint32_t localId) override {
+        while (!inbox.push(BOT_COMPLETION | localId)) {
+            sched_yield();
+        }
+    }
+
+    // Бот не входит через LOGIN, его канал всегда с ним
+    bool sessionAlive(uint32_t, uint32_t) override {
+        return true;
+    }
+
+private:
+    void run() {
+        uint32_t batch[REQUEST_RING_SIZE];
+        while (true) {
+            report();
+            retryRejected();
+            int count = inbox.popBatch(batch, REQUEST_RING_SIZE);
+            for (int i = 0; i < count; i++) {
+                if (batch[i] & BOT_COMPLETION) {
+                    finishMove(batch[i] & ~BOT_COMPLETION);
+                } else {
+                    makeMove((int)batch[i]);
+                }
+            }
+            flushUnsent();
+            if (count == 0) {
+                int timeoutMs = !unsent.empty()   ? BOT_RETRY_MS
+                                : !rejected.empty() ? BOT_REJECTED_RETRY_MS
+                                                    : BOT_REPORT_INTERVAL_MS;
+                inbox.waitForRequests(timeoutMs);
+            }
+        }
+    }
+
+    // Ответ шарда на ход бота: место хода свободно, после попадания ходим снова
+    void finishMove(uint32_t localId) {
+        if (localId >= BOT_MAX_MOVES) {
+            return;
+        }
+        const Message& result = moves[localId];
+        freeMoves[freeCount++] = localId;
+        if (result.type == Message::MOVE_RESULT && result.gameState == PLAYER2_TURN) {
+            makeMove((int)gameHandleSlot(result.gameHandle));
+        } else if (result.type == Message::ERROR) {
+            // Ход не сохранен (журнал сервера не пишется) - повторим позже
+            if (rejected.empty()) {
+                clock_gettime(CLOCK_MONOTONIC, &rejectedAt);
+            }
+            rejected.push_back(moveGames[localId]);
+        }
+        // Игры, которым не хватило места хода
+        while (freeCount > 0 && !deferred.empty()) {
+            int gameIdx = deferred.front();
+            deferred.pop_front();
+            makeMove(gameIdx);
+        }
+    }
+
+    void makeMove(int gameIdx) {
+        if (gameIdx < 0 || gameIdx >= sharedMem->gameCount.load(std::memory_order_acquire)) {
+            return;
+        }
+        // Игру меняет ее шард - читаем снимок seqlock, как клиент
+        uint32_t version = GAME_VIEW_NONE;
+        readGameView(gameAt(sharedMem, gameIdx), view, version);
+        if (!view.active || view.player2 != player || view.state != PLAYER2_TURN) {
+            return;
+        }
+        if (freeCount == 0) {
+            deferred.push_back(gameIdx);
+            return;
+        }
+
+        struct timespec before, after;
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        int x, y;
+        bool chosen = withRules(view.rules, [&](auto variant) {
+            return botChooseShot(view.board1.as<decltype(variant)>(), x, y, random);
+        });
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        thinkNs += (uint64_t)((after.tv_sec - before.tv_sec) * 1000000000L + (after.tv_nsec - before.tv_nsec));
+        if (!chosen) {
+            return;
+        }
+
+        uint32_t localId = freeMoves[--freeCount];
+        Message& msg = moves[localId];
+        memset(&msg, 0, sizeof(msg));
+        msg.type = Message::MAKE_MOVE;
+        msg.playerId = player;
+        msg.gameHandle = makeGameHandle(gameIdx, view.generation);
+        memcpy(msg.gameName, view.name, sizeof(msg.gameName));
+        msg.x = x;
+        msg.y = y;
+        moveGames[localId] = gameIdx;
+        moveCount++;
+
+        // Ходы уходят по порядку: пока есть неотправленные, новый встает за ними
+        if (!unsent.empty() || !sharedMem->ring.push(makeRequestId(TRANSPORT_BOT, localId))) {
+            unsent.push_back(localId);
+        }
+    }
+
+    // Ходы, отклоненные сервером, повторяем не раньше чем через BOT_REJECTED_RETRY_MS;
+    // makeMove сам пропустит игры, где ход уже не за ботом
+    void retryRejected() {
+        if (rejected.empty()) {
+            return;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsedMs = (now.tv_sec - rejectedAt.tv_sec) * 1000 + (now.tv_nsec - rejectedAt.tv_nsec) / 1000000;
+        if (elapsedMs < BOT_REJECTED_RETRY_MS) {
+            return;
+        }
+        std::deque<int> games;
+        games.swap(rejected);
+        for (int gameIdx : games) {
+            makeMove(gameIdx);
+        }
+    }
+
+    // Отправляем ходы, которым не хватило места в кольце сервера
+    void flushUnsent() {
+        while (!unsent.empty() && sharedMem->ring.push(makeRequestId(TRANSPORT_BOT, unsent.front()))) {
+            unsent.pop_front();
+        }
+    }
+
+    // Скорость бота за прошедший интервал: ходы в секунду и время выбора клетки
+    void report() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double seconds = (now.tv_sec - reportStart.tv_sec) + (now.tv_nsec - reportStart.tv_nsec) / 1e9;
+        if (seconds * 1000 < BOT_REPORT_INTERVAL_MS) {
+            return;
+        }
+        if (moveCount > 0) {
+            double thinkUs = thinkNs / 1000.0 / moveCount;
+            log->info("Bot: %u moves in %.1f s (%.1f moves/s), targeting %.1f us/move",
+                      moveCount, seconds, moveCount / seconds, thinkUs);
+        }
+        reportStart = now;
+        moveCount = 0;
+        thinkNs = 0;
+    }
+
+    SharedMemory* sharedMem;
+    AsyncLogger* log;
+    PlayerId player;
+    RequestRingOf<BOT_INBOX_SIZE> inbox; // Игры, где ход бота, и ответы на его ходы
+    Message moves[BOT_MAX_MOVES];        // Запрос хода, а после обработки - ответ шарда
+    int moveGames[BOT_MAX_MOVES];        // Игра хода (ответ ERROR ее не несет)
+    uint32_t freeMoves[BOT_MAX_MOVES];   // Свободные места ходов (только поток бота)
+    int freeCount;
+    std::deque<int> deferred;            // Игры, ждущие свободного места хода
+    std::deque<uint32_t> unsent;         // Готовые ходы, не влезшие в кольцо сервера
+    std::deque<int> rejected;            // Игры, где сервер не сохранил ход бота
+    struct timespec rejectedAt;          // Когда отклонен первый из них
+    GameView view;                       // Снимок игры, в которой ходит бот
+    GameRandom random;                   // Случайность выбора выстрела (только поток бота)
+
+    uint32_t moveCount;                  // Ходов за текущий интервал отчета
+    uint64_t thinkNs;                    // Время botChooseShot за интервал
+    struct timespec reportStart;
+};
+
+#endif // BOT_H
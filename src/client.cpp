@@ -2,201 +2,471 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
-#include <semaphore.h>
+#include <sched.h>
+#include <signal.h>
+#include <cerrno>
 #include <string>
 #include <sstream>
 #include <iomanip>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <vector>
 #include "common.h"
+#include "board.h"
+#include "engine.h"
+#include "net.h"
+#include "wire.h"
+#include "arena.h"
+
+// Сколько клиент спит в ожидании изменений игры между проверками
+#define WAIT_SLICE_MS 5000
+
+// Соединение с сервером, если клиент работает через сокет, а не через общую память
+int g_serverFd = -1;
+
+// Общая память сервера; растет, пока клиент работает (см. arena.h)
+SharedArena g_arena;
+
+// Сессия клиента: сообщения собираем у себя, серверу уходят только их кадры.
+// Запросов в работе может быть до PIPELINE_DEPTH; ответы приходят в любом
+// порядке и сопоставляются по номеру запроса.
+struct Session {
+    ClientSlot* slot;      // Почтовый слот в общей памяти, nullptr - работаем через сокет
+    Message message;       // Запрос и ответ для sendRequest
+    PlayerId playerId;     // Номер игрока из LOGIN_RESPONSE, уходит в каждом запросе
+    uint32_t nextRequestId;
+    int pending;                               // Запросов в работе
+    uint32_t boxRequest[PIPELINE_DEPTH];       // Номер запроса в ящике слота, 0 - ящик свободен
+    std::deque<Message> completed;             // Ответы, пришедшие раньше, чем их ждали
+};
+
+// Начинаем новый запрос с чистого сообщения - поля прошлого ответа не уходят обратно
+void newRequest(Session* session, Message::Type type) {
+    memset(&session->message, 0, sizeof(session->message));
+    session->message.type = type;
+    session->message.playerId = session->playerId;
+}
 
-// Отображение игрового поля
-void displayBoard(const CellState board[BOARD_SIZE][BOARD_SIZE], bool hideShips = false) {
-    std::cout << "  ";
-    for (int x = 0; x < BOARD_SIZE; x++) {
-        std::cout << " " << x;
+// Символ клетки на доске
+char cellSymbol(CellState cell, bool hideShips) {
+    switch (cell) {
+        case EMPTY: return '.';
+        case SHIP: return hideShips ? '.' : 'S';
+        case MISS: return 'o';
+        case HIT: return 'X';
+        case DESTROYED: return '#';
+        default: return '?';
     }
+}
+
+// Ширина номера строки/столбца: на полях больше 10 клеток номера двузначные
+int labelWidth(int boardSize) {
+    return boardSize > 10 ? 2 : 1;
+}
+
+// Номера столбцов над доской
+void displayColumnNumbers(int boardSize) {
+    int width = labelWidth(boardSize);
+    for (int x = 0; x < boardSize; x++) {
+        std::cout << " " << std::setw(width) << x;
+    }
+}
+
+// Строка y доски
+void displayBoardRow(const CellState board[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int boardSize, int y, bool hideShips) {
+    int width = labelWidth(boardSize);
+    std::cout << std::setw(width) << y << " ";
+    for (int x = 0; x < boardSize; x++) {
+        std::cout << " " << std::setw(width) << cellSymbol(board[y][x], hideShips);
+    }
+}
+
+// Отображение игрового поля
+void displayBoard(const CellState board[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int boardSize, bool hideShips = false) {
+    std::cout << std::setw(labelWidth(boardSize)) << "" << " ";
+    displayColumnNumbers(boardSize);
     std::cout << std::endl;
 
-    for (int y = 0; y < BOARD_SIZE; y++) {
-        std::cout << y << " ";
-        for (int x = 0; x < BOARD_SIZE; x++) {
-            char symbol;
-            switch (board[y][x]) {
-                case EMPTY:
-                    symbol = '.';
-                    break;
-                case SHIP:
-                    symbol = hideShips ? '.' : 'S';
-                    break;
-                case MISS:
-                    symbol = 'o';
-                    break;
-                case HIT:
-                    symbol = 'X';
-                    break;
-                case DESTROYED:
-                    symbol = '#';
-                    break;
-                default:
-                    symbol = '?';
-            }
-            std::cout << " " << symbol;
-        }
+    for (int y = 0; y < boardSize; y++) {
+        displayBoardRow(board, boardSize, y, hideShips);
         std::cout << std::endl;
     }
 }
 
 // Function to display boards horizontally (side by side)
-void displayBoardsHorizontally(const CellState myBoard[BOARD_SIZE][BOARD_SIZE],
-                             const CellState enemyBoard[BOARD_SIZE][BOARD_SIZE],
-                             bool hideEnemyShips = true) {
+void displayBoardsHorizontally(const CellState myBoard[MAX_BOARD_SIZE][MAX_BOARD_SIZE],
+                             const CellState enemyBoard[MAX_BOARD_SIZE][MAX_BOARD_SIZE],
+                             int boardSize, bool hideEnemyShips = true) {
+    int width = labelWidth(boardSize);
+    int rowWidth = (width + 1) * (boardSize + 1);
+
     // Header
-    std::cout << "      Your Board                Enemy Board      " << std::endl;
+    std::string header = "      Your Board";
+    header.resize(rowWidth + 10, ' ');
+    std::cout << header << "Enemy Board      " << std::endl;
 
     // Column numbers
-    std::cout << "  ";
-    for (int x = 0; x < BOARD_SIZE; x++) {
-        std::cout << " " << x;
-    }
-    std::cout << "      ";
-    for (int x = 0; x < BOARD_SIZE; x++) {
-        std::cout << " " << x;
-    }
+    std::cout << std::setw(width) << "" << " ";
+    displayColumnNumbers(boardSize);
+    std::cout << "    " << std::setw(width) << "" << " ";
+    displayColumnNumbers(boardSize);
     std::cout << std::endl;
 
     // Board contents
-    for (int y = 0; y < BOARD_SIZE; y++) {
-        // First board row
-        std::cout << y << " ";
-        for (int x = 0; x < BOARD_SIZE; x++) {
-            char symbol;
-            switch (myBoard[y][x]) {
-            case EMPTY: symbol = '.'; break;
-            case SHIP: symbol = 'S'; break;
-            case MISS: symbol = 'o'; break;
-            case HIT: symbol = 'X'; break;
-            case DESTROYED: symbol = '#'; break;
-            default: symbol = '?';
-            }
-            std::cout << " " << symbol;
-        }
+    for (int y = 0; y < boardSize; y++) {
+        displayBoardRow(myBoard, boardSize, y, false);
 
         // Spacing between boards
         std::cout << "    ";
 
-        // Second board row
-        std::cout << y << " ";
-        for (int x = 0; x < BOARD_SIZE; x++) {
-            char symbol;
-            switch (enemyBoard[y][x]) {
-            case EMPTY: symbol = '.'; break;
-            case SHIP: symbol = hideEnemyShips ? '.' : 'S'; break;
-            case MISS: symbol = 'o'; break;
-            case HIT: symbol = 'X'; break;
-            case DESTROYED: symbol = '#'; break;
-            default: symbol = '?';
+        displayBoardRow(enemyBoard, boardSize, y, hideEnemyShips);
+        std::cout << std::endl;
+    }
+}
+
+// Занимаем свободный почтовый слот (или слот, владелец которого уже завершился)
+ClientSlot* acquireSlot(SharedMemory* sharedMem) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientSlot& slot = sharedMem->slots[i];
+        uint32_t expected = SLOT_FREE;
+        bool claimed = slot.state.compare_exchange_strong(expected, SLOT_IDLE);
+
+        // Слот занят процессом, которого больше нет - забираем его себе
+        if (!claimed && expected == SLOT_IDLE && kill(slot.ownerPid, 0) == -1 && errno == ESRCH) {
+            claimed = slot.state.compare_exchange_strong(expected, SLOT_IDLE);
+        }
+
+        if (claimed) {
+            slot.ownerPid = getpid();
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+// Освобождаем почтовый слот
+void releaseSlot(ClientSlot* slot) {
+    slot->ownerPid = 0;
+    slot->state.store(SLOT_FREE, std::memory_order_release);
+}
+
+// Отпускаем почтовый слот сессии (если работали через общую память)
+void releaseSession(Session* session) {
+    if (session->slot != nullptr) {
+        releaseSlot(session->slot);
+        session->slot = nullptr;
+    }
+}
+
+// Ответ из сокета или общей памяти, какой придет первым
+void receiveResponse(Session* session, Message& response);
+
+// Отправляем запрос, не дожидаясь ответа; возвращает номер запроса
+uint32_t submitRequest(SharedMemory* sharedMem, Session* session, Message& request) {
+    // Все места заняты - забираем один ответ, его потом найдет waitForResponse
+    if (session->pending == PIPELINE_DEPTH) {
+        Message response;
+        receiveResponse(session, response);
+        session->completed.push_back(response);
+    }
+
+    if (++session->nextRequestId == 0) {
+        session->nextRequestId = 1;
+    }
+    request.requestId = session->nextRequestId;
+
+    // Запрос не кодируется - серверу он не уходит, ответ ERROR готов сразу
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t size = encodeMessage(request, frame, sizeof(frame));
+    if (size == 0) {
+        Message error;
+        memset(&error, 0, sizeof(error));
+        error.type = Message::ERROR;
+        error.requestId = request.requestId;
+        strcpy(error.data, "Cannot encode the request");
+        session->completed.push_back(error);
+        return request.requestId;
+    }
+    session->pending++;
+
+    if (g_serverFd != -1) {
+        if (!writeAll(g_serverFd, frame, size)) {
+            std::cerr << "Connection to server lost!" << std::endl;
+            exit(1);
+        }
+        return request.requestId;
+    }
+
+    // Свободный ящик; в ящике с чужим запросом (от прошлого владельца слота)
+    // ждем ответа сервера, прежде чем писать в него
+    ClientSlot* slot = session->slot;
+    int box = -1;
+    while (box == -1) {
+        for (int i = 0; i < PIPELINE_DEPTH && box == -1; i++) {
+            if (session->boxRequest[i] == 0 && slot->boxes[i].state.load(std::memory_order_acquire) != SLOT_REQUEST) {
+                box = i;
             }
-            std::cout << " " << symbol;
         }
-        std::cout << std::endl;
+        if (box == -1) {
+            sched_yield();
+        }
+    }
+
+    memcpy(slot->boxes[box].frame, frame, size);
+    session->boxRequest[box] = request.requestId;
+    slot->boxes[box].state.store(SLOT_REQUEST, std::memory_order_release);
+
+    uint32_t requestId = makeRequestId(TRANSPORT_SHM, (uint32_t)(slot - sharedMem->slots) * PIPELINE_DEPTH + box);
+    while (!sharedMem->ring.push(requestId)) {
+        sched_yield(); // кольцо переполнено - ждем, пока сервер его разгребет
     }
+    return request.requestId;
 }
 
-bool waitForOpponentShips(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerReady,
-                         std::string username, std::string gameName) {
+// Забираем ответ из ящика, если он уже пришел
+bool takeMailboxResponse(Session* session, Message& response) {
+    for (int i = 0; i < PIPELINE_DEPTH; i++) {
+        Mailbox& box = session->slot->boxes[i];
+        if (session->boxRequest[i] == 0 || box.state.load(std::memory_order_acquire) != SLOT_RESPONSE) {
+            continue;
+        }
+        if (!decodeMessage(box.frame, WIRE_MAX_FRAME, response)) {
+            response.type = Message::ERROR;
+            strcpy(response.data, "Malformed server response");
+        }
+        response.requestId = session->boxRequest[i];
+        session->boxRequest[i] = 0;
+        box.state.store(SLOT_IDLE, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void receiveResponse(Session* session, Message& response) {
+    session->pending--;
+
+    if (g_serverFd != -1) {
+        uint8_t frame[WIRE_MAX_FRAME];
+        if (!readAll(g_serverFd, frame, WIRE_HEADER_SIZE)) {
+            std::cerr << "Connection to server lost!" << std::endl;
+            exit(1);
+        }
+        size_t size = wireFrameSize(frame);
+        if (size == 0 || !readAll(g_serverFd, frame + WIRE_HEADER_SIZE, size - WIRE_HEADER_SIZE) ||
+            !decodeMessage(frame, size, response)) {
+            std::cerr << "Malformed server response!" << std::endl;
+            exit(1);
+        }
+        return;
+    }
+
+    // Сервер обычно отвечает быстро - сначала немного крутимся без системных вызовов
+    ClientSlot* slot = session->slot;
+    for (int spin = 0; spin < 1000; spin++) {
+        if (takeMailboxResponse(session, response)) {
+            return;
+        }
+    }
+
+    // Засыпаем на счетчике ответов; если сервер успел ответить, futex не уснет
+    while (true) {
+        uint32_t seen = slot->completions.load(std::memory_order_acquire);
+        if (takeMailboxResponse(session, response)) {
+            return;
+        }
+        slot->waiting.store(1, std::memory_order_seq_cst);
+        if (slot->completions.load(std::memory_order_seq_cst) == seen) {
+            futexWait(&slot->completions, seen);
+        }
+        slot->waiting.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Ждем ответа на конкретный запрос; чужие ответы откладываем
+void waitForResponse(Session* session, uint32_t requestId, Message& response) {
+    for (size_t i = 0; i < session->completed.size(); i++) {
+        if (session->completed[i].requestId == requestId) {
+            response = session->completed[i];
+            session->completed.erase(session->completed.begin() + i);
+            return;
+        }
+    }
+    while (true) {
+        receiveResponse(session, response);
+        if (response.requestId == requestId) {
+            return;
+        }
+        session->completed.push_back(response);
+    }
+}
+
+// Отправляем запрос сессии и ждем ответа сервера
+void sendRequest(SharedMemory* sharedMem, Session* session) {
+    uint32_t requestId = submitRequest(sharedMem, session, session->message);
+    waitForResponse(session, requestId, session->message);
+}
+
+// Слот игры в общей памяти по ее номеру, -1 - номер устарел или неверен
+int findGameIndex(SharedMemory* sharedMem, GameHandle gameHandle) {
+    uint32_t idx = gameHandleSlot(gameHandle);
+    if (sharedMem == nullptr || gameHandle == INVALID_GAME_HANDLE || idx >= (uint32_t)sharedMem->gameCount ||
+        !g_arena.refresh() || gameAt(sharedMem, idx).generation != gameHandleGeneration(gameHandle)) {
+        return -1;
+    }
+    return (int)idx;
+}
+
+// Текущее значение счетчика изменений игры; читаем его до запроса статуса
+uint32_t gameUpdateSeq(SharedMemory* sharedMem, int gameIdx) {
+    if (gameIdx < 0) {
+        return 0;
+    }
+    return gameAt(sharedMem, gameIdx).version.load(std::memory_order_acquire);
+}
+
+// Свежий снимок игры прямо из общей памяти, без запроса серверу.
+// version - версия уже имеющегося снимка (GAME_VIEW_NONE - снимка нет): если игра
+// с тех пор не менялась, view остается как есть. false - общей памяти нет или слот
+// уже занят другой игрой
+bool snapshotGame(SharedMemory* sharedMem, int gameIdx, GameHandle gameHandle, GameView& view, uint32_t& version) {
+    if (gameIdx < 0) {
+        return false;
+    }
+    readGameView(gameAt(sharedMem, gameIdx), view, version);
+    return view.active && view.generation == gameHandleGeneration(gameHandle);
+}
+
+// Спим, пока сервер не изменит игру, но не дольше timeoutMs.
+// Возвращает false, если вышел таймаут.
+bool waitForGameUpdate(SharedMemory* sharedMem, int gameIdx, uint32_t seen, int timeoutMs) {
+    if (gameIdx < 0) {
+        sleep(1); // Игру не нашли (или нет общей памяти) - опрашиваем раз в секунду
+        return false;
+    }
+    Game& game = gameAt(sharedMem, gameIdx);
+    if (game.version.load(std::memory_order_acquire) == seen) {
+        futexWait(&game.version, seen, timeoutMs);
+    }
+    return game.version.load(std::memory_order_acquire) != seen;
+}
+
+bool waitForOpponentShips(SharedMemory* sharedMem, Session* session,
+                         std::string gameName, GameHandle gameHandle) {
     std::cout << "\nWaiting for your opponent to place their ships..." << std::endl;
 
+    int gameIdx = findGameIndex(sharedMem, gameHandle);
     int pollCount = 0;
-    const int MAX_POLLS = 300; // Ждем 5 минут
+    const int MAX_POLLS = 60; // Ждем 5 минут (по WAIT_SLICE_MS)
+    GameView view;
+    uint32_t version = GAME_VIEW_NONE;
 
     while (pollCount < MAX_POLLS) {
-        // Poll for game status
-        sharedMem->message.type = Message::GAME_STATUS;
-        strcpy(sharedMem->message.username, username.c_str());
-        strcpy(sharedMem->message.gameName, gameName.c_str());
+        uint32_t seen = gameUpdateSeq(sharedMem, gameIdx);
+
+        if (snapshotGame(sharedMem, gameIdx, gameHandle, view, version) && view.state != GAME_OVER) {
+            // Состояние видно в общей памяти - сервер не спрашиваем
+            newRequest(session, Message::GAME_STATUS);
+            session->message.gameState = view.state;
+        } else {
+            // Poll for game status
+            newRequest(session, Message::GAME_STATUS);
+            strcpy(session->message.gameName, gameName.c_str());
+            session->message.gameHandle = gameHandle;
 
-        sem_post(semClientReady);
-        sem_wait(semServerReady);
+            sendRequest(sharedMem, session);
+        }
 
-        if (sharedMem->message.type == Message::GAME_STATUS) {
+        if (session->message.type == Message::GAME_STATUS) {
             // Игра началась? (все поставили корабли)
-            if (sharedMem->message.gameState == PLAYER1_TURN ||
-                sharedMem->message.gameState == PLAYER2_TURN) {
+            if (session->message.gameState == PLAYER1_TURN ||
+                session->message.gameState == PLAYER2_TURN) {
                 std::cout << "\nYour opponent has finished placing ships!" << std::endl;
                 std::cout << "Game is starting now..." << std::endl;
                 return true;
                 }
 
             // Check if the game has ended unexpectedly
-            if (sharedMem->message.gameState == GAME_OVER) {
-                std::cout << "\nGame has ended: " << sharedMem->message.data << std::endl;
+            if (session->message.gameState == GAME_OVER) {
+                std::cout << "\nGame has ended: " << session->message.data << std::endl;
                 return false;
             }
         }
 
-        // Мини анимашка ожидания
-        if (pollCount % 5 == 0) {
+        // Спим до изменения игры на сервере; по таймауту - мини анимашка ожидания
+        if (!waitForGameUpdate(sharedMem, gameIdx, seen, WAIT_SLICE_MS)) {
             std::cout << "." << std::flush;
+            pollCount++;
         }
-
-        sleep(1); // Ждем секунду перед проверкой на соединение
-        pollCount++;
     }
 
     std::cout << "\nWaited too long for opponent. You can check back later." << std::endl;
     return false;
 }
 
-// Функция для размещения кораблей
-void placeShips(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerReady,
-                std::string username, std::string gameName) {
+// Названия кораблей по длине
+const char* const SHIP_NAMES[BATTLESHIP + 1] = {"", "Submarines", "Destroyers", "Cruisers", "Battleships"};
+
+// Функция для размещения кораблей (поле и флот - по правилам игры)
+template <class Rules>
+void placeShipsOf(SharedMemory* sharedMem, Session* session,
+                  std::string gameName, GameHandle gameHandle) {
     system("clear");
     std::cout << "\n====== Ship Placement ======\n" << std::endl;
     std::cout << "You need to place:\n";
-    std::cout << "- " << BATTLESHIP_COUNT << " battleships (4 cells)\n";
-    std::cout << "- " << CRUISER_COUNT << " cruisers (3 cells)\n";
-    std::cout << "- " << DESTROYER_COUNT << " destroyers (2 cells)\n";
-    std::cout << "- " << SUBMARINE_COUNT << " submarines (1 cell)\n";
-
-    // Локальная копия доски для отображения
-    CellState localBoard[BOARD_SIZE][BOARD_SIZE] = {};
-    for (int y = 0; y < BOARD_SIZE; y++) {
-        for (int x = 0; x < BOARD_SIZE; x++) {
-            localBoard[y][x] = EMPTY;
-        }
+    for (int length = BATTLESHIP; length >= SUBMARINE; length--) {
+        std::string name = SHIP_NAMES[length];
+        name[0] = (char)tolower(name[0]);
+        std::cout << "- " << Rules::shipCount(length) << " " << name << " (" << length
+                  << (length == 1 ? " cell)\n" : " cells)\n");
     }
 
+    // Локальная доска: корабли проверяем на месте и отправляем серверу весь флот разом
+    GameBoard<Rules> localBoard;
+
     // Массив для отслеживания размещенных кораблей
     int shipsPlaced[5] = {0}; // 0 не используется, 1-4 - длины кораблей
 
     // Цикл размещения кораблей
     while (true) {
         std::cout << "\nCurrent board:" << std::endl;
-        displayBoard(localBoard);
+        CellState cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+        localBoard.toCells(cells);
+        displayBoard(cells, Rules::SIZE);
 
         std::cout << "\nRemaining ships:" << std::endl;
-        std::cout << "- Battleships (4): " << BATTLESHIP_COUNT - shipsPlaced[4] << std::endl;
-        std::cout << "- Cruisers (3): " << CRUISER_COUNT - shipsPlaced[3] << std::endl;
-        std::cout << "- Destroyers (2): " << DESTROYER_COUNT - shipsPlaced[2] << std::endl;
-        std::cout << "- Submarines (1): " << SUBMARINE_COUNT - shipsPlaced[1] << std::endl;
+        for (int length = BATTLESHIP; length >= SUBMARINE; length--) {
+            std::cout << "- " << SHIP_NAMES[length] << " (" << length << "): "
+                      << Rules::shipCount(length) - shipsPlaced[length] << std::endl;
+        }
 
         // Проверяем, все ли корабли размещены
-        if (shipsPlaced[1] == SUBMARINE_COUNT &&
-            shipsPlaced[2] == DESTROYER_COUNT &&
-            shipsPlaced[3] == CRUISER_COUNT &&
-            shipsPlaced[4] == BATTLESHIP_COUNT) {
+        if (areAllShipsPlaced(localBoard)) {
+
+            // Отправляем серверу весь флот и сразу сообщаем, что корабли готовы
+            newRequest(session, Message::PLACE_FLEET);
+            strcpy(session->message.gameName, gameName.c_str());
+            session->message.gameHandle = gameHandle;
+            for (int i = 0; i < localBoard.shipsPlaced; i++) {
+                session->message.fleet[i].x = localBoard.ships[i].x;
+                session->message.fleet[i].y = localBoard.ships[i].y;
+                session->message.fleet[i].length = localBoard.ships[i].length;
+                session->message.fleet[i].horizontal = localBoard.ships[i].horizontal;
+            }
+            session->message.fleetSize = localBoard.shipsPlaced;
+            session->message.markReady = true;
 
-            // Отправляем серверу уведомление, что корабли готовы
-            sharedMem->message.type = Message::SHIPS_READY;
-            strcpy(sharedMem->message.username, username.c_str());
-            strcpy(sharedMem->message.gameName, gameName.c_str());
+            sendRequest(sharedMem, session);
 
-            sem_post(semClientReady);
-            sem_wait(semServerReady);
+            if (session->message.type == Message::PLACE_FLEET_RESPONSE) {
+                std::cout << session->message.data << std::endl;
 
-            if (sharedMem->message.type == Message::SHIPS_READY_RESPONSE) {
-                std::cout << sharedMem->message.data << std::endl;
+                // Сервер не принял флот - расставляем заново
+                if (session->message.shipLength != Rules::TOTAL_SHIPS) {
+                    localBoard.clear();
+                    memset(shipsPlaced, 0, sizeof(shipsPlaced));
+                    continue;
+                }
                 break;
             } else {
                 std::cerr << "Unexpected server response!" << std::endl;
@@ -206,10 +476,15 @@ void placeShips(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServer
 
         // Ввод данных для размещения корабля
         int shipLength;
+        bool autoPlace = false;
         do {
-            std::cout << "\nEnter ship length (1-4): ";
+            std::cout << "\nEnter ship length (1-4, or 'a' to place the whole fleet automatically): ";
             std::string input;
             std::getline(std::cin, input);
+            if (input == "a" || input == "A") {
+                autoPlace = true;
+                break;
+            }
             std::stringstream ss(input);
             if (!(ss >> shipLength) || shipLength < 1 || shipLength > 4) {
                 std::cout << "Invalid length. Please enter a number between 1 and 4." << std::endl;
@@ -218,22 +493,46 @@ void placeShips(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServer
             }
 
             // Проверяем, остались ли корабли этой длины
-            if ((shipLength == 4 && shipsPlaced[4] >= BATTLESHIP_COUNT) ||
-                (shipLength == 3 && shipsPlaced[3] >= CRUISER_COUNT) ||
-                (shipLength == 2 && shipsPlaced[2] >= DESTROYER_COUNT) ||
-                (shipLength == 1 && shipsPlaced[1] >= SUBMARINE_COUNT)) {
+            if (shipsPlaced[shipLength] >= Rules::shipCount(shipLength)) {
                 std::cout << "You have already placed all ships of this length!" << std::endl;
                 shipLength = 0;
             }
         } while (shipLength < 1 || shipLength > 4);
 
+        if (autoPlace) {
+            // Флот расставляет сервер (уже расставленные вручную корабли не в счет)
+            newRequest(session, Message::AUTO_PLACE);
+            strcpy(session->message.gameName, gameName.c_str());
+            session->message.gameHandle = gameHandle;
+            session->message.markReady = true;
+
+            sendRequest(sharedMem, session);
+
+            system("clear");
+            if (session->message.type != Message::AUTO_PLACE_RESPONSE) {
+                std::cerr << "Unexpected server response!" << std::endl;
+                return;
+            }
+            std::cout << session->message.data << std::endl;
+            if (session->message.shipLength != Rules::TOTAL_SHIPS) {
+                continue;
+            }
+
+            setFleet(localBoard, session->message.fleet);
+            std::cout << "\nYour fleet:" << std::endl;
+            CellState cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+            localBoard.toCells(cells);
+            displayBoard(cells, Rules::SIZE);
+            break;
+        }
+
         // Получаем координаты
         int x, y;
         std::cout << "Enter coordinates (format: x y): ";
         std::string input;
         std::getline(std::cin, input);
         std::stringstream ss(input);
-        if (!(ss >> x >> y) || x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
+        if (!(ss >> x >> y) || x < 0 || x >= Rules::SIZE || y < 0 || y >= Rules::SIZE) {
             std::cout << "Invalid coordinates! Please try again." << std::endl;
             continue;
         }
@@ -246,94 +545,98 @@ void placeShips(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServer
             horizontal = (input != "v" && input != "V");
         }
 
-        // Отправляем запрос на размещение корабля
-        sharedMem->message.type = Message::PLACE_SHIP;
-        strcpy(sharedMem->message.username, username.c_str());
-        strcpy(sharedMem->message.gameName, gameName.c_str());
-        sharedMem->message.x = x;
-        sharedMem->message.y = y;
-        sharedMem->message.shipLength = shipLength;
-        sharedMem->message.shipHorizontal = horizontal;
-
-        sem_post(semClientReady);
-        sem_wait(semServerReady);
-
-        if (sharedMem->message.type == Message::PLACE_SHIP_RESPONSE) {
-            std::cout << sharedMem->message.data << std::endl;
-
-            // Если корабль успешно размещен, обновляем локальную доску
-            if (strstr(sharedMem->message.data, "successfully") != nullptr) {
-                // Размещение на локальной доске
-                for (int i = 0; i < shipLength; i++) {
-                    int shipX = horizontal ? x + i : x;
-                    int shipY = horizontal ? y : y + i;
-                    localBoard[shipY][shipX] = SHIP;
-                }
+        // Размещаем корабль на локальной доске по тем же правилам, что и сервер
+        system("clear");
+        if (placeShip(localBoard, x, y, shipLength, horizontal)) {
+            std::cout << "Ship of length " << shipLength << " placed successfully!" << std::endl;
+            shipsPlaced[shipLength]++;
+        } else {
+            std::cout << "Cannot place ship at this position!" << std::endl;
+        }
+    }
+}
 
-                // Обновляем счетчик размещенных кораблей
-                shipsPlaced[shipLength]++;
-            }
+// Расстановка по правилам игры с номером rules
+void placeShips(SharedMemory* sharedMem, Session* session,
+                std::string gameName, GameHandle gameHandle, int rules) {
+    withRules(rules, [&](auto variant) {
+        placeShipsOf<decltype(variant)>(sharedMem, session, gameName, gameHandle);
+    });
+}
 
-            system("clear");
-        } else {
-            std::cerr << "Unexpected server response!" << std::endl;
+// Корабль потоплен: все его подбитые клетки (они связаны, корабли не касаются) - уничтожены
+void markDestroyedShip(CellState board[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int boardSize, int x, int y) {
+    int stackX[MAX_BOARD_SIZE * MAX_BOARD_SIZE];
+    int stackY[MAX_BOARD_SIZE * MAX_BOARD_SIZE];
+    int top = 0;
+    board[y][x] = DESTROYED;
+    stackX[top] = x;
+    stackY[top++] = y;
+
+    const int dx[4] = {1, -1, 0, 0};
+    const int dy[4] = {0, 0, 1, -1};
+    while (top > 0) {
+        top--;
+        int cx = stackX[top];
+        int cy = stackY[top];
+        for (int d = 0; d < 4; d++) {
+            int nx = cx + dx[d];
+            int ny = cy + dy[d];
+            if (nx >= 0 && nx < boardSize && ny >= 0 && ny < boardSize && board[ny][nx] == HIT) {
+                board[ny][nx] = DESTROYED;
+                stackX[top] = nx;
+                stackY[top++] = ny;
+            }
         }
     }
 }
 
+// Отмечаем выстрел на локальной доске по результату хода
+void applyShot(CellState board[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int boardSize, int x, int y, int result) {
+    if (x < 0 || x >= boardSize || y < 0 || y >= boardSize) {
+        return;
+    }
+    if (result == 0) {
+        board[y][x] = MISS;
+    } else if (result == 1) {
+        board[y][x] = HIT;
+    } else if (result == 2 || result == 3) {
+        markDestroyedShip(board, boardSize, x, y);
+    }
+}
+
 // Функция для игрового процесса
-void playGame(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerReady,
-             std::string username, std::string gameName, GameState initialState, std::string opponent) {
+void playGame(SharedMemory* sharedMem, Session* session,
+             std::string gameName, GameHandle gameHandle, GameState initialState, std::string opponent) {
     system("clear");
     std::cout << "\n====== Game Started ======\n" << std::endl;
     std::cout << "You are playing against: " << opponent << std::endl;
 
-    // Локальные копии досок для отображения
-    CellState myBoard[BOARD_SIZE][BOARD_SIZE] = {};   // Моя доска
-    CellState enemyBoard[BOARD_SIZE][BOARD_SIZE] = {}; // Доска противника
-
-    // Инициализация пустыми клетками только для доски противника
-    for (int y = 0; y < BOARD_SIZE; y++) {
-        for (int x = 0; x < BOARD_SIZE; x++) {
-            enemyBoard[y][x] = EMPTY;
-        }
-    }
+    // Локальные копии досок для отображения; с сервера берем один раз, дальше - ходами
+    CellState myBoard[MAX_BOARD_SIZE][MAX_BOARD_SIZE] = {};   // Моя доска
+    CellState enemyBoard[MAX_BOARD_SIZE][MAX_BOARD_SIZE] = {}; // Доска противника
 
     // Запрашиваем состояние доски
-    sharedMem->message.type = Message::GAME_STATUS;
-    strcpy(sharedMem->message.username, username.c_str());
-    strcpy(sharedMem->message.gameName, gameName.c_str());
-
-    sem_post(semClientReady);
-    sem_wait(semServerReady);
-
-    int playerIdx = -1;
-    // Находим игру и определяем какой мы игрок
-    for (int i = 0; i < sharedMem->gameCount; i++) {
-        if (strcmp(sharedMem->games[i].name, gameName.c_str()) == 0) {
-            if (strcmp(sharedMem->games[i].player1, username.c_str()) == 0) {
-                // Мы игрок 1, копируем доску 1
-                for (int y = 0; y < BOARD_SIZE; y++) {
-                    for (int x = 0; x < BOARD_SIZE; x++) {
-                        myBoard[y][x] = sharedMem->games[i].board1.cells[y][x];
-                    }
-                }
-                playerIdx = 1;
-                break;
-            } else if (strcmp(sharedMem->games[i].player2, username.c_str()) == 0) {
-                // Мы игрок 2, копируем доску 2
-                for (int y = 0; y < BOARD_SIZE; y++) {
-                    for (int x = 0; x < BOARD_SIZE; x++) {
-                        myBoard[y][x] = sharedMem->games[i].board2.cells[y][x];
-                    }
-                }
-                playerIdx = 2;
-                break;
-            }
-        }
+    newRequest(session, Message::GAME_STATUS);
+    strcpy(session->message.gameName, gameName.c_str());
+    session->message.gameHandle = gameHandle;
+
+    sendRequest(sharedMem, session);
+
+    if (session->message.type != Message::GAME_STATUS || session->message.player == 0) {
+        std::cerr << "Game not found!" << std::endl;
+        return;
     }
+    int gameIdx = findGameIndex(sharedMem, gameHandle);
 
-    bool isPlayer1 = (playerIdx == 1);
+    // Определяем какой мы игрок и копируем доски (при возврате в игру на них уже есть ходы)
+    bool isPlayer1 = (session->message.player == 1);
+    int boardSize = rulesInfo(session->message.rules).boardSize;
+    memcpy(myBoard, session->message.ownCells, sizeof(myBoard));
+    memcpy(enemyBoard, session->message.enemyCells, sizeof(enemyBoard));
+    uint32_t lastEventSeq = session->message.eventSeq; // Последний учтенный ход
+    GameView view;
+    uint32_t version = GAME_VIEW_NONE;
 
     // Текущее состояние игры
     GameState gameState = initialState;
@@ -348,7 +651,7 @@ void playGame(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerRe
 //        std::cout << "\nEnemy board:" << std::endl;
 //        displayBoard(enemyBoard, true);  // Скрываем корабли противника
         std::cout << std::endl;
-        displayBoardsHorizontally(myBoard, enemyBoard);
+        displayBoardsHorizontally(myBoard, enemyBoard, boardSize);
 
         if (isMyTurn) {
             std::cout << "\nYour turn! Enter coordinates to fire (format: x y): ";
@@ -364,55 +667,31 @@ void playGame(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerRe
 
             std::stringstream ss(input);
             int x, y;
-            if (!(ss >> x >> y) || x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
+            if (!(ss >> x >> y) || x < 0 || x >= boardSize || y < 0 || y >= boardSize) {
                 std::cout << "Invalid coordinates! Please try again." << std::endl;
                 continue;
             }
 
             // Отправляем ход на сервер
-            sharedMem->message.type = Message::MAKE_MOVE;
-            strcpy(sharedMem->message.username, username.c_str());
-            strcpy(sharedMem->message.gameName, gameName.c_str());
-            sharedMem->message.x = x;
-            sharedMem->message.y = y;
+            newRequest(session, Message::MAKE_MOVE);
+            strcpy(session->message.gameName, gameName.c_str());
+            session->message.gameHandle = gameHandle;
+            session->message.x = x;
+            session->message.y = y;
 
-            sem_post(semClientReady);
-            sem_wait(semServerReady);
+            sendRequest(sharedMem, session);
 
-            if (sharedMem->message.type == Message::MOVE_RESULT) {
-                std::cout << sharedMem->message.data << std::endl;
+            if (session->message.type == Message::MOVE_RESULT) {
+                std::cout << session->message.data << std::endl;
 
                 // Обновляем локальную доску противника в соответствии с результатом
-                if (sharedMem->message.hitResult >= 0) {
-                    switch (sharedMem->message.hitResult) {
+                if (session->message.hitResult >= 0) {
+                    applyShot(enemyBoard, boardSize, x, y, session->message.hitResult);
+                    switch (session->message.hitResult) {
                         case 0: // Промах
-                            enemyBoard[y][x] = MISS;
                             isMyTurn = false;
                             break;
-                        case 1: // Попадание
-                            enemyBoard[y][x] = HIT;
-                            break;
-                        case 2: // Корабль уничтожен
-                            // Фулл обновляем доску для отметки всего корябля пореженным
-                            for (int i = 0; i < sharedMem->gameCount; i++) {
-                                if (strcmp(sharedMem->games[i].name, gameName.c_str()) == 0) {
-                                    // Кто мы?
-                                    const GameBoard& updatedBoard = isPlayer1 ? sharedMem->games[i].board2 : sharedMem->games[i].board1;
-
-                                    // Берем только уничтоженные клетки
-                                    for (int boardY = 0; boardY < BOARD_SIZE; boardY++) {
-                                        for (int boardX = 0; boardX < BOARD_SIZE; boardX++) {
-                                            if (updatedBoard.cells[boardY][boardX] == DESTROYED) {
-                                                enemyBoard[boardY][boardX] = DESTROYED;
-                                            }
-                                        }
-                                    }
-                                    break;
-                                }
-                            }
-                            break;
                         case 3: // Победа
-                            enemyBoard[y][x] = DESTROYED;
                             gameState = GAME_OVER;
                             std::cout << "\nCongratulations! You won the game!" << std::endl;
                             break;
@@ -420,7 +699,7 @@ void playGame(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerRe
                 }
 
                 // Обновляем состояние игры
-                gameState = sharedMem->message.gameState;
+                gameState = session->message.gameState;
             } else {
                 std::cerr << "Unexpected server response!" << std::endl;
             }
@@ -430,16 +709,51 @@ void playGame(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerRe
             // Чекаем обновления игры пока ждем оппонента
             bool opponentMoved = false;
             while (!opponentMoved) {
-                // Чекаем обновы
-                sharedMem->message.type = Message::GAME_STATUS;
-                strcpy(sharedMem->message.username, username.c_str());
-                strcpy(sharedMem->message.gameName, gameName.c_str());
+                uint32_t seen = gameUpdateSeq(sharedMem, gameIdx);
+
+                if (snapshotGame(sharedMem, gameIdx, gameHandle, view, version) && view.state != GAME_OVER) {
+                    // Новые ходы берем из кольца игры в общей памяти, без очереди сервера.
+                    // Конец игры узнаем у сервера: так он поймет, что слот можно освободить
+                    newRequest(session, Message::GAME_EVENTS_RESPONSE);
+                    session->message.gameState = view.state;
+                    fillGameEvents(session->message, lastEventSeq, view.eventSeq, view.events);
+                } else {
+                    // Чекаем обновы: только ходы после последнего учтенного
+                    newRequest(session, Message::GAME_EVENTS);
+                    strcpy(session->message.gameName, gameName.c_str());
+                    session->message.gameHandle = gameHandle;
+                    session->message.eventSeq = lastEventSeq;
+
+                    sendRequest(sharedMem, session);
+                }
 
-                sem_post(semClientReady);
-                sem_wait(semServerReady);
+                if (session->message.type == Message::GAME_EVENTS_RESPONSE && session->message.eventsLost) {
+                    // Пропустили слишком много ходов - перечитываем доски целиком
+                    newRequest(session, Message::GAME_STATUS);
+                    strcpy(session->message.gameName, gameName.c_str());
+                    session->message.gameHandle = gameHandle;
 
-                if (sharedMem->message.type == Message::GAME_STATUS) {
-                    GameState updatedState = sharedMem->message.gameState;
+                    sendRequest(sharedMem, session);
+
+                    if (session->message.type == Message::GAME_STATUS) {
+                        memcpy(myBoard, session->message.ownCells, sizeof(myBoard));
+                        memcpy(enemyBoard, session->message.enemyCells, sizeof(enemyBoard));
+                        lastEventSeq = session->message.eventSeq;
+                    }
+                } else if (session->message.type == Message::GAME_EVENTS_RESPONSE) {
+                    // Наша доска содержит удары противника; свои выстрелы мы уже отметили
+                    for (int i = 0; i < session->message.eventCount; i++) {
+                        const MoveEvent& event = session->message.events[i];
+                        if (event.shooter != (isPlayer1 ? 1 : 2)) {
+                            applyShot(myBoard, boardSize, event.x, event.y, event.result);
+                        }
+                    }
+                    lastEventSeq = session->message.eventSeq;
+                }
+
+                if (session->message.type == Message::GAME_STATUS ||
+                    session->message.type == Message::GAME_EVENTS_RESPONSE) {
+                    GameState updatedState = session->message.gameState;
 
                     // Нащ ход?
                     if ((updatedState == PLAYER1_TURN && isPlayer1) ||
@@ -447,61 +761,19 @@ void playGame(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerRe
                         isMyTurn = true;
                         opponentMoved = true;
                         gameState = updatedState;
-
-                        // Обновляем доску на основе данных сервера
-                        // Соединяем удары и нашу доску
-                        for (int i = 0; i < sharedMem->gameCount; i++) {
-                            if (strcmp(sharedMem->games[i].name, gameName.c_str()) == 0) {
-                                if (isPlayer1) {
-                                    // Мы игрок 1 - копируем доску 1, которая содержит удары противника
-                                    for (int y = 0; y < BOARD_SIZE; y++) {
-                                        for (int x = 0; x < BOARD_SIZE; x++) {
-                                            myBoard[y][x] = sharedMem->games[i].board1.cells[y][x];
-                                        }
-                                    }
-                                } else {
-                                    // Мы игрок 2 - копируем доску 2, которая содержит удары противника
-                                    for (int y = 0; y < BOARD_SIZE; y++) {
-                                        for (int x = 0; x < BOARD_SIZE; x++) {
-                                            myBoard[y][x] = sharedMem->games[i].board2.cells[y][x];
-                                        }
-                                    }
-                                }
-                                break;
-                            }
-                        }
                         system("clear");
                         std::cout << "     Your opponent made a move. Your turn now!" << std::endl;
                     } else if (updatedState == GAME_OVER) {
                         gameState = GAME_OVER;
                         opponentMoved = true;
-
-                        // Check if we lost by updating our board one last time
-                        for (int i = 0; i < sharedMem->gameCount; i++) {
-                            if (strcmp(sharedMem->games[i].name, gameName.c_str()) == 0) {
-                                if (isPlayer1) {
-                                    for (int y = 0; y < BOARD_SIZE; y++) {
-                                        for (int x = 0; x < BOARD_SIZE; x++) {
-                                            myBoard[y][x] = sharedMem->games[i].board1.cells[y][x];
-                                        }
-                                    }
-                                } else {
-                                    for (int y = 0; y < BOARD_SIZE; y++) {
-                                        for (int x = 0; x < BOARD_SIZE; x++) {
-                                            myBoard[y][x] = sharedMem->games[i].board2.cells[y][x];
-                                        }
-                                    }
-                                }
-                                break;
-                            }
-                        }
                         system("clear");
                         std::cout << "😭 Game ended! Your opponent has won 😭" << std::endl;
                     }
                 }
 
                 if (!opponentMoved) {
-                    sleep(1); // Ждем немного снова
+                    // Спим, пока сервер не сообщит об изменении игры
+                    waitForGameUpdate(sharedMem, gameIdx, seen, WAIT_SLICE_MS);
                 }
             }
         }
@@ -511,63 +783,218 @@ void playGame(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerRe
 }
 
 // Функция для получения и отображения статистики
-void viewStats(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerReady, std::string username) {
-    sharedMem->message.type = Message::GET_STATS;
-    strcpy(sharedMem->message.username, username.c_str());
+void viewStats(SharedMemory* sharedMem, Session* session, std::string username) {
+    newRequest(session, Message::GET_STATS);
+    strcpy(session->message.username, username.c_str());
 
-    sem_post(semClientReady);
-    sem_wait(semServerReady);
+    sendRequest(sharedMem, session);
 
-    if (sharedMem->message.type == Message::STATS_DATA) {
+    if (session->message.type == Message::STATS_DATA) {
         system("clear");
         std::cout << "\n====== Player Statistics ======\n" << std::endl;
-        std::cout << sharedMem->message.data << std::endl;
+        std::cout << session->message.data << std::endl;
     } else {
         std::cerr << "Error retrieving statistics!" << std::endl;
     }
 }
 
+// Статистика нескольких игроков: все запросы уходят сразу, ответы собираем по номерам
+void viewPlayersStats(SharedMemory* sharedMem, Session* session, const std::vector<std::string>& players) {
+    std::vector<uint32_t> requestIds;
+    for (const std::string& player : players) {
+        Message request;
+        memset(&request, 0, sizeof(request));
+        request.type = Message::GET_STATS;
+        strncpy(request.username, player.c_str(), sizeof(request.username) - 1);
+        requestIds.push_back(submitRequest(sharedMem, session, request));
+    }
+
+    system("clear");
+    std::cout << "\n====== Player Statistics ======" << std::endl;
+    for (size_t i = 0; i < requestIds.size(); i++) {
+        Message response;
+        waitForResponse(session, requestIds[i], response);
+        std::cout << std::endl;
+        if (response.type == Message::STATS_DATA) {
+            std::cout << response.data << std::endl;
+        } else {
+            std::cerr << "Error retrieving statistics for " << players[i] << "!" << std::endl;
+        }
+    }
+}
+
 // Функция для получения списка доступных игр
-std::string getGamesList(SharedMemory* sharedMem, sem_t* semClientReady, sem_t* semServerReady, std::string username) {
-    sharedMem->message.type = Message::LIST_GAMES;
-    strcpy(sharedMem->message.username, username.c_str());
+std::string getGamesList(SharedMemory* sharedMem, Session* session) {
+    newRequest(session, Message::LIST_GAMES);
 
-    sem_post(semClientReady);
-    sem_wait(semServerReady);
+    sendRequest(sharedMem, session);
 
-    if (sharedMem->message.type == Message::GAMES_LIST) {
-        return sharedMem->message.data;
+    if (session->message.type == Message::GAMES_LIST) {
+        return session->message.data;
     } else {
         return "Error retrieving games list!";
     }
 }
 
-int main() {
-    // Открываем существующий объект памяти
-    int fd = shm_open(MMF_NAME, O_RDWR, 0666);
-    if (fd == -1) {
-        std::cerr << "Error opening shared memory. Is the server running?" << std::endl;
-        return 1;
+// Создатель игры ждет соперника, затем расставляет корабли и играет
+void waitForOpponentAndPlay(SharedMemory* sharedMem, Session* session,
+                            std::string gameName, GameHandle gameHandle) {
+    std::cout << "Waiting for an opponent to join..." << std::endl;
+
+    // Ждем пока оппонент присоединится
+    int gameIdx = findGameIndex(sharedMem, gameHandle);
+    int pollCount = 0;
+    const int MAX_POLLS = 120; // 10 minutes maximum wait time at WAIT_SLICE_MS intervals
+    bool opponentJoined = false;
+    GameView view;
+    uint32_t version = GAME_VIEW_NONE;
+
+    while (pollCount < MAX_POLLS && !opponentJoined) {
+        uint32_t seen = gameUpdateSeq(sharedMem, gameIdx);
+
+        if (snapshotGame(sharedMem, gameIdx, gameHandle, view, version) && view.state != GAME_OVER) {
+            // Состояние видно в общей памяти - сервер не спрашиваем
+            newRequest(session, Message::GAME_STATUS);
+            session->message.gameState = view.state;
+        } else {
+            // Чекаем статус игры
+            newRequest(session, Message::GAME_STATUS);
+            strcpy(session->message.gameName, gameName.c_str());
+            session->message.gameHandle = gameHandle;
+
+            sendRequest(sharedMem, session);
+        }
+
+        if (session->message.type == Message::GAME_STATUS) {
+            // Оппонент подсоединился? - ставим корабли
+            if (session->message.gameState == PLACING_SHIPS) {
+                opponentJoined = true;
+                std::cout << "\nAn opponent has joined! Moving to ship placement phase..." << std::endl;
+
+                // Подсоединяемся к игре, чтобы начать ставить корабли
+                newRequest(session, Message::JOIN_GAME);
+                strcpy(session->message.gameName, gameName.c_str());
+                session->message.gameHandle = gameHandle;
+
+                sendRequest(sharedMem, session);
+
+                if (session->message.type == Message::JOIN_GAME_RESPONSE) {
+                    std::string opponentName = session->message.opponent;
+
+                    // Ставим корабли
+                    placeShips(sharedMem, session, gameName, gameHandle, session->message.rules);
+
+                    // Ждем пока оппонент поставит корабли
+                    if (waitForOpponentShips(sharedMem, session, gameName, gameHandle)) {
+                        // Оба поставили - начинаем битву
+                        playGame(sharedMem, session, gameName, gameHandle,
+                                session->message.gameState, opponentName);
+                    }
+                }
+            }
+        }
+
+        // Спим до подключения оппонента; по таймауту - снова мини анимашка
+        if (!opponentJoined && !waitForGameUpdate(sharedMem, gameIdx, seen, WAIT_SLICE_MS)) {
+            std::cout << "." << std::flush;
+            pollCount++;
+        }
     }
 
-    // Отображаем память
-    SharedMemory* sharedMem = (SharedMemory*)mmap(NULL, MMF_SIZE,
-                                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (sharedMem == MAP_FAILED) {
-        std::cerr << "Error mapping shared memory: " << strerror(errno) << std::endl;
-        close(fd);
-        return 1;
+    if (!opponentJoined) {
+        std::cout << "\nWaited too long for an opponent. Returning to main menu." << std::endl;
+    }
+}
+
+// Возвращаемся в незаконченную игру, о которой сервер сообщил при входе
+void resumeGame(SharedMemory* sharedMem, Session* session,
+                std::string gameName, GameHandle gameHandle, GameState gameState,
+                std::string opponentName, int shipsPlaced, int rules) {
+    if (gameState == WAITING_FOR_PLAYER) {
+        waitForOpponentAndPlay(sharedMem, session, gameName, gameHandle);
+        return;
+    }
+
+    if (gameState == PLACING_SHIPS) {
+        // Корабли еще не расставлены - расставляем заново
+        if (shipsPlaced < rulesInfo(rules).totalShips) {
+            placeShips(sharedMem, session, gameName, gameHandle, rules);
+        }
+        if (!waitForOpponentShips(sharedMem, session, gameName, gameHandle)) {
+            return;
+        }
+        gameState = session->message.gameState;
     }
 
-    // Открываем существующие семафоры
-    sem_t* semClientReady = sem_open(SEM_CLIENT_READY, 0);
-    sem_t* semServerReady = sem_open(SEM_SERVER_READY, 0);
+    playGame(sharedMem, session, gameName, gameHandle, gameState, opponentName);
+}
 
-    if (semClientReady == SEM_FAILED || semServerReady == SEM_FAILED) {
-        std::cerr << "Error opening semaphores: " << strerror(errno) << std::endl;
-        munmap(sharedMem, MMF_SIZE);
+// Вариант правил для новой игры; пустой ввод - классика
+int chooseRules() {
+    while (true) {
+        std::cout << "Rules (";
+        for (int i = 0; i < RULES_COUNT; i++) {
+            std::cout << (i > 0 ? ", " : "") << i + 1 << " - " << g_rulesInfo[i].name;
+        }
+        std::cout << ") [1]: ";
+
+        std::string input;
+        std::getline(std::cin, input);
+        if (input.empty()) {
+            return RULES_CLASSIC;
+        }
+        std::stringstream ss(input);
+        int choice;
+        if (ss >> choice && isValidRules(choice - 1)) {
+            return choice - 1;
+        }
+        std::cout << "Invalid choice. Please enter a number between 1 and " << RULES_COUNT << "." << std::endl;
+    }
+}
+
+// Закрываем соединение с сервером (общую память или сокет)
+void disconnect(SharedMemory* sharedMem, int fd) {
+    if (sharedMem != nullptr) {
+        g_arena.close();
+    }
+    if (fd != -1) {
         close(fd);
-        return 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SharedMemory* sharedMem = nullptr;
+    Session* session = new Session();
+    session->slot = nullptr;
+    session->playerId = NO_PLAYER;
+    session->nextRequestId = 0;
+    session->pending = 0;
+    memset(session->boxRequest, 0, sizeof(session->boxRequest));
+    int fd = -1;
+
+    if (argc > 1) {
+        // Адрес сервера (unix:/path или tcp:host:port) - работаем через сокет
+        fd = connectToServer(argv[1]);
+        if (fd == -1) {
+            std::cerr << "Error connecting to " << argv[1] << ": " << strerror(errno) << std::endl;
+            return 1;
+        }
+        g_serverFd = fd;
+    } else {
+        // Подключаемся к общей памяти сервера
+        if (!g_arena.open(MMF_NAME)) {
+            std::cerr << "Error opening shared memory. Is the server running?" << std::endl;
+            return 1;
+        }
+        sharedMem = g_arena.memory();
+
+        // Занимаем собственный почтовый слот
+        session->slot = acquireSlot(sharedMem);
+        if (session->slot == nullptr) {
+            std::cerr << "Server is full, try again later." << std::endl;
+            disconnect(sharedMem, fd);
+            return 1;
+        }
     }
 
     std::cout << "====== Welcome to Sea Battle ======\n" << std::endl;
@@ -579,34 +1006,58 @@ int main() {
 
     if (username.empty() || username.length() > 63) {
         std::cerr << "Invalid username! It must be between 1 and 63 characters." << std::endl;
+        releaseSession(session);
         return 1;
     }
 
     // Отправляем запрос авторизации
-    sharedMem->message.type = Message::LOGIN;
-    strncpy(sharedMem->message.username, username.c_str(), sizeof(sharedMem->message.username) - 1);
-    sharedMem->message.username[sizeof(sharedMem->message.username) - 1] = '\0';
-    strcpy(sharedMem->message.data, "Login request");
-
-    // Уведомляем сервер
-    sem_post(semClientReady);
+    newRequest(session, Message::LOGIN);
+    strncpy(session->message.username, username.c_str(), sizeof(session->message.username) - 1);
+    session->message.username[sizeof(session->message.username) - 1] = '\0';
+    strcpy(session->message.data, "Login request");
 
-    // Ждем ответа от сервера
-    sem_wait(semServerReady);
+    // Уведомляем сервер и ждем ответа
+    sendRequest(sharedMem, session);
 
     // Проверяем ответ на авторизацию
-    if (sharedMem->message.type == Message::LOGIN_RESPONSE) {
-        if (strcmp(sharedMem->message.data, "Already online") == 0) {
-              std::cout << "Player is already online" << std::endl;
-              exit(0);
+    if (session->message.type == Message::LOGIN_RESPONSE) {
+        // Имя занято живой сессией (другим запущенным клиентом). Упавший или
+        // закрытый клиент имя не держит - перезапущенный входит и возвращается в игру
+        if (session->message.playerId == NO_PLAYER) {
+            std::cout << "Player " << username << " is already online in another client." << std::endl;
+            releaseSession(session);
+            disconnect(sharedMem, fd);
+            return 1;
+        }
+        std::cout << session->message.data << std::endl;
+        session->playerId = session->message.playerId;
+
+        // Сервер помнит нашу незаконченную игру (например, после своего перезапуска)
+        if (session->message.gameHandle != INVALID_GAME_HANDLE) {
+            std::string gameName = session->message.gameName;
+            std::string opponentName = session->message.opponent;
+            GameHandle gameHandle = session->message.gameHandle;
+            GameState gameState = session->message.gameState;
+            int shipsPlaced = session->message.shipLength;
+            int rules = session->message.rules;
+
+            std::cout << "You have an unfinished game '" << gameName << "'";
+            if (!opponentName.empty()) {
+                std::cout << " against " << opponentName;
+            }
+            std::cout << ". Resume it? (y/n): ";
+
+            std::string answer;
+            std::getline(std::cin, answer);
+            if (answer == "y" || answer == "Y") {
+                resumeGame(sharedMem, session, gameName, gameHandle,
+                           gameState, opponentName, shipsPlaced, rules);
+            }
         }
-        std::cout << sharedMem->message.data << std::endl;
     } else {
         std::cerr << "Unexpected server response during login!" << std::endl;
-        munmap(sharedMem, MMF_SIZE);
-        close(fd);
-        sem_close(semClientReady);
-        sem_close(semServerReady);
+        releaseSession(session);
+        disconnect(sharedMem, fd);
         return 1;
     }
 
@@ -619,8 +1070,10 @@ int main() {
         std::cout << "1. Create a new game\n";
         std::cout << "2. Join an existing game\n";
         std::cout << "3. View your statistics\n";
-        std::cout << "4. Exit\n";
-        std::cout << "Enter your choice (1-4): ";
+        std::cout << "4. View statistics of other players\n";
+        std::cout << "5. Play against the bot\n";
+        std::cout << "6. Exit\n";
+        std::cout << "Enter your choice (1-6): ";
 
         std::getline(std::cin, input);
 
@@ -635,88 +1088,27 @@ int main() {
                 continue;
             }
 
-            // Отправляем запрос на создание игры
-            sharedMem->message.type = Message::CREATE_GAME;
-            strncpy(sharedMem->message.data, gameName.c_str(), sizeof(sharedMem->message.data) - 1);
-            sharedMem->message.data[sizeof(sharedMem->message.data) - 1] = '\0';
-            strcpy(sharedMem->message.username, username.c_str());
+            int rules = chooseRules();
 
-            // Уведомляем сервер
-            sem_post(semClientReady);
+            // Отправляем запрос на создание игры
+            newRequest(session, Message::CREATE_GAME);
+            strncpy(session->message.data, gameName.c_str(), sizeof(session->message.data) - 1);
+            session->message.data[sizeof(session->message.data) - 1] = '\0';
+            session->message.rules = rules;
 
-            // Ждем ответа от сервера
-            sem_wait(semServerReady);
+            // Уведомляем сервер и ждем ответа
+            sendRequest(sharedMem, session);
 
-            if (sharedMem->message.type == Message::CREATE_GAME_RESPONSE) {
+            if (session->message.type == Message::CREATE_GAME_RESPONSE) {
                 system("clear");
-                std::cout << "Server response: " << sharedMem->message.data << std::endl;
-
-                if (sharedMem->message.gameState == WAITING_FOR_PLAYER) {
-                    if (strcmp(sharedMem->message.data, "Game with this name already exists!") == 0) {
-                        continue;
-                    }
-                    if (strcmp(sharedMem->message.data, "Maximum number of games reached!") == 0) {
-                        continue;
-                    }
-                    std::string gameName = sharedMem->message.gameName;
-                    std::cout << "Waiting for an opponent to join..." << std::endl;
-
-                    // Ждем пока оппонент присоединится
-                    int pollCount = 0;
-                    const int MAX_POLLS = 600; // 10 minutes maximum wait time at 1 second intervals
-                    bool opponentJoined = false;
-
-                    while (pollCount < MAX_POLLS && !opponentJoined) {
-                        // Чекаем статус игры
-                        sharedMem->message.type = Message::GAME_STATUS;
-                        strcpy(sharedMem->message.username, username.c_str());
-                        strcpy(sharedMem->message.gameName, gameName.c_str());
-
-                        sem_post(semClientReady);
-                        sem_wait(semServerReady);
-
-                        if (sharedMem->message.type == Message::GAME_STATUS) {
-                            // Оппонент подсоединился? - ставим корабли
-                            if (sharedMem->message.gameState == PLACING_SHIPS) {
-                                opponentJoined = true;
-                                std::cout << "\nAn opponent has joined! Moving to ship placement phase..." << std::endl;
-
-                                // Подсоединяемся к игре, чтобы начать ставить корабли
-                                sharedMem->message.type = Message::JOIN_GAME;
-                                strcpy(sharedMem->message.username, username.c_str());
-                                strcpy(sharedMem->message.gameName, gameName.c_str());
-
-                                sem_post(semClientReady);
-                                sem_wait(semServerReady);
-
-                                if (sharedMem->message.type == Message::JOIN_GAME_RESPONSE) {
-                                    std::string opponentName = sharedMem->message.opponent;
-
-                                    // Ставим корабли
-                                    placeShips(sharedMem, semClientReady, semServerReady, username, gameName);
-
-                                    // Ждем пока оппонент поставит корабли
-                                    if (waitForOpponentShips(sharedMem, semClientReady, semServerReady, username, gameName)) {
-                                        // Оба поставили - начинаем битву
-                                        playGame(sharedMem, semClientReady, semServerReady, username, gameName,
-                                                sharedMem->message.gameState, opponentName);
-                                    }
-                                }
-                            }
-                        }
-
-                        // Снова мини анимашка
-                        if (pollCount % 5 == 0) {
-                            std::cout << "." << std::flush;
-                        }
-
-                        sleep(1); // Ждем секунду
-                        pollCount++;
-                    }
-
-                    if (!opponentJoined) {
-                        std::cout << "\nWaited too long for an opponent. Returning to main menu." << std::endl;
-                    }
+                std::cout << "Server response: " << session->message.data << std::endl;
+
+                // Игра создана, только если сервер вернул ее номер; иначе в ответе - причина отказа
+                if (session->message.gameHandle != INVALID_GAME_HANDLE &&
+                    session->message.gameState == WAITING_FOR_PLAYER) {
+                    std::string gameName = session->message.gameName;
+                    GameHandle gameHandle = session->message.gameHandle;
+                    waitForOpponentAndPlay(sharedMem, session, gameName, gameHandle);
                 }
             } else {
                 std::cerr << "Unexpected server response!" << std::endl;
@@ -724,7 +1116,7 @@ int main() {
         }
         else if (input == "2") {
             // Получаем список игр
-            std::string gamesList = getGamesList(sharedMem, semClientReady, semServerReady, username);
+            std::string gamesList = getGamesList(sharedMem, session);
             std::cout << "\n" << gamesList << std::endl;
 
             std::cout << "Enter game name to join (or 'back' to return): ";
@@ -740,27 +1132,28 @@ int main() {
                 continue;
             }
 
-            // Запрос на подсоединение
-            sharedMem->message.type = Message::JOIN_GAME;
-            strcpy(sharedMem->message.username, username.c_str());
-            strcpy(sharedMem->message.gameName, gameName.c_str());
+            // Запрос на подсоединение (по имени - номера игры мы еще не знаем)
+            newRequest(session, Message::JOIN_GAME);
+            strcpy(session->message.gameName, gameName.c_str());
+            session->message.gameHandle = INVALID_GAME_HANDLE;
 
-            sem_post(semClientReady);
-            sem_wait(semServerReady);
+            sendRequest(sharedMem, session);
 
-            if (sharedMem->message.type == Message::JOIN_GAME_RESPONSE) {
-                std::cout << sharedMem->message.data << std::endl;
-                std::string opponentName = sharedMem->message.opponent;
+            if (session->message.type == Message::JOIN_GAME_RESPONSE) {
+                std::cout << session->message.data << std::endl;
+                std::string opponentName = session->message.opponent;
+                GameHandle gameHandle = session->message.gameHandle;
+                int rules = session->message.rules;
 
-                if (sharedMem->message.gameState == PLACING_SHIPS) {
+                if (session->message.gameState == PLACING_SHIPS) {
                     // Ставим корабли
-                    placeShips(sharedMem, semClientReady, semServerReady, username, gameName);
+                    placeShips(sharedMem, session, gameName, gameHandle, rules);
 
                     // Игра готова или ждем оппонентов?
-                    if (waitForOpponentShips(sharedMem, semClientReady, semServerReady, username, gameName)) {
+                    if (waitForOpponentShips(sharedMem, session, gameName, gameHandle)) {
                         // Корабли поставлены - начинаем!
-                        playGame(sharedMem, semClientReady, semServerReady, username, gameName,
-                                 sharedMem->message.gameState, opponentName);
+                        playGame(sharedMem, session, gameName, gameHandle,
+                                 session->message.gameState, opponentName);
                     }
                 }
             } else {
@@ -768,9 +1161,62 @@ int main() {
             }
         }  else if (input == "3") {
             // Просмотр статистики
-            viewStats(sharedMem, semClientReady, semServerReady, username);
+            viewStats(sharedMem, session, username);
 
         } else if (input == "4") {
+            std::cout << "Enter player names separated by spaces: ";
+            std::getline(std::cin, input);
+
+            std::stringstream ss(input);
+            std::vector<std::string> players;
+            std::string player;
+            while (ss >> player) {
+                if (player.length() <= 63) {
+                    players.push_back(player);
+                }
+            }
+            viewPlayersStats(sharedMem, session, players);
+
+        } else if (input == "5") {
+            // Игра с ботом: сервер сразу сажает его вторым игроком с готовым флотом
+            std::cout << "Enter game name: ";
+            std::string gameName;
+            std::getline(std::cin, gameName);
+
+            if (gameName.empty() || gameName.length() > 63) {
+                std::cout << "Invalid game name! It must be between 1 and 63 characters." << std::endl;
+                continue;
+            }
+
+            int rules = chooseRules();
+
+            newRequest(session, Message::PLAY_VS_BOT);
+            strncpy(session->message.data, gameName.c_str(), sizeof(session->message.data) - 1);
+            session->message.data[sizeof(session->message.data) - 1] = '\0';
+            session->message.rules = rules;
+
+            sendRequest(sharedMem, session);
+
+            if (session->message.type == Message::PLAY_VS_BOT_RESPONSE) {
+                system("clear");
+                std::cout << "Server response: " << session->message.data << std::endl;
+
+                if (session->message.gameState == PLACING_SHIPS) {
+                    std::string gameName = session->message.gameName;
+                    std::string opponentName = session->message.opponent;
+                    GameHandle gameHandle = session->message.gameHandle;
+
+                    placeShips(sharedMem, session, gameName, gameHandle, rules);
+                    if (waitForOpponentShips(sharedMem, session, gameName, gameHandle)) {
+                        playGame(sharedMem, session, gameName, gameHandle,
+                                 session->message.gameState, opponentName);
+                    }
+                }
+            } else {
+                std::cerr << "Unexpected server response!" << std::endl;
+            }
+
+        } else if (input == "6") {
             std::cout << "Thank you for playing. Goodbye!" << std::endl;
             running = false;
 
@@ -780,10 +1226,8 @@ int main() {
     }
 
     // Освобождаем ресурсы
-    sem_close(semClientReady);
-    sem_close(semServerReady);
-    munmap(sharedMem, MMF_SIZE);
-    close(fd);
+    releaseSession(session);
+    disconnect(sharedMem, fd);
 
     return 0;
 }
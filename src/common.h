@@ -3,18 +3,34 @@
 
 #include <cstdint>
 #include <cstring>
+#include <new>
+#include <atomic>
+#include <sched.h>
+#include <sys/types.h>
+#include "ipc.h"
+#include "rules.h"
 
 #define MMF_NAME "/sea_battle_mmf"
-#define SEM_CLIENT_READY "/sem_client_ready"
-#define SEM_SERVER_READY "/sem_server_ready"
-#define MMF_SIZE (sizeof(SharedMemory) + 1024)
-#define MAX_PLAYERS 100
-#define MAX_GAMES 20
+#define MAX_CLIENTS 64
+#define PIPELINE_DEPTH 8   // Запросов одного клиента в работе одновременно
+#define GAME_CHUNK 64          // Игр в одном куске таблицы (сегмент растет кусками, см. arena.h)
+#define MAX_GAME_CHUNKS 1024   // Предел арены в кусках
+#define MAX_GAMES (GAME_CHUNK * MAX_GAME_CHUNKS)
+#define GAME_EVENT_RING 64   // Последних ходов игры, которые можно получить дельтой (GAME_EVENTS)
+#define SERVER_SHARDS 4   // Потоков-шардов сервера; слот игры slot принадлежит шарду slot % SERVER_SHARDS
+#define GAME_ABANDON_SECONDS 600   // Игра без игроков в сети освобождается, если столько секунд не менялась
+#define GAME_SWEEP_SECONDS 10      // Шард ищет брошенные игры не чаще раза в столько секунд
 #define STATS_FILE "player_stats.dat"
+#define STATS_JOURNAL_FILE "player_stats.journal"
+#define GAMES_JOURNAL_FILE "games_moves.log"
+#define SERVER_LOG_FILE "server.log"
+#define JOURNAL_SYNC_RECORDS 64        // fdatasync журналов после стольких записей...
+#define JOURNAL_SYNC_INTERVAL_MS 100   // ...или не реже чем раз в столько миллисекунд
+#define STATS_COMPACT_RECORDS 10000    // После стольких записей журнал статистики сворачивается в снимок
+#define GAMES_COMPACT_RECORDS 50000    // То же для журнала ходов
 #define GAMES_FILE "games_data.dat"
-
-// Размер игрового поля
-#define BOARD_SIZE 10
+#define WIRE_HEADER_SIZE 8      // Заголовок кадра сообщения (см. wire.h)
+#define WIRE_MAX_FRAME 2048     // Самый длинный кадр: все строки Message, флот и обе доски
 
 // Состояния клетки игрового поля
 enum CellState {
@@ -25,20 +41,12 @@ enum CellState {
     DESTROYED = 4 // Уничтоженный корабль
 };
 
-// Типы кораблей
-enum ShipType {
-    BATTLESHIP = 4,   // Линкор (4 клетки)
-    CRUISER = 3,      // Крейсер (3 клетки)
-    DESTROYER = 2,    // Эсминец (2 клетки)
-    SUBMARINE = 1     // Подводная лодка (1 клетка)
-};
-
-// Структура корабля
+// Структура корабля (5 байт)
 struct Ship {
-    int x, y;         // Координаты начала
-    int length;       // Длина
+    int8_t x, y;      // Координаты начала
+    uint8_t length;   // Длина
     bool horizontal;  // Ориентация (true - горизонтальная, false - вертикальная)
-    int hits;         // Количество попаданий
+    uint8_t hits;     // Количество попаданий
 
     Ship() : x(-1), y(-1), length(0), horizontal(true), hits(0) {}
 
@@ -47,38 +55,99 @@ struct Ship {
     }
 };
 
-// Количество кораблей каждого типа
-#define BATTLESHIP_COUNT 1
-#define CRUISER_COUNT 2
-#define DESTROYER_COUNT 3
-#define SUBMARINE_COUNT 4
-#define TOTAL_SHIPS (BATTLESHIP_COUNT + CRUISER_COUNT + DESTROYER_COUNT + SUBMARINE_COUNT)
+// Бит клетки в маске поля: бит (y * Rules::SIZE + x)
+template <class Rules>
+constexpr typename Rules::Mask cellBit(int x, int y) {
+    return (typename Rules::Mask)1 << (y * Rules::SIZE + x);
+}
 
-// Структура игрового поля
+// Структура игрового поля по правилам варианта (rules.h).
+// Клетки хранятся тремя битовыми плоскостями (3 бита на клетку);
+// состояние клетки для отображения дает cellAt(). Корабль клетки - байтовая
+// плоскость shipAt: 4 бит не хватает, на большом поле кораблей 20
+template <class Rules>
 struct GameBoard {
-    CellState cells[BOARD_SIZE][BOARD_SIZE];
-    Ship ships[TOTAL_SHIPS];
-    int shipsPlaced;  // Количество размещенных кораблей
+    typedef typename Rules::Mask Mask;
 
-    GameBoard() : shipsPlaced(0) {
+    Mask shipMask;            // Клетки, занятые кораблями
+    Mask shotMask;            // Клетки, по которым уже стреляли
+    Mask destroyedMask;       // Клетки потопленных кораблей
+    Ship ships[Rules::TOTAL_SHIPS];
+    uint8_t shipAt[Rules::CELLS];  // Номер корабля клетки + 1, 0 - клетка пуста
+    uint8_t shipsPlaced;      // Количество размещенных кораблей
+
+    GameBoard() {
         clear();
     }
 
     void clear() {
-        memset(cells, EMPTY, sizeof(cells));
-        shipsPlaced = 0;
-        for (int i = 0; i < TOTAL_SHIPS; i++) {
+        shipMask = 0;
+        shotMask = 0;
+        destroyedMask = 0;
+        for (int i = 0; i < Rules::TOTAL_SHIPS; i++) {
             ships[i] = Ship();
         }
+        memset(shipAt, 0, sizeof(shipAt));
+        shipsPlaced = 0;
     }
 
-    bool allShipsDestroyed() const {
-        for (int i = 0; i < shipsPlaced; i++) {
-            if (!ships[i].isDestroyed()) {
-                return false;
+    CellState cellAt(int x, int y) const {
+        Mask bit = cellBit<Rules>(x, y);
+        if (destroyedMask & bit) {
+            return DESTROYED;
+        }
+        if (shotMask & bit) {
+            return (shipMask & bit) ? HIT : MISS;
+        }
+        return (shipMask & bit) ? SHIP : EMPTY;
+    }
+
+    // Распаковка в массив клеток (для отображения и ответа сервера); занят угол Rules::SIZE x Rules::SIZE
+    void toCells(CellState cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE]) const {
+        for (int y = 0; y < Rules::SIZE; y++) {
+            for (int x = 0; x < Rules::SIZE; x++) {
+                cells[y][x] = cellAt(x, y);
             }
         }
-        return shipsPlaced == TOTAL_SHIPS;
+    }
+
+    bool allShipsDestroyed() const {
+        return shipsPlaced == Rules::TOTAL_SHIPS && (shipMask & ~shotMask) == 0;
+    }
+};
+
+// Доски игры варианта Rules. Лежат в куске таблицы игр за записями Game
+// (см. gameChunkBytes): место под доски у каждой игры - по ее варианту
+template <class Rules>
+struct GameBoards {
+    GameBoard<Rules> board1;  // Поле первого игрока
+    GameBoard<Rules> board2;  // Поле второго игрока
+};
+
+constexpr size_t maxBoardBytes(size_t a, size_t b) {
+    return a > b ? a : b;
+}
+
+// Копия поля любого варианта (GameView): место под самое большое поле,
+// а какого оно варианта - знает только rules копии. Поле нужных правил дает as<Rules>()
+struct AnyGameBoard {
+    static constexpr size_t SIZE = maxBoardBytes(sizeof(GameBoard<ClassicRules>),
+                                                 maxBoardBytes(sizeof(GameBoard<QuickRules>),
+                                                               sizeof(GameBoard<LargeRules>)));
+    alignas(16) unsigned char storage[SIZE];
+
+    AnyGameBoard() {
+        memset(storage, 0, sizeof(storage)); // нули - пустое поле любого варианта
+    }
+
+    template <class Rules>
+    GameBoard<Rules>& as() {
+        return *reinterpret_cast<GameBoard<Rules>*>(storage);
+    }
+
+    template <class Rules>
+    const GameBoard<Rules>& as() const {
+        return *reinterpret_cast<const GameBoard<Rules>*>(storage);
     }
 };
 
@@ -91,24 +160,148 @@ enum GameState {
     GAME_OVER = 4,             // Игра окончена
 };
 
-// Структура игры
-struct Game {
-    char name[64];                // Название игры
-    char player1[64];             // Имя первого игрока
-    char player2[64];             // Имя второго игрока
-    GameBoard board1;             // Поле первого игрока
-    GameBoard board2;             // Поле второго игрока
+// Событие хода в игре
+struct MoveEvent {
+    uint32_t seq;     // Номер хода в игре, с 1
+    uint8_t shooter;  // Кто стрелял: 1 или 2
+    uint8_t x, y;
+    int8_t result;    // Как у processMove: 0 - промах, 1 - попадание, 2 - потоплен, 3 - победа
+};
+
+// Номер игрока: его место в таблице игроков сервера. Имя превращается в номер
+// при входе, дальше игры и запросы ссылаются на игрока только по номеру,
+// а имена нужны лишь для отображения
+typedef int32_t PlayerId;
+#define NO_PLAYER -1
+
+// Номер игры для клиентов: поколение слота в старших 32 битах, слот - в младших.
+// Поколение растет при каждом новом использовании слота, так что номер
+// законченной игры не спутать с новой игрой в том же слоте.
+typedef uint64_t GameHandle;
+#define INVALID_GAME_HANDLE 0
+
+inline GameHandle makeGameHandle(uint32_t slot, uint32_t generation) {
+    return ((GameHandle)generation << 32) | slot;
+}
+
+inline uint32_t gameHandleSlot(GameHandle handle) {
+    return (uint32_t)handle;
+}
+
+inline uint32_t gameHandleGeneration(GameHandle handle) {
+    return (uint32_t)(handle >> 32);
+}
+
+// Структура игры. Запись начинается с кэш-линии: игры соседних слотов меняют
+// разные шарды, и общая линия гоняла бы ее между ядрами. Поля, которые смотрят
+// при обходе таблицы и ожидании (версия, состояние, участники), лежат в первой линии,
+// потом редко читаемое имя и кольцо ходов. Доски - не в записи, а в том же куске
+// таблицы за записями, размером по варианту игры (см. gameChunkBytes)
+struct alignas(64) Game {
+    std::atomic<uint32_t> version;  // Seqlock: нечетная, пока сервер меняет запись; futex для ждущих клиентов
+    uint32_t generation;          // Поколение слота (см. GameHandle)
+    uint32_t eventSeq;            // Номер последнего хода; ход seq лежит в events[(seq - 1) % GAME_EVENT_RING]
     GameState state;              // Состояние игры
     int winner;                   // Номер победителя (1 или 2), 0 - нет победителя
     bool active;                  // Активна ли игра
+    uint8_t rules;                // Вариант игры (GameRulesId) - вариант куска слота
+    PlayerId player1;             // Первый игрок (создатель)
+    PlayerId player2;             // Второй игрок, NO_PLAYER - еще не подключился
+    uint32_t boards;              // Смещение досок игры (GameBoards<Rules>) от начала записи
+    char name[64];                // Название игры
+    MoveEvent events[GAME_EVENT_RING];
 
-    Game() : state(WAITING_FOR_PLAYER), winner(0), active(false) {
+    Game() : version(0), generation(0), eventSeq(0), state(WAITING_FOR_PLAYER), winner(0), active(false),
+             rules(RULES_CLASSIC), player1(NO_PLAYER), player2(NO_PLAYER), boards(0) {
         name[0] = '\0';
-        player1[0] = '\0';
-        player2[0] = '\0';
+    }
+
+    // Поле игрока; Rules - вариант игры (rules)
+    template <class Rules>
+    GameBoard<Rules>& board(bool isPlayer1) {
+        GameBoards<Rules>& pair = *reinterpret_cast<GameBoards<Rules>*>(reinterpret_cast<char*>(this) + boards);
+        return isPlayer1 ? pair.board1 : pair.board2;
+    }
+
+    template <class Rules>
+    const GameBoard<Rules>& board(bool isPlayer1) const {
+        const GameBoards<Rules>& pair =
+            *reinterpret_cast<const GameBoards<Rules>*>(reinterpret_cast<const char*>(this) + boards);
+        return isPlayer1 ? pair.board1 : pair.board2;
     }
 };
 
+// Байт в куске таблицы игр варианта rules: GAME_CHUNK записей Game, за ними их доски
+inline size_t gameChunkBytes(int rules) {
+    return withRules(rules, [](auto variant) {
+        return GAME_CHUNK * (sizeof(Game) + sizeof(GameBoards<decltype(variant)>));
+    });
+}
+
+// Самый большой кусок (варианта с самыми большими досками)
+constexpr size_t MAX_GAME_CHUNK_BYTES =
+    GAME_CHUNK * (sizeof(Game) + maxBoardBytes(sizeof(GameBoards<ClassicRules>),
+                                               maxBoardBytes(sizeof(GameBoards<QuickRules>),
+                                                             sizeof(GameBoards<LargeRules>))));
+
+// Согласованная копия игры для тех, кто читает общую память мимо сервера:
+// клиенты, наблюдатели, мониторинг
+struct GameView {
+    char name[64];
+    PlayerId player1;
+    PlayerId player2;
+    GameState state;
+    int winner;
+    bool active;
+    uint8_t rules;
+    uint32_t generation;
+    uint32_t eventSeq;
+    MoveEvent events[GAME_EVENT_RING];
+    AnyGameBoard board1;
+    AnyGameBoard board2;
+};
+
+#define GAME_VIEW_NONE 1   // "Копии еще нет": версии готовых записей всегда четные
+
+// Читатель seqlock: копируем игру, пока версия до и после копирования не совпадет
+// и не окажется четной. Если версия равна version - копия уже свежая, копировать
+// не нужно: возвращаем false. Иначе копируем и запоминаем новую версию
+inline bool readGameView(const Game& game, GameView& view, uint32_t& version) {
+    for (;;) {
+        uint32_t before = game.version.load(std::memory_order_acquire);
+        if (before == version) {
+            return false;
+        }
+        if (before & 1) {
+            sched_yield(); // сервер как раз меняет запись
+            continue;
+        }
+
+        memcpy(view.name, game.name, sizeof(view.name));
+        view.player1 = game.player1;
+        view.player2 = game.player2;
+        view.state = game.state;
+        view.winner = game.winner;
+        view.active = game.active;
+        view.rules = game.rules;
+        view.generation = game.generation;
+        view.eventSeq = game.eventSeq;
+        memcpy(view.events, game.events, sizeof(view.events));
+        // Вариант слота не меняется (он - вариант куска), копируем доски его размера
+        withRules(view.rules, [&](auto variant) {
+            typedef decltype(variant) Rules;
+            view.board1.as<Rules>() = game.board<Rules>(true);
+            view.board2.as<Rules>() = game.board<Rules>(false);
+        });
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (game.version.load(std::memory_order_relaxed) == before) {
+            version = before;
+            return true;
+        }
+    }
+}
+
 // Структура данных игрока
 struct PlayerStats {
     char username[64];
@@ -116,14 +309,20 @@ struct PlayerStats {
     int losses;
     bool active;
     bool inGame;
-    char currentGame[64];
+    GameHandle currentGame;  // Незаконченная игра игрока, INVALID_GAME_HANDLE - нет
 
-    PlayerStats() : wins(0), losses(0), active(false), inGame(false) {
+    PlayerStats() : wins(0), losses(0), active(false), inGame(false), currentGame(INVALID_GAME_HANDLE) {
         username[0] = '\0';
-        currentGame[0] = '\0';
     }
 };
 
+// Позиция одного корабля в запросе PLACE_FLEET
+struct ShipPlacement {
+    int x, y;
+    int length;
+    bool horizontal;
+};
+
 // Структура сообщения
 struct Message {
     enum Type {
@@ -144,29 +343,121 @@ struct Message {
         GAME_STATUS = 17,
         GET_STATS = 18,
         STATS_DATA = 19,
+        PLACE_FLEET = 20,
+        PLACE_FLEET_RESPONSE = 21,
+        GAME_EVENTS = 22,
+        GAME_EVENTS_RESPONSE = 23,
+        PLAY_VS_BOT = 24,
+        PLAY_VS_BOT_RESPONSE = 25,
+        AUTO_PLACE = 26,
+        AUTO_PLACE_RESPONSE = 27,
         ERROR = 99
     };
 
     Type type;
-    char username[64];
+    uint32_t requestId;     // Номер запроса у клиента; ответ приходит с тем же номером
+    char username[64];      // Имя игрока: для входа и поиска статистики по имени
+    PlayerId playerId;      // Номер отправителя из LOGIN_RESPONSE
+    SessionId session;      // Канал запроса у сервера (ставит транспорт), по сети не передается
     char data[1024];
     bool newUser;  // Используется для LOGIN_RESPONSE, true = новый пользователь
 
     // Дополнительные поля для игры
     char gameName[64];
+    GameHandle gameHandle;  // Номер игры; если задан, сервер ищет игру по нему, а не по имени
     int x, y;               // Координаты для хода или размещения корабля
     int shipLength;         // Длина корабля при размещении
     bool shipHorizontal;    // Ориентация корабля
     int hitResult;          // Результат хода (0 - промах, 1 - попадание, 2 - уничтожен корабль, 3 - победа)
     GameState gameState;    // Состояние игры
     char opponent[64];      // Имя оппонента
+    int rules;              // Вариант игры (GameRulesId): в CREATE_GAME и PLAY_VS_BOT - выбор
+                            // игрока, в ответах об игре - ее вариант; по нему размер досок
+
+    // Весь флот одним запросом (PLACE_FLEET) или в ответе AUTO_PLACE
+    ShipPlacement fleet[MAX_FLEET_SHIPS];
+    int fleetSize;
+    bool markReady;         // Сразу отметить игрока готовым (как SHIPS_READY)
+
+    // Поля участника игры (GAME_STATUS, MOVE_RESULT) - для клиентов без общей памяти
+    int player;                                 // 1 или 2, 0 - не участник
+    CellState ownCells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];   // Своя доска (угол размера поля игры)
+    CellState enemyCells[MAX_BOARD_SIZE][MAX_BOARD_SIZE]; // Доска противника без его целых кораблей
+
+    // Ходы игры (GAME_EVENTS): в запросе eventSeq - последний известный клиенту ход,
+    // в ответе - последний ход игры; events - ходы после известного
+    uint32_t eventSeq;
+    int eventCount;
+    bool eventsLost;        // Нужные ходы уже вытеснены из кольца - перечитайте доски (GAME_STATUS)
+    MoveEvent events[GAME_EVENT_RING];
+};
+
+// Ответ GAME_EVENTS: ходы после since из кольца игры (ring, последний ход - eventSeq)
+inline void fillGameEvents(Message& msg, uint32_t since, uint32_t eventSeq, const MoveEvent* ring) {
+    msg.eventSeq = eventSeq;
+    msg.eventCount = 0;
+    msg.eventsLost = since > eventSeq || eventSeq - since > GAME_EVENT_RING;
+    if (!msg.eventsLost) {
+        for (uint32_t seq = since + 1; seq <= eventSeq; seq++) {
+            msg.events[msg.eventCount++] = ring[(seq - 1) % GAME_EVENT_RING];
+        }
+    }
+}
+
+// Состояния почтового слота клиента и его ящиков
+enum SlotState {
+    SLOT_FREE = 0,      // Слот никем не занят
+    SLOT_IDLE = 1,      // Слот занят клиентом / ящик пуст
+    SLOT_REQUEST = 2,   // Клиент положил запрос в ящик, сервер его еще не обработал
+    SLOT_RESPONSE = 3   // Сервер положил ответ в ящик
 };
 
-// Структура для общей памяти
+// Ящик почтового слота: один запрос в работе
+struct Mailbox {
+    std::atomic<uint32_t> state;   // SlotState
+    uint8_t frame[WIRE_MAX_FRAME]; // Кадр запроса, затем ответа (wire.h)
+};
+
+// Почтовый слот клиента: PIPELINE_DEPTH ящиков, клиент может отправить
+// несколько запросов, не дожидаясь ответов. Ответы приходят в любом порядке;
+// на слове completions (futex) клиент ждет любого из них.
+struct ClientSlot {
+    std::atomic<uint32_t> state;        // SLOT_FREE или SLOT_IDLE (слот занят)
+    pid_t ownerPid;                     // Процесс, занявший слот
+    std::atomic<uint32_t> completions;  // Растет с каждым ответом сервера
+    std::atomic<uint32_t> waiting;      // Клиент спит на completions
+    Mailbox boxes[PIPELINE_DEPTH];
+
+    // Свободный слот с пустыми ящиками (сервер при старте)
+    void init() {
+        state.store(SLOT_FREE, std::memory_order_relaxed);
+        ownerPid = 0;
+        completions.store(0, std::memory_order_relaxed);
+        waiting.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < PIPELINE_DEPTH; i++) {
+            boxes[i].state.store(SLOT_FREE, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Заголовок сегмента общей памяти. Игры лежат за ним кусками по GAME_CHUNK,
+// кусок k - по смещению gameChunks[k] от начала сегмента (см. arena.h).
+// Все игры куска - одного варианта chunkRules[k]
 struct SharedMemory {
-    Message message;
-    Game games[MAX_GAMES];
-    int gameCount;
+    RequestRing ring;                 // Очередь запросов от клиентов к серверу
+    ClientSlot slots[MAX_CLIENTS];
+    std::atomic<int> gameCount;   // Верхняя граница занятых слотов игр
+    std::atomic<uint32_t> arenaGeneration;  // Растет при каждом росте сегмента
+    std::atomic<uint64_t> arenaSize;        // Размер сегмента, байт
+    std::atomic<uint64_t> gameChunks[MAX_GAME_CHUNKS];  // 0 - куска еще нет
+    uint8_t chunkRules[MAX_GAME_CHUNKS];  // Вариант куска; пишется до публикации gameChunks[k]
 };
 
+// Игра по номеру слота. Кусок слота должен уже быть в сегменте (слот < gameCount)
+// и отображен у читателя (SharedArena::refresh)
+inline Game& gameAt(SharedMemory* sharedMem, int idx) {
+    uint64_t offset = sharedMem->gameChunks[idx / GAME_CHUNK].load(std::memory_order_acquire);
+    return reinterpret_cast<Game*>(reinterpret_cast<char*>(sharedMem) + offset)[idx % GAME_CHUNK];
+}
+
 #endif // COMMON_H
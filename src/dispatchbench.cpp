@@ -0,0 +1,209 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "common.h"
+#include "text.h"
+#include "bench.h"
+
+// Разбор запросов сервером без журнала и транспорта: прежний switch (имена
+// копируются в std::string, список игр собирается через +=, ответ - sprintf)
+// против таблицы обработчиков (string_view в поля сообщения, TextBuffer в msg.data).
+// Запросы - поровну GET_STATS и LIST_GAMES, игр в таблице BENCH_GAMES.
+//
+// ./dispatchbench [requests]
+
+#define BENCH_PLAYERS 64
+#define BENCH_GAMES 32
+
+// Счетчик выделений памяти: новый путь не должен выделять ничего
+static unsigned long g_allocations = 0;
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// Упрощенные таблицы сервера: игроки по номеру, игры с участником и состоянием
+struct BenchPlayer {
+    char username[64];
+    int wins;
+    int losses;
+};
+
+struct BenchGame {
+    char name[64];
+    PlayerId player1;
+    GameState state;
+    bool active;
+};
+
+BenchPlayer g_benchPlayers[BENCH_PLAYERS];
+BenchGame g_benchGames[BENCH_GAMES];
+
+float winRate(int wins, int losses) {
+    return wins + losses == 0 ? 0.0f : (float)wins * 100.0f / (float)(wins + losses);
+}
+
+// Прежний путь: один switch
+void oldHandleMessage(Message& msg) {
+    switch (msg.type) {
+        case Message::GET_STATS:
+            {
+                std::string username = msg.username;
+                const BenchPlayer& player = g_benchPlayers[msg.playerId];
+                msg.type = Message::STATS_DATA;
+                sprintf(msg.data, "Statistics for %s:\nWins: %d\nLosses: %d\nWin rate: %.1f%%",
+                        username.c_str(), player.wins, player.losses, winRate(player.wins, player.losses));
+            }
+            break;
+
+        case Message::LIST_GAMES:
+            {
+                msg.type = Message::GAMES_LIST;
+                std::string gamesList = "Available games:\n";
+                for (int i = 0; i < BENCH_GAMES; i++) {
+                    const BenchGame& game = g_benchGames[i];
+                    if (game.active && game.state == WAITING_FOR_PLAYER && game.player1 != msg.playerId) {
+                        gamesList += "- ";
+                        gamesList += game.name;
+                        gamesList += " (created by ";
+                        gamesList += g_benchPlayers[game.player1].username;
+                        gamesList += ")\n";
+                    }
+                }
+                strncpy(msg.data, gamesList.c_str(), sizeof(msg.data) - 1);
+                msg.data[sizeof(msg.data) - 1] = '\0';
+            }
+            break;
+
+        default:
+            msg.type = Message::ERROR;
+            strcpy(msg.data, "Unknown command");
+            break;
+    }
+}
+
+// Нынешний путь: обработчик по типу из таблицы
+void handleGetStats(Message& msg) {
+    std::string_view username = fieldView(msg.username);
+    const BenchPlayer& player = g_benchPlayers[msg.playerId];
+    msg.type = Message::STATS_DATA;
+    TextBuffer(msg.data).format("Statistics for %.*s:\nWins: %d\nLosses: %d\nWin rate: %.1f%%",
+                                (int)username.size(), username.data(), player.wins, player.losses,
+                                winRate(player.wins, player.losses));
+}
+
+void handleListGames(Message& msg) {
+    msg.type = Message::GAMES_LIST;
+    TextBuffer gamesList(msg.data);
+    gamesList.append("Available games:\n");
+    for (int i = 0; i < BENCH_GAMES && !gamesList.full(); i++) {
+        const BenchGame& game = g_benchGames[i];
+        if (game.active && game.state == WAITING_FOR_PLAYER && game.player1 != msg.playerId) {
+            gamesList.append("- ").append(game.name).append(" (created by ")
+                     .append(g_benchPlayers[game.player1].username).append(")\n");
+        }
+    }
+}
+
+void handleUnknown(Message& msg) {
+    msg.type = Message::ERROR;
+    strcpy(msg.data, "Unknown command");
+}
+
+typedef void (*BenchHandler)(Message& msg);
+const int BENCH_TYPE_LIMIT = Message::GAME_EVENTS_RESPONSE + 1;
+
+struct BenchHandlers {
+    BenchHandler byType[BENCH_TYPE_LIMIT];
+
+    constexpr BenchHandlers() : byType() {
+        for (int i = 0; i < BENCH_TYPE_LIMIT; i++) {
+            byType[i] = handleUnknown;
+        }
+        byType[Message::GET_STATS] = handleGetStats;
+        byType[Message::LIST_GAMES] = handleListGames;
+    }
+};
+
+constexpr BenchHandlers g_benchHandlers;
+
+void newHandleMessage(Message& msg) {
+    int type = msg.type;
+    if (type < 0 || type >= BENCH_TYPE_LIMIT) {
+        handleUnknown(msg);
+        return;
+    }
+    g_benchHandlers.byType[type](msg);
+}
+
+// Запросов в секунду; allocations - выделений памяти на запрос
+template <class Handle>
+double runRequests(Handle handle, int requests, double& allocations, uint64_t& checksum) {
+    Message* msg = new Message();
+    unsigned long allocationsBefore = g_allocations;
+    Stopwatch stopwatch;
+    for (int i = 0; i < requests; i++) {
+        memset(msg, 0, sizeof(*msg));
+        msg->type = i % 2 == 0 ? Message::GET_STATS : Message::LIST_GAMES;
+        msg->playerId = i % BENCH_PLAYERS;
+        strcpy(msg->username, g_benchPlayers[msg->playerId].username);
+        handle(*msg);
+        checksum += (unsigned char)msg->data[i % 64] + msg->type;
+    }
+    double seconds = stopwatch.seconds();
+    allocations = (double)(g_allocations - allocationsBefore) / requests;
+    delete msg;
+    return requests / seconds;
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[requests]");
+    int requests = (int)args.integer(1, 2000000, 1, INT_MAX);
+
+    // Каждая четвертая игра ждет соперника
+    for (int i = 0; i < BENCH_PLAYERS; i++) {
+        snprintf(g_benchPlayers[i].username, sizeof(g_benchPlayers[i].username), "player_with_long_name_%d", i);
+        g_benchPlayers[i].wins = i;
+        g_benchPlayers[i].losses = 2 * i;
+    }
+    for (int i = 0; i < BENCH_GAMES; i++) {
+        snprintf(g_benchGames[i].name, sizeof(g_benchGames[i].name), "game_number_%d", i);
+        g_benchGames[i].player1 = i % BENCH_PLAYERS;
+        g_benchGames[i].state = i % 4 == 0 ? WAITING_FOR_PLAYER : PLAYER1_TURN;
+        g_benchGames[i].active = true;
+    }
+
+    uint64_t oldChecksum = 0, newChecksum = 0;
+    double oldAllocations, newAllocations;
+    double oldRate = runRequests(oldHandleMessage, requests, oldAllocations, oldChecksum);
+    double newRate = runRequests(newHandleMessage, requests, newAllocations, newChecksum);
+    if (oldChecksum != newChecksum) {
+        std::cerr << "Responses differ" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "switch + std::string: " << oldRate << " requests/s, " << std::setprecision(2)
+              << oldAllocations << " allocations per request" << std::endl;
+    std::cout << std::setprecision(0);
+    std::cout << "handler table:        " << newRate << " requests/s, " << std::setprecision(2)
+              << newAllocations << " allocations per request" << std::endl;
+    return 0;
+}
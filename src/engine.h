@@ -0,0 +1,541 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <cstdint>
+#include "common.h"
+#include "board.h"
+
+// Игра целиком без ввода-вывода: правила хода поверх board.h, случайная
+// расстановка флота и стратегии выбора выстрела. Используется сервером
+// (ходы, бот) и автономной симуляцией (simulate.cpp)
+
+// Генератор xorshift64*: у каждого потока свой (rand() общий и под блокировкой)
+struct GameRandom {
+    uint64_t state;
+
+    explicit GameRandom(uint64_t seedValue = 1) {
+        seed(seedValue);
+    }
+
+    // Любое зерно (и 0) через splitmix64 дает ненулевое состояние
+    void seed(uint64_t seedValue) {
+        uint64_t z = seedValue + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        state = (z ^ (z >> 31)) | 1;
+    }
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    // Число от 0 до n - 1
+    uint32_t below(uint32_t n) {
+        return (uint32_t)(((next() >> 32) * n) >> 32);
+    }
+};
+
+// Без -mpopcnt __builtin_popcountll - вызов libgcc, битовый подсчет быстрее
+inline int wordPopcount(uint64_t bits) {
+    bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+    bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((bits * 0x0101010101010101ull) >> 56);
+}
+
+// Операции над масками поля - для каждого типа маски вариантов (rules.h)
+inline int maskPopcount(uint64_t mask) {
+    return wordPopcount(mask);
+}
+
+inline int maskPopcount(unsigned __int128 mask) {
+    return wordPopcount((uint64_t)mask) + wordPopcount((uint64_t)(mask >> 64));
+}
+
+inline int maskPopcount(const WideMask& mask) {
+    return wordPopcount(mask.words[0]) + wordPopcount(mask.words[1]) +
+           wordPopcount(mask.words[2]) + wordPopcount(mask.words[3]);
+}
+
+// Номер k-го (с нуля) установленного бита: байт находим по нарастающим суммам
+// битов по байтам (одно умножение), внутри байта снимаем младшие биты
+inline int wordSelect(uint64_t bits, int k) {
+    uint64_t counts = bits - ((bits >> 1) & 0x5555555555555555ull);
+    counts = (counts & 0x3333333333333333ull) + ((counts >> 2) & 0x3333333333333333ull);
+    counts = (counts + (counts >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    uint64_t sums = counts * 0x0101010101010101ull;   // В байте i - битов в байтах 0..i
+
+    int shift = 0;
+    while ((int)((sums >> shift) & 0xFF) <= k) {
+        shift += 8;
+    }
+    if (shift > 0) {
+        k -= (int)((sums >> (shift - 8)) & 0xFF);
+    }
+    uint64_t byte = (bits >> shift) & 0xFF;
+    while (k-- > 0) {
+        byte &= byte - 1;
+    }
+    return shift + __builtin_ctzll(byte);
+}
+
+inline int maskSelect(uint64_t mask, int k) {
+    return wordSelect(mask, k);
+}
+
+inline int maskSelect(unsigned __int128 mask, int k) {
+    int low = wordPopcount((uint64_t)mask);
+    if (k >= low) {
+        return 64 + wordSelect((uint64_t)(mask >> 64), k - low);
+    }
+    return wordSelect((uint64_t)mask, k);
+}
+
+inline int maskSelect(const WideMask& mask, int k) {
+    int word = 0;
+    for (int count = wordPopcount(mask.words[0]); k >= count && word < 3; count = wordPopcount(mask.words[++word])) {
+        k -= count;
+    }
+    return 64 * word + wordSelect(mask.words[word], k);
+}
+
+// Номер младшего установленного бита непустой маски
+inline int maskLowest(uint64_t mask) {
+    return __builtin_ctzll(mask);
+}
+
+inline int maskLowest(unsigned __int128 mask) {
+    uint64_t low = (uint64_t)mask;
+    return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll((uint64_t)(mask >> 64));
+}
+
+inline int maskLowest(const WideMask& mask) {
+    int word = 0;
+    while (mask.words[word] == 0) {
+        word++;
+    }
+    return 64 * word + __builtin_ctzll(mask.words[word]);
+}
+
+// Маска без младшего установленного бита
+inline uint64_t maskClearLowest(uint64_t mask) {
+    return mask & (mask - 1);
+}
+
+inline unsigned __int128 maskClearLowest(unsigned __int128 mask) {
+    return mask & (mask - 1);
+}
+
+inline WideMask maskClearLowest(WideMask mask) {
+    for (int word = 0; word < 4; word++) {
+        if (mask.words[word] != 0) {
+            mask.words[word] &= mask.words[word] - 1;
+            break;
+        }
+    }
+    return mask;
+}
+
+// Клетки столбцов firstColumn..lastColumn. Без левого (правого) края поля - чтобы
+// сдвиг маски по строке не переносил клетку на соседнюю строку
+template <class Rules>
+constexpr typename Rules::Mask columnsFrom(int firstColumn, int lastColumn) {
+    typename Rules::Mask mask = 0;
+    for (int y = 0; y < Rules::SIZE; y++) {
+        for (int x = firstColumn; x <= lastColumn; x++) {
+            mask |= cellBit<Rules>(x, y);
+        }
+    }
+    return mask;
+}
+
+// Все клетки поля
+template <class Rules>
+inline constexpr typename Rules::Mask g_boardCells = columnsFrom<Rules>(0, Rules::SIZE - 1);
+
+template <class Rules>
+inline typename Rules::Mask boardCells() {
+    return g_boardCells<Rules>;
+}
+
+// Соседи клеток маски слева и справа
+template <class Rules>
+inline typename Rules::Mask horizontalNeighbours(typename Rules::Mask mask) {
+    static constexpr typename Rules::Mask notLastColumn = columnsFrom<Rules>(0, Rules::SIZE - 2);
+    static constexpr typename Rules::Mask notFirstColumn = columnsFrom<Rules>(1, Rules::SIZE - 1);
+    return ((mask & notLastColumn) << 1) | ((mask & notFirstColumn) >> 1);
+}
+
+// Соседи клеток маски по стороне
+template <class Rules>
+inline typename Rules::Mask orthogonalNeighbours(typename Rules::Mask mask) {
+    return (horizontalNeighbours<Rules>(mask) | (mask << Rules::SIZE) | (mask >> Rules::SIZE)) & boardCells<Rules>();
+}
+
+// Соседи клеток маски по диагонали
+template <class Rules>
+inline typename Rules::Mask diagonalNeighbours(typename Rules::Mask mask) {
+    typename Rules::Mask sides = horizontalNeighbours<Rules>(mask);
+    return ((sides << Rules::SIZE) | (sides >> Rules::SIZE)) & boardCells<Rules>();
+}
+
+// Кто ходит после выстрела игрока shooter (1/2) с результатом processMove:
+// промах передает ход, попадание оставляет, недопустимый выстрел не считается.
+// 0 - все корабли соперника потоплены, shooter победил
+inline int nextTurn(int shooter, int result) {
+    if (result == 0) {
+        return 3 - shooter;
+    }
+    return result == 3 ? 0 : shooter;
+}
+
+// Партия двух игроков целиком в памяти (для симуляции)
+template <class Rules>
+struct Match {
+    GameBoard<Rules> boards[2];   // Поля первого и второго игрока
+    int turn;              // Чей ход: 1 или 2, 0 - партия окончена
+    int winner;            // Победитель, 0 - партия идет
+    int shots[2];          // Выстрелов каждого игрока
+
+    Match() : turn(1), winner(0), shots{0, 0} {}
+};
+
+// Выстрел того, чей ход; результат - как у processMove
+template <class Rules>
+inline int matchShot(Match<Rules>& match, int x, int y) {
+    int shooter = match.turn;
+    int result = processMove(match.boards[2 - shooter], x, y);
+    if (result >= 0) {
+        match.shots[shooter - 1]++;
+    }
+    match.turn = nextTurn(shooter, result);
+    if (match.turn == 0) {
+        match.winner = shooter;
+    }
+    return result;
+}
+
+// Клетки, с которых корабль помещается, не задевая forbidden (ореолы других кораблей):
+// начало корабля сдвигами маски свободных клеток, без перебора положений
+template <int Step, class Mask>
+inline Mask freeRuns(int length, Mask free) {
+    switch (length) {
+        case BATTLESHIP: return free & (free >> Step) & (free >> 2 * Step) & (free >> 3 * Step);
+        case CRUISER: return free & (free >> Step) & (free >> 2 * Step);
+        case DESTROYER: return free & (free >> Step);
+        default: return free;
+    }
+}
+
+template <class Rules>
+inline typename Rules::Mask freeStarts(int length, int orientation, typename Rules::Mask forbidden) {
+    typename Rules::Mask starts = g_placementTable<Rules>.starts[length][orientation];
+    return starts & (orientation == 0 ? freeRuns<1>(length, ~forbidden) : freeRuns<Rules::SIZE>(length, ~forbidden));
+}
+
+// Случайное из положений корабля длины length, не задевающих forbidden; все
+// подходящие положения равновероятны. Сначала до attempts раз угадываем, потом
+// считаем. false - кораблю места нет
+template <class Rules>
+inline bool randomShipPosition(int length, typename Rules::Mask forbidden, ShipPlacement& ship, GameRandom& random,
+                               int attempts) {
+    typedef typename Rules::Mask Mask;
+
+    // Пока места много, угадываем положение среди всех и проверяем по таблице
+    const PlacementTable<Rules>& table = g_placementTable<Rules>;
+    int orientations = length == SUBMARINE ? 1 : 2;
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        int chosen = random.below(orientations * Rules::CELLS);
+        int orientation = chosen / Rules::CELLS;
+        int cell = chosen % Rules::CELLS;
+        const Mask& footprint = table.positions[length][orientation][cell].footprint;
+        if (footprint != 0 && !(footprint & forbidden)) {
+            ship.horizontal = orientation == 0;
+            ship.x = cell % Rules::SIZE;
+            ship.y = cell / Rules::SIZE;
+            ship.length = length;
+            return true;
+        }
+    }
+
+    // Иначе считаем все подходящие положения масками
+    Mask horizontal = freeStarts<Rules>(length, 0, forbidden);
+    // У однопалубного обе ориентации совпадают - считаем его горизонтальным
+    Mask vertical = length == SUBMARINE ? Mask(0) : freeStarts<Rules>(length, 1, forbidden);
+    int horizontalCount = maskPopcount(horizontal);
+    int count = horizontalCount + maskPopcount(vertical);
+    if (count == 0) {
+        return false;
+    }
+
+    int chosen = random.below(count);
+    ship.horizontal = chosen < horizontalCount;
+    int cell = ship.horizontal ? maskSelect(horizontal, chosen) : maskSelect(vertical, chosen - horizontalCount);
+    ship.x = cell % Rules::SIZE;
+    ship.y = cell / Rules::SIZE;
+    ship.length = length;
+    return true;
+}
+
+template <class Rules>
+inline const ShipPosition<typename Rules::Mask>& shipPosition(const ShipPlacement& ship) {
+    return shipPosition<Rules>(ship.x, ship.y, ship.length, ship.horizontal);
+}
+
+// Длины кораблей флота от меньших к большим
+template <class Rules>
+struct FleetLengths {
+    int lengths[Rules::TOTAL_SHIPS];
+
+    constexpr FleetLengths() : lengths() {
+        int count = 0;
+        for (int length = SUBMARINE; length <= BATTLESHIP; length++) {
+            for (int i = 0; i < Rules::shipCount(length); i++) {
+                lengths[count++] = length;
+            }
+        }
+    }
+};
+
+template <class Rules>
+inline constexpr FleetLengths<Rules> g_fleetLengths;
+
+#define AUTO_PLACE_SWEEPS 3   // Проходов перестановки кораблей после начальной расстановки
+
+// Случайный флот по правилам (AUTO_PLACE, бот, симуляция), приближенно
+// равномерный среди допустимых флотов.
+// Сначала корабли ставятся от меньших к большим, каждый - в случайное положение,
+// не задевающее уже поставленных (если места нет - переставляем предыдущий).
+// Такая расстановка далека от равномерной (доли занятости клеток - до 20%),
+// поэтому дальше каждый корабль sweeps раз переставляется в случайное
+// допустимое при остальных положение: от такого шага равномерное распределение
+// не меняется, а к нему приближаемся, но за конечное число проходов не доходим.
+// Смещение по placetest (миллион флотов): после трех проходов доли клеток
+// отличаются от равномерных до 1% (в пределах шума), доли положений линкора -
+// в среднем на 1.5% на малом поле и 0.6-0.9% на остальных; после двух -
+// до 1.5-2.5% и 1-4.5%. Скорость при трех проходах - около 700000
+// флотов/с на малом поле, 380000 на классике и 110000 на большом. Точная выборка
+// отбором целых флотов - 40000, 3000 и 7.5 флотов/с (годен 1 из 380, 4000 и 790000)
+template <class Rules>
+inline void autoPlaceFleet(ShipPlacement fleet[Rules::TOTAL_SHIPS], GameRandom& random,
+                           int sweeps = AUTO_PLACE_SWEEPS) {
+    typedef typename Rules::Mask Mask;
+    const int* lengths = g_fleetLengths<Rules>.lengths;
+    Mask halos[Rules::TOTAL_SHIPS];
+    Mask forbidden[Rules::TOTAL_SHIPS + 1];   // Ореолы кораблей до i-го
+    forbidden[0] = 0;
+    int placed = 0;
+    int backtracks = 0;
+
+    while (placed < Rules::TOTAL_SHIPS) {
+        if (!randomShipPosition<Rules>(lengths[placed], forbidden[placed], fleet[placed], random, 6)) {
+            // Тупик: возвращаемся на корабль назад, а если тупики повторяются - начинаем заново
+            placed = ++backtracks < 16 && placed > 0 ? placed - 1 : 0;
+            if (placed == 0) {
+                backtracks = 0;
+            }
+            continue;
+        }
+        halos[placed] = shipPosition<Rules>(fleet[placed]).halo;
+        forbidden[placed + 1] = forbidden[placed] | halos[placed];
+        placed++;
+    }
+
+    // Ореолы остальных кораблей: уже переставленные до i-го плюс еще не тронутые после
+    Mask after[Rules::TOTAL_SHIPS + 1];
+    for (int sweep = 0; sweep < sweeps; sweep++) {
+        after[Rules::TOTAL_SHIPS] = 0;
+        for (int i = Rules::TOTAL_SHIPS - 1; i >= 0; i--) {
+            after[i] = after[i + 1] | halos[i];
+        }
+        Mask before = 0;
+        for (int i = 0; i < Rules::TOTAL_SHIPS; i++) {
+            // Остальные корабли стоят плотно - угадывать почти бесполезно, сразу считаем.
+            // Текущее положение корабля допустимо, так что место найдется всегда
+            randomShipPosition<Rules>(fleet[i].length, before | after[i + 1], fleet[i], random, 0);
+            halos[i] = shipPosition<Rules>(fleet[i]).halo;
+            before |= halos[i];
+        }
+    }
+}
+
+// Ставим на пустое поле уже проверенный флот (например, из autoPlaceFleet)
+template <class Rules>
+inline void setFleet(GameBoard<Rules>& board, const ShipPlacement fleet[Rules::TOTAL_SHIPS]) {
+    board = GameBoard<Rules>();
+    for (int i = 0; i < Rules::TOTAL_SHIPS; i++) {
+        placeShip(board, fleet[i].x, fleet[i].y, fleet[i].length, fleet[i].horizontal);
+    }
+}
+
+// Стратегии выбора выстрела по полю противника (видны только результаты выстрелов).
+// false - стрелять некуда
+
+// Случайная клетка из нетронутых. Пока их много, просто угадываем клетку,
+// перебор битов маски - только под конец партии
+template <class Rules>
+inline bool randomShot(const GameBoard<Rules>& board, int& outX, int& outY, GameRandom& random) {
+    typedef typename Rules::Mask Mask;
+    Mask open = boardCells<Rules>() & ~board.shotMask;
+    for (int attempt = 0; attempt < 4; attempt++) {
+        int cell = random.below(Rules::CELLS);
+        if (open & ((Mask)1 << cell)) {
+            outX = cell % Rules::SIZE;
+            outY = cell / Rules::SIZE;
+            return true;
+        }
+    }
+    int count = maskPopcount(open);
+    if (count == 0) {
+        return false;
+    }
+    int cell = maskSelect(open, random.below(count));
+    outX = cell % Rules::SIZE;
+    outY = cell / Rules::SIZE;
+    return true;
+}
+
+// Охота и добивание: случайная клетка не рядом с потопленными, а после
+// попадания - случайная соседняя по стороне с недобитым кораблем
+template <class Rules>
+inline bool huntShot(const GameBoard<Rules>& board, int& outX, int& outY, GameRandom& random) {
+    typedef typename Rules::Mask Mask;
+    Mask open = boardCells<Rules>() & ~board.shotMask;
+    Mask hits = board.shotMask & board.shipMask & ~board.destroyedMask;
+    Mask sunk = board.destroyedMask;
+    Mask candidates = open & ~(sunk | orthogonalNeighbours<Rules>(sunk) | diagonalNeighbours<Rules>(sunk));
+    if (hits) {
+        Mask next = candidates & orthogonalNeighbours<Rules>(hits) & ~diagonalNeighbours<Rules>(hits);
+        if (next) {
+            candidates = next;
+        }
+    }
+    if (!candidates) {
+        candidates = open;
+    }
+    int count = maskPopcount(candidates);
+    if (count == 0) {
+        return false;
+    }
+    int cell = maskSelect(candidates, random.below(count));
+    outX = cell % Rules::SIZE;
+    outY = cell / Rules::SIZE;
+    return true;
+}
+
+// Что бот знает о поле противника - только результаты выстрелов:
+// промахи, попадания и потопленные корабли (они видны целиком)
+template <class Rules>
+struct BotTargetView {
+    typename Rules::Mask open;      // Клетки, по которым еще не стреляли
+    typename Rules::Mask hits;      // Попадания по недобитым кораблям
+    typename Rules::Mask blocked;   // Клетки, где кораблей быть не может
+    int remaining[BATTLESHIP + 1];  // Непотопленные корабли по длине
+};
+
+template <class Rules>
+inline BotTargetView<Rules> botTargetView(const GameBoard<Rules>& board) {
+    BotTargetView<Rules> view;
+    view.open = boardCells<Rules>() & ~board.shotMask;
+    view.hits = board.shotMask & board.shipMask & ~board.destroyedMask;
+    view.blocked = (board.shotMask & ~board.shipMask) | board.destroyedMask;
+
+    for (int length = 0; length <= BATTLESHIP; length++) {
+        view.remaining[length] = Rules::shipCount(length);
+    }
+
+    // Вокруг потопленного корабля других кораблей нет (корабли не касаются)
+    for (int i = 0; i < board.shipsPlaced; i++) {
+        const Ship& ship = board.ships[i];
+        if (!ship.isDestroyed()) {
+            continue;
+        }
+        view.remaining[ship.length]--;
+        view.blocked |= shipPosition<Rules>(ship.x, ship.y, ship.length, ship.horizontal).halo;
+    }
+
+    // По диагонали от попадания - тоже: там был бы другой корабль, касающийся этого
+    view.blocked |= diagonalNeighbours<Rules>(view.hits);
+    return view;
+}
+
+// Выбор выстрела по плотности: для каждой клетки считаем, сколько допустимых
+// расстановок оставшихся кораблей ее накрывает, и стреляем в самую плотную.
+// Охота: годятся все расстановки, не задевающие известно пустых клеток.
+// Добивание (есть попадания по недобитому кораблю): только расстановки через
+// попадания, чем больше попаданий накрыто - тем больше вес.
+// Равные клетки выбираются случайно. false - стрелять некуда
+// Положения перебираем только среди начал, не задевающих blocked (freeStarts),
+// остальные проверки - пересечения с масками из таблицы положений
+template <class Rules>
+inline bool botChooseShot(const GameBoard<Rules>& board, int& outX, int& outY, GameRandom& random) {
+    typedef typename Rules::Mask Mask;
+    BotTargetView<Rules> view = botTargetView(board);
+    bool targeting = view.hits != 0;
+    uint32_t density[Rules::CELLS] = {};
+
+    for (int length = SUBMARINE; length <= BATTLESHIP; length++) {
+        if (view.remaining[length] <= 0) {
+            continue;
+        }
+        for (int orientation = 0; orientation < (length == SUBMARINE ? 1 : 2); orientation++) {
+            const ShipPosition<Mask>* positions = g_placementTable<Rules>.positions[length][orientation];
+            Mask starts = freeStarts<Rules>(length, orientation, view.blocked);
+            // При добивании корабль должен накрыть попадание: его начало не дальше
+            // length - 1 клеток до попадания (влево или вверх)
+            if (targeting) {
+                Mask reach = view.hits;
+                for (int i = 1; i < length; i++) {
+                    reach |= orientation == 0 ? view.hits >> i : view.hits >> (i * Rules::SIZE);
+                }
+                starts &= reach;
+            }
+            while (starts != 0) {
+                const ShipPosition<Mask>& position = positions[maskLowest(starts)];
+                starts = maskClearLowest(starts);
+                if (position.halo & ~position.footprint & view.hits) {
+                    continue; // корабль касался бы чужого попадания
+                }
+                int covered = maskPopcount(position.footprint & view.hits);
+                if (targeting && covered == 0) {
+                    continue;
+                }
+                uint32_t weight = (uint32_t)view.remaining[length] * (targeting ? 1 + 16 * covered : 1);
+                Mask cells = position.footprint & view.open;
+                while (cells != 0) {
+                    density[maskLowest(cells)] += weight;
+                    cells = maskClearLowest(cells);
+                }
+            }
+        }
+    }
+
+    // Самая плотная клетка; при равенстве - случайная из равных
+    uint32_t best = 0;
+    int ties = 0;
+    bool found = false;
+    for (int y = 0; y < Rules::SIZE; y++) {
+        for (int x = 0; x < Rules::SIZE; x++) {
+            if (!(view.open & cellBit<Rules>(x, y))) {
+                continue;
+            }
+            uint32_t value = density[y * Rules::SIZE + x];
+            if (!found || value > best) {
+                best = value;
+                ties = 1;
+                outX = x;
+                outY = y;
+                found = true;
+            } else if (value == best && random.below(++ties) == 0) {
+                outX = x;
+                outY = y;
+            }
+        }
+    }
+    return found;
+}
+
+#endif // ENGINE_H
@@ -0,0 +1,269 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include "common.h"
+#include "board.h"
+#include "engine.h"
+#include "bench.h"
+
+// Сверка движка на битовых масках с прежним движком, который хранил клетки
+// массивом и искал корабль перебором (board.h до битовых масок, обобщен на
+// варианты правил). Случайные партии с заданным зерном проигрываются на обоих
+// полях одновременно, каждый результат и каждая клетка должны совпасть.
+//
+// ./enginetest [games] [seed]   (партий на каждый вариант правил)
+
+// Прежнее поле: клетки массивом, корабли списком
+template <class Rules>
+struct ReferenceBoard {
+    CellState cells[Rules::SIZE][Rules::SIZE];
+    Ship ships[Rules::TOTAL_SHIPS];
+    int shipsPlaced;
+
+    ReferenceBoard() : shipsPlaced(0) {
+        for (int y = 0; y < Rules::SIZE; y++) {
+            for (int x = 0; x < Rules::SIZE; x++) {
+                cells[y][x] = EMPTY;
+            }
+        }
+    }
+
+    bool allShipsDestroyed() const {
+        for (int i = 0; i < shipsPlaced; i++) {
+            if (!ships[i].isDestroyed()) {
+                return false;
+            }
+        }
+        return shipsPlaced == Rules::TOTAL_SHIPS;
+    }
+};
+
+template <class Rules>
+bool referencePlaceShip(ReferenceBoard<Rules>& board, int x, int y, int length, bool horizontal) {
+    if (x < 0 || y < 0 || x >= Rules::SIZE || y >= Rules::SIZE) {
+        return false;
+    }
+    if ((horizontal ? x : y) + length > Rules::SIZE) {
+        return false;
+    }
+
+    for (int i = -1; i <= length; i++) {
+        for (int j = -1; j <= 1; j++) {
+            int checkX = horizontal ? x + i : x + j;
+            int checkY = horizontal ? y + j : y + i;
+            if (checkX >= 0 && checkX < Rules::SIZE && checkY >= 0 && checkY < Rules::SIZE &&
+                board.cells[checkY][checkX] == SHIP) {
+                return false;
+            }
+        }
+    }
+
+    if (board.shipsPlaced >= Rules::TOTAL_SHIPS) {
+        return false;
+    }
+
+    Ship& ship = board.ships[board.shipsPlaced];
+    ship.x = x;
+    ship.y = y;
+    ship.length = length;
+    ship.horizontal = horizontal;
+    ship.hits = 0;
+    for (int i = 0; i < length; i++) {
+        if (horizontal) {
+            board.cells[y][x + i] = SHIP;
+        } else {
+            board.cells[y + i][x] = SHIP;
+        }
+    }
+    board.shipsPlaced++;
+    return true;
+}
+
+template <class Rules>
+bool referenceCanPlaceShipOfLength(const ReferenceBoard<Rules>& board, int length) {
+    if (length < SUBMARINE || length > BATTLESHIP) {
+        return false;
+    }
+    int shipsOfLength[BATTLESHIP + 1] = {0};
+    for (int i = 0; i < board.shipsPlaced; i++) {
+        shipsOfLength[board.ships[i].length]++;
+    }
+    return shipsOfLength[length] < Rules::shipCount(length);
+}
+
+template <class Rules>
+bool referenceAreAllShipsPlaced(const ReferenceBoard<Rules>& board) {
+    int actual[BATTLESHIP + 1] = {0};
+    for (int i = 0; i < board.shipsPlaced; i++) {
+        actual[board.ships[i].length]++;
+    }
+    for (int length = SUBMARINE; length <= BATTLESHIP; length++) {
+        if (actual[length] != Rules::shipCount(length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Rules>
+int referenceProcessMove(ReferenceBoard<Rules>& board, int x, int y) {
+    if (x < 0 || y < 0 || x >= Rules::SIZE || y >= Rules::SIZE) {
+        return -1;
+    }
+    CellState cell = board.cells[y][x];
+    if (cell == MISS || cell == HIT || cell == DESTROYED) {
+        return -2;
+    }
+    if (cell == EMPTY) {
+        board.cells[y][x] = MISS;
+        return 0;
+    }
+
+    board.cells[y][x] = HIT;
+    for (int i = 0; i < board.shipsPlaced; i++) {
+        Ship& ship = board.ships[i];
+        bool hit = false;
+        for (int j = 0; j < ship.length && !hit; j++) {
+            hit = (ship.horizontal ? ship.x + j : ship.x) == x && (ship.horizontal ? ship.y : ship.y + j) == y;
+        }
+        if (!hit) {
+            continue;
+        }
+        ship.hits++;
+        if (!ship.isDestroyed()) {
+            return 1;
+        }
+        for (int j = 0; j < ship.length; j++) {
+            board.cells[ship.horizontal ? ship.y : ship.y + j][ship.horizontal ? ship.x + j : ship.x] = DESTROYED;
+        }
+        return board.allShipsDestroyed() ? 3 : 2;
+    }
+    return 0;
+}
+
+// Счетчики сверки одного варианта
+struct DiffStats {
+    uint64_t placements;
+    uint64_t shots;
+    uint64_t wins;        // Партий, доигранных до победы
+    uint64_t mismatches;
+};
+
+template <class Rules>
+bool sameCells(const GameBoard<Rules>& board, const ReferenceBoard<Rules>& reference) {
+    for (int y = 0; y < Rules::SIZE; y++) {
+        for (int x = 0; x < Rules::SIZE; x++) {
+            if (board.cellAt(x, y) != reference.cells[y][x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <class Rules>
+void reportMismatch(DiffStats& stats, uint64_t game, const char* what) {
+    if (stats.mismatches++ < 10) {
+        std::cerr << g_rulesInfo[Rules::ID].name << " game " << game << ": " << what << " differs" << std::endl;
+    }
+}
+
+// Одна партия: расстановка (случайными попытками или готовым флотом), затем
+// случайные выстрелы, в том числе мимо поля и повторные
+template <class Rules>
+void replayGame(uint64_t game, GameRandom& random, DiffStats& stats) {
+    GameBoard<Rules> board;
+    ReferenceBoard<Rules> reference;
+
+    if (random.below(2) == 0) {
+        for (int attempt = 0; attempt < 40 * Rules::TOTAL_SHIPS; attempt++) {
+            int x = (int)random.below(Rules::SIZE + 2) - 1;
+            int y = (int)random.below(Rules::SIZE + 2) - 1;
+            int length = (int)random.below(BATTLESHIP + 2);
+            bool horizontal = random.below(2) == 0;
+
+            // Как сервер: сначала проверка длины, потом постановка
+            bool canPlace = canPlaceShipOfLength(board, length);
+            if (canPlace != referenceCanPlaceShipOfLength(reference, length)) {
+                reportMismatch<Rules>(stats, game, "canPlaceShipOfLength");
+            }
+            if (!canPlace) {
+                continue;
+            }
+            stats.placements++;
+            if (placeShip(board, x, y, length, horizontal) != referencePlaceShip(reference, x, y, length, horizontal)) {
+                reportMismatch<Rules>(stats, game, "placeShip");
+            }
+        }
+    } else {
+        ShipPlacement fleet[Rules::TOTAL_SHIPS];
+        autoPlaceFleet<Rules>(fleet, random);
+        for (int i = 0; i < Rules::TOTAL_SHIPS; i++) {
+            stats.placements++;
+            if (placeShip(board, fleet[i].x, fleet[i].y, fleet[i].length, fleet[i].horizontal) !=
+                referencePlaceShip(reference, fleet[i].x, fleet[i].y, fleet[i].length, fleet[i].horizontal)) {
+                reportMismatch<Rules>(stats, game, "placeShip (fleet)");
+            }
+        }
+    }
+
+    if (areAllShipsPlaced(board) != referenceAreAllShipsPlaced(reference)) {
+        reportMismatch<Rules>(stats, game, "areAllShipsPlaced");
+    }
+    if (board.shipsPlaced != reference.shipsPlaced || !sameCells(board, reference)) {
+        reportMismatch<Rules>(stats, game, "board after placement");
+    }
+
+    for (int shot = 0; shot < 6 * Rules::CELLS; shot++) {
+        int x = (int)random.below(Rules::SIZE + 2) - 1;
+        int y = (int)random.below(Rules::SIZE + 2) - 1;
+        stats.shots++;
+        int result = processMove(board, x, y);
+        if (result != referenceProcessMove(reference, x, y)) {
+            reportMismatch<Rules>(stats, game, "processMove");
+        }
+        if (board.allShipsDestroyed() != reference.allShipsDestroyed()) {
+            reportMismatch<Rules>(stats, game, "allShipsDestroyed");
+        }
+        // Потопление меняет клетки всего корабля - сверяем поле целиком, иначе одну клетку
+        if (result >= 2 ? !sameCells(board, reference)
+                        : result >= 0 && board.cellAt(x, y) != reference.cells[y][x]) {
+            reportMismatch<Rules>(stats, game, "cells after processMove");
+        }
+        if (result == 3) {
+            stats.wins++;
+            break;
+        }
+    }
+
+    if (!sameCells(board, reference)) {
+        reportMismatch<Rules>(stats, game, "final board");
+    }
+    for (int i = 0; i < reference.shipsPlaced; i++) {
+        if (board.ships[i].hits != reference.ships[i].hits) {
+            reportMismatch<Rules>(stats, game, "ship hits");
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[games] [seed]");
+    long games = args.integer(1, 50000, 1);
+    uint64_t seed = args.seed(2, 1);
+
+    uint64_t mismatches = 0;
+    for (int rules = 0; rules < RULES_COUNT; rules++) {
+        withRules(rules, [&](auto variant) {
+            typedef decltype(variant) Rules;
+            DiffStats stats = {0, 0, 0, 0};
+            for (long game = 0; game < games; game++) {
+                GameRandom random(seed + game);
+                replayGame<Rules>(game, random, stats);
+            }
+            std::cout << g_rulesInfo[Rules::ID].name << ": " << games << " games, " << stats.placements << " placements, "
+                      << stats.shots << " shots, " << stats.wins << " wins, " << stats.mismatches << " mismatches" << std::endl;
+            mismatches += stats.mismatches;
+        });
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include <atomic>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Размер кольца запросов (степень двойки). Не меньше числа запросов, которые
+// могут быть в работе сразу: ящики клиентов общей памяти (MAX_CLIENTS * PIPELINE_DEPTH),
+// ходы бота (BOT_MAX_MOVES) и доля сокетного транспорта (SOCKET_RING_SHARE) -
+// тогда ни кольцо сервера, ни очереди шардов не переполняются (проверка в server.cpp)
+#define REQUEST_RING_SIZE 1024
+
+// Ожидание на futex-слове в общей памяти, пока оно равно expected.
+// timeoutMs < 0 - ждем без ограничения. Возвращает false по таймауту.
+inline bool futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs = -1) {
+    struct timespec ts;
+    struct timespec* tsPtr = nullptr;
+    if (timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (long)(timeoutMs % 1000) * 1000000L;
+        tsPtr = &ts;
+    }
+    long rc = syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, tsPtr, nullptr, 0);
+    return !(rc == -1 && errno == ETIMEDOUT);
+}
+
+// Будим ждущих на futex-слове
+inline void futexWake(std::atomic<uint32_t>* word, int count = INT_MAX) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+// Номер запроса в кольце сервера: в старших битах - транспорт,
+// в младших - место запроса внутри транспорта
+// (клиент * PIPELINE_DEPTH + ящик слота или место запроса соединения)
+#define TRANSPORT_SHIFT 24
+#define TRANSPORT_LOCAL_MASK ((1u << TRANSPORT_SHIFT) - 1)
+#define TRANSPORT_SHM 0
+#define TRANSPORT_SOCKET 1
+#define TRANSPORT_BOT 2
+#define TRANSPORT_COUNT 3
+
+inline uint32_t makeRequestId(uint32_t transport, uint32_t localId) {
+    return (transport << TRANSPORT_SHIFT) | localId;
+}
+
+// Сессия клиента у сервера: канал (транспорт и номер слота или соединения, как в
+// номере запроса) и его поколение - pid владельца слота или счетчик соединения.
+// Сессия жива, пока канал занят тем же поколением (Transport::sessionAlive)
+typedef uint64_t SessionId;
+#define NO_SESSION 0
+
+inline SessionId makeSession(uint32_t transport, uint32_t channel, uint32_t generation) {
+    return ((uint64_t)generation << 32) | makeRequestId(transport, channel);
+}
+
+// Кольцо дескрипторов запросов: много клиентов пишут, один сервер читает.
+// Каждая ячейка несет номер последовательности, поэтому клиенты вставляют
+// запросы одним CAS по head без блокировок. Size - степень двойки
+template <uint32_t Size>
+struct RequestRingOf {
+    static_assert((Size & (Size - 1)) == 0, "Ring size must be a power of two");
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        uint32_t slot;                       // Номер запроса (см. makeRequestId)
+    };
+
+    alignas(64) std::atomic<uint32_t> head;  // Позиция записи (клиенты)
+    alignas(64) std::atomic<uint32_t> tail;  // Позиция чтения (только сервер)
+    alignas(64) std::atomic<uint32_t> doorbell;      // futex-слово для сна сервера
+    std::atomic<uint32_t> serverSleeping;            // Сервер собирается спать на doorbell
+    alignas(64) Cell cells[Size];
+
+    void init() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        doorbell.store(0, std::memory_order_relaxed);
+        serverSleeping.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < Size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+            cells[i].slot = 0;
+        }
+    }
+
+    // Клиент: кладем номер слота в кольцо и при необходимости будим сервер
+    bool push(uint32_t slotIdx) {
+        uint32_t pos = head.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & (Size - 1)];
+            uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+            int32_t diff = (int32_t)(seq - pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // кольцо заполнено
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->slot = slotIdx;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        // Сервер мог уйти в сон, не увидев нашу запись - будим
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (serverSleeping.load(std::memory_order_relaxed)) {
+            doorbell.fetch_add(1, std::memory_order_release);
+            futexWake(&doorbell);
+        }
+        return true;
+    }
+
+    // Сервер: забираем до maxCount запросов за раз
+    int popBatch(uint32_t* out, int maxCount) {
+        uint32_t pos = tail.load(std::memory_order_relaxed);
+        int count = 0;
+        while (count < maxCount) {
+            Cell* cell = &cells[pos & (Size - 1)];
+            uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+            if ((int32_t)(seq - (pos + 1)) < 0) {
+                break; // кольцо пусто
+            }
+            out[count++] = cell->slot;
+            cell->sequence.store(pos + Size, std::memory_order_release);
+            pos++;
+        }
+        tail.store(pos, std::memory_order_relaxed);
+        return count;
+    }
+
+    bool empty() const {
+        uint32_t pos = tail.load(std::memory_order_relaxed);
+        const Cell* cell = &cells[pos & (Size - 1)];
+        return (int32_t)(cell->sequence.load(std::memory_order_acquire) - (pos + 1)) < 0;
+    }
+
+    // Будим сервер без нового запроса. Только атомарные операции и futex -
+    // можно звать из обработчика сигнала
+    void interrupt() {
+        doorbell.fetch_add(1, std::memory_order_release);
+        futexWake(&doorbell);
+    }
+
+    // Сервер: засыпаем на futex, только если кольцо действительно пусто
+    // и не поднят флаг stop (его поднимают перед interrupt()).
+    // timeoutMs < 0 - ждем без ограничения
+    void waitForRequests(int timeoutMs = -1, const std::atomic<bool>* stop = nullptr) {
+        uint32_t bell = doorbell.load(std::memory_order_acquire);
+        serverSleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (empty() && (stop == nullptr || !stop->load(std::memory_order_acquire))) {
+            futexWait(&doorbell, bell, timeoutMs);
+        }
+        serverSleeping.store(0, std::memory_order_relaxed);
+    }
+};
+
+typedef RequestRingOf<REQUEST_RING_SIZE> RequestRing;
+
+#endif // IPC_H
@@ -0,0 +1,159 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Контрольная сумма записи журнала (FNV-1a)
+inline uint32_t journalChecksum(const void* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Журнал только на дозапись с групповой фиксацией.
+// appendRecord() копит записи в памяти, flush() одним write() отдает их ядру
+// (это уже переживает kill -9), а fdatasync делается только по запросу,
+// чтобы не платить синхронизацией с диском за каждую запись.
+// Писать и сбрасывать журнал можно из нескольких потоков: flush() забирает
+// буфер целиком, поэтому один сброс уносит на диск записи всех потоков.
+class Journal {
+public:
+    Journal() : fd(-1), lsn(0), records(0), unsyncedRecords(0), unsynced(0) {}
+
+    ~Journal() {
+        close();
+    }
+
+    bool open(const char* path) {
+        close();
+        fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+        return fd != -1;
+    }
+
+    void close() {
+        if (fd != -1) {
+            flush(true);
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool isOpen() const {
+        return fd != -1;
+    }
+
+    // Добавляем запись в буфер (на диск она попадет при flush).
+    // У записи должны быть поля lsn и checksum; checksum - последнее поле
+    template <class Record>
+    void appendRecord(Record& record) {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        record.lsn = ++lsn;
+        record.checksum = journalChecksum(&record, offsetof(Record, checksum));
+
+        const char* bytes = reinterpret_cast<const char*>(&record);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(Record));
+        records++;
+        unsyncedRecords++;
+    }
+
+    // Номер последней записи (его получает снимок, свернувший журнал)
+    uint64_t lastLsn() {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        return lsn;
+    }
+
+    // После восстановления продолжаем нумерацию с последней записи
+    void setLastLsn(uint64_t value) {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        lsn = value;
+    }
+
+    // Записей в журнале после последнего обнуления
+    size_t recordCount() {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        return records;
+    }
+
+    // Записей, еще не синхронизированных с диском
+    size_t unsyncedRecordCount() {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        return unsyncedRecords;
+    }
+
+    // Пишем накопленное; sync - дополнительно дожидаемся диска
+    bool flush(bool sync) {
+        std::lock_guard<std::mutex> flushLock(flushMutex);
+        if (fd == -1) {
+            return false;
+        }
+
+        size_t flushedRecords;
+        {
+            std::lock_guard<std::mutex> lock(bufferMutex);
+            writing.swap(buffer);
+            flushedRecords = unsyncedRecords;
+        }
+
+        size_t written = 0;
+        while (written < writing.size()) {
+            ssize_t n = ::write(fd, writing.data() + written, writing.size() - written);
+            if (n <= 0) {
+                // Недописанное возвращаем в начало буфера
+                std::lock_guard<std::mutex> lock(bufferMutex);
+                buffer.insert(buffer.begin(), writing.begin() + written, writing.end());
+                writing.clear();
+                unsynced += written;
+                return false;
+            }
+            written += (size_t)n;
+        }
+        unsynced += written;
+        writing.clear();
+
+        if (sync && unsynced > 0) {
+            if (fdatasync(fd) == -1) {
+                return false;
+            }
+            unsynced = 0;
+            std::lock_guard<std::mutex> lock(bufferMutex);
+            unsyncedRecords -= flushedRecords;
+        }
+        return true;
+    }
+
+    // Обнуляем журнал (после того как его содержимое попало в снимок)
+    bool truncate() {
+        std::lock_guard<std::mutex> flushLock(flushMutex);
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        if (fd == -1) {
+            return false;
+        }
+        buffer.clear();
+        records = 0;
+        unsyncedRecords = 0;
+        unsynced = 0;
+        return ftruncate(fd, 0) == 0 && fdatasync(fd) == 0;
+    }
+
+private:
+    int fd;
+    uint64_t lsn;                 // Номер последней записи
+    size_t records;               // Записей после последнего обнуления
+    size_t unsyncedRecords;       // Записей после последнего fdatasync
+    size_t unsynced;              // Байт, отданных ядру, но не синхронизированных
+    std::vector<char> buffer;     // Записи, еще не отданные ядру
+    std::vector<char> writing;    // Буфер, который сейчас пишет flush()
+    std::mutex bufferMutex;       // Защищает buffer и счетчики
+    std::mutex flushMutex;        // Один flush() за раз
+};
+
+#endif // JOURNAL_H
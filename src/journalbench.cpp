@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "common.h"
+#include "journal.h"
+#include "bench.h"
+
+// Цена сохранности итога одной партии (победа + поражение): журнал статистики
+// (journal.h) при разных режимах фиксации против прежней перезаписи всего
+// файла статистики на каждое изменение.
+//
+// ./journalbench [directory] [games]   (файлы создаются и удаляются в directory)
+
+// Запись журнала того же размера, что у сервера (StatsJournalRecord)
+struct BenchRecord {
+    uint64_t lsn;
+    uint32_t type;
+    int32_t playerIdx;
+    char username[64];
+    uint32_t checksum;
+};
+
+// Журнал: после каждой партии flush (write), fdatasync - раз в syncEvery записей (0 - никогда)
+double journalGame(const std::string& path, int games, int syncEvery) {
+    Journal journal;
+    if (!journal.open(path.c_str())) {
+        perror(path.c_str());
+        exit(1);
+    }
+    BenchRecord record;
+    memset(&record, 0, sizeof(record));
+
+    Stopwatch stopwatch;
+    for (int game = 0; game < games; game++) {
+        for (int side = 0; side < 2; side++) {
+            record.type = 2 + side;
+            record.playerIdx = game % 1000;
+            journal.appendRecord(record);
+        }
+        bool sync = syncEvery > 0 && journal.unsyncedRecordCount() >= (size_t)syncEvery;
+        journal.flush(sync);
+    }
+    journal.flush(false);
+    double us = stopwatch.microseconds() / games;
+    journal.close();
+    unlink(path.c_str());
+    return us;
+}
+
+// Прежний способ: после каждой партии весь файл статистики пишется заново
+double rewriteGame(const std::string& path, int games, int players, bool sync) {
+    std::vector<PlayerStats> table(players);
+    Stopwatch stopwatch;
+    for (int game = 0; game < games; game++) {
+        table[game % players].wins++;
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1 || write(fd, &players, sizeof(players)) != sizeof(players) ||
+            write(fd, table.data(), table.size() * sizeof(PlayerStats)) != (ssize_t)(table.size() * sizeof(PlayerStats))) {
+            perror(path.c_str());
+            exit(1);
+        }
+        if (sync) {
+            fdatasync(fd);
+        }
+        close(fd);
+    }
+    double us = stopwatch.microseconds() / games;
+    unlink(path.c_str());
+    return us;
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[directory] [games]");
+    std::string dir = args.text(1, ".");
+    int games = (int)args.integer(2, 2000, 1, 1000000);
+    std::string path = dir + "/journalbench." + std::to_string(getpid());
+
+    std::cout << "Microseconds per finished game (" << games << " games)" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "journal, write per game, no fdatasync:        " << journalGame(path, games, 0) << std::endl;
+    std::cout << "journal, fdatasync every " << std::setw(3) << JOURNAL_SYNC_RECORDS << " records (server): "
+              << journalGame(path, games, JOURNAL_SYNC_RECORDS) << std::endl;
+    std::cout << "journal, fdatasync every game:                " << journalGame(path, games, 1) << std::endl;
+
+    for (int players = 100; players <= 100000; players *= 10) {
+        // Перезапись больших таблиц очень медленная - меньше партий
+        int rewriteGames = std::max(10, games / (players / 100));
+        std::cout << "rewrite " << std::setw(6) << players << " players, no fdatasync:        "
+                  << rewriteGame(path, rewriteGames, players, false) << std::endl;
+        std::cout << "rewrite " << std::setw(6) << players << " players, fdatasync:           "
+                  << rewriteGame(path, rewriteGames, players, true) << std::endl;
+    }
+    return 0;
+}
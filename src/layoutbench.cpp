@@ -0,0 +1,124 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "common.h"
+#include "bench.h"
+
+// Байты на игру и цена обхода таблицы игр: нынешние куски таблицы (записи Game
+// с горячими полями в первой кэш-линии, за ними доски варианта битовыми плоскостями,
+// участники номерами) против записи до упаковки (клетки досок массивом enum, имена
+// игроков строками). Обе таблицы - классика 10x10.
+//
+// ./layoutbench [games] [passes]
+
+// Запись игры до упаковки досок (классика 10x10)
+namespace before {
+
+#define BEFORE_BOARD_SIZE 10
+#define BEFORE_TOTAL_SHIPS 10
+
+struct Ship {
+    int x, y;
+    int length;
+    bool horizontal;
+    int hits;
+};
+
+struct GameBoard {
+    CellState cells[BEFORE_BOARD_SIZE][BEFORE_BOARD_SIZE];
+    Ship ships[BEFORE_TOTAL_SHIPS];
+    int shipsPlaced;
+    unsigned __int128 shipMask;
+    unsigned __int128 shotMask;
+    unsigned __int128 hitMask;
+    unsigned __int128 shipCells[BEFORE_TOTAL_SHIPS];
+    int8_t shipAt[BEFORE_BOARD_SIZE * BEFORE_BOARD_SIZE];
+};
+
+struct Game {
+    char name[64];
+    char player1[64];
+    char player2[64];
+    GameBoard board1;
+    GameBoard board2;
+    GameState state;
+    int winner;
+    bool active;
+    std::atomic<uint32_t> version;
+    uint32_t generation;
+    uint32_t eventSeq;
+    MoveEvent events[GAME_EVENT_RING];
+};
+
+} // namespace before
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[games] [passes]");
+    int games = (int)args.integer(1, 20000, 1, 10000000);
+    int passes = (int)args.integer(2, 50, 1, 1000000);
+
+    // Одинаковое содержимое в обеих таблицах: каждая восьмая игра ждет соперника.
+    // Новая таблица - куски как в общей памяти сервера: GAME_CHUNK записей, за ними доски
+    before::Game* oldGames = new before::Game[games]();
+    int chunks = (games + GAME_CHUNK - 1) / GAME_CHUNK;
+    size_t chunkBytes = gameChunkBytes(RULES_CLASSIC);
+    char* table = static_cast<char*>(aligned_alloc(64, chunks * chunkBytes));
+    std::vector<Game*> newGames(games);
+    for (int i = 0; i < games; i++) {
+        newGames[i] = new (table + i / GAME_CHUNK * chunkBytes + i % GAME_CHUNK * sizeof(Game)) Game();
+    }
+    for (int i = 0; i < games; i++) {
+        GameState state = i % 8 == 0 ? WAITING_FOR_PLAYER : i % 8 == 1 ? GAME_OVER : PLAYER1_TURN;
+        oldGames[i].active = true;
+        oldGames[i].state = state;
+        snprintf(oldGames[i].name, sizeof(oldGames[i].name), "game%d", i);
+        snprintf(oldGames[i].player1, sizeof(oldGames[i].player1), "player%d", i % 1000);
+        newGames[i]->active = true;
+        newGames[i]->state = state;
+        snprintf(newGames[i]->name, sizeof(newGames[i]->name), "game%d", i);
+        newGames[i]->player1 = i % 1000;
+    }
+
+    // Обход как у LIST_GAMES и очистки: активные ожидающие игры чужих игроков и законченные
+    long found = 0;
+    Stopwatch stopwatch;
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < games; i++) {
+            const before::Game& game = oldGames[i];
+            found += game.active && game.state == WAITING_FOR_PLAYER && strcmp(game.player1, "player7") != 0;
+            found += game.active && game.state == GAME_OVER;
+        }
+    }
+    double oldNs = stopwatch.nanoseconds() / ((double)games * passes);
+
+    stopwatch.restart();
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < games; i++) {
+            const Game& game = *newGames[i];
+            found -= game.active && game.state == WAITING_FOR_PLAYER && game.player1 != 7;
+            found -= game.active && game.state == GAME_OVER;
+        }
+    }
+    double newNs = stopwatch.nanoseconds() / ((double)games * passes);
+
+    if (found != 0) {
+        std::cerr << "Scans disagree: " << found << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Bytes per game:        before " << sizeof(before::Game) << ", now quick "
+              << gameChunkBytes(RULES_QUICK) / GAME_CHUNK << ", classic " << chunkBytes / GAME_CHUNK << ", large "
+              << gameChunkBytes(RULES_LARGE) / GAME_CHUNK << " (record " << sizeof(Game) << " + boards; classic board "
+              << sizeof(before::GameBoard) << " -> " << sizeof(GameBoard<ClassicRules>) << ")" << std::endl;
+    std::cout << "Table of " << games << " games: before " << sizeof(before::Game) * games / 1024
+              << " KiB, now " << chunks * chunkBytes / 1024 << " KiB" << std::endl;
+    std::cout << "Scan ns per game:      before " << oldNs << ", now " << newNs << std::endl;
+
+    delete[] oldGames;
+    free(table);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include "common.h"
+#include "net.h"
+#include "wire.h"
+#include "bench.h"
+
+// Нагрузка на сокетный транспорт: открываем тысячи соединений к работающему
+// серверу, каждое входит под своим именем и шлет запросы статистики.
+// Запросы уходят сразу во все соединения, потом собираются ответы - сервер
+// держит все соединения одновременно.
+//
+// ./loadtest [address] [connections] [rounds]
+// Адрес как у клиента: unix:/path или tcp:host:port (по умолчанию unix:)
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[address] [connections] [rounds]");
+    std::string address = args.text(1, "unix:");
+    int connections = (int)args.integer(2, 10000, 1, 1000000);
+    int rounds = (int)args.integer(3, 10, 0, 1000000);
+
+    // Лишние соединения сервер закрывает - запись в них не должна убивать процесс
+    signal(SIGPIPE, SIG_IGN);
+
+    // Каждому соединению нужен дескриптор - поднимаем мягкий предел до жесткого
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    // Соединяемся, пока сервер или система не откажут
+    std::vector<int> fds;
+    fds.reserve(connections);
+    Stopwatch stopwatch;
+    int connectError = 0;
+    while ((int)fds.size() < connections) {
+        int fd = connectToServer(address);
+        if (fd == -1) {
+            connectError = errno;
+            break;
+        }
+        fds.push_back(fd);
+    }
+    double connectTime = stopwatch.seconds();
+    std::cout << "Connections opened: " << fds.size() << " of " << connections
+              << " in " << std::fixed << std::setprecision(2) << connectTime << " s";
+    if (connectError != 0) {
+        std::cout << " (stopped: " << strerror(connectError) << ")";
+    }
+    std::cout << std::endl;
+
+    // Имена уникальны для запуска: статистика игроков прошлых запусков остается на сервере
+    std::string prefix = "load" + std::to_string(getpid()) + "_";
+    std::vector<PlayerId> players(fds.size(), NO_PLAYER);
+    Message msg;
+
+    // Вход: сначала все запросы, потом все ответы
+    stopwatch.restart();
+    std::vector<bool> alive(fds.size(), true);
+    for (size_t i = 0; i < fds.size(); i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.type = Message::LOGIN;
+        msg.requestId = 1;
+        snprintf(msg.username, sizeof(msg.username), "%s%zu", prefix.c_str(), i);
+        alive[i] = sendMessage(fds[i], msg);
+    }
+    size_t loggedIn = 0;
+    for (size_t i = 0; i < fds.size(); i++) {
+        if (!alive[i] || !readMessage(fds[i], msg)) {
+            alive[i] = false;
+            continue;
+        }
+        if (msg.type == Message::LOGIN_RESPONSE && msg.playerId != NO_PLAYER) {
+            players[i] = msg.playerId;
+            loggedIn++;
+        }
+    }
+    std::cout << "Logged in: " << loggedIn << " in " << stopwatch.seconds() << " s" << std::endl;
+
+    // Раунды: по запросу статистики в каждое соединение
+    uint64_t requests = 0, answered = 0;
+    stopwatch.restart();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (!alive[i]) {
+                continue;
+            }
+            memset(&msg, 0, sizeof(msg));
+            msg.type = Message::GET_STATS;
+            msg.requestId = 2 + round;
+            msg.playerId = players[i];
+            snprintf(msg.username, sizeof(msg.username), "%s%zu", prefix.c_str(), i);
+            alive[i] = sendMessage(fds[i], msg);
+            requests++;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (!alive[i] || !readMessage(fds[i], msg)) {
+                alive[i] = false;
+                continue;
+            }
+            if (msg.type == Message::STATS_DATA && msg.requestId == (uint32_t)(2 + round)) {
+                answered++;
+            }
+        }
+    }
+    double requestTime = stopwatch.seconds();
+
+    size_t open = 0;
+    for (size_t i = 0; i < fds.size(); i++) {
+        open += alive[i];
+    }
+    std::cout << "Requests: " << answered << " of " << requests << " answered in " << requestTime << " s";
+    if (requestTime > 0) {
+        std::cout << " (" << std::setprecision(0) << answered / requestTime << " requests/s)";
+    }
+    std::cout << std::endl;
+    std::cout << "Connections still open: " << open << std::endl;
+
+    for (int fd : fds) {
+        close(fd);
+    }
+    return open == fds.size() && answered == requests ? 0 : 1;
+}
@@ -0,0 +1,434 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <string_view>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ipc.h"
+
+// Размер кольца записей журнала сервера (степень двойки)
+#define LOG_RING_SIZE 4096
+// Место под аргументы одной записи
+#define LOG_PAYLOAD_SIZE 200
+// Буфер, который поток журнала отдает в файл одним write()
+#define LOG_WRITE_BUFFER 65536
+
+enum LogLevel {
+    LOG_DEBUG = 0,
+    LOG_INFO = 1,
+    LOG_WARN = 2,
+    LOG_ERROR = 3
+};
+
+inline const char* logLevelName(int level) {
+    static const char* names[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+    return level >= LOG_DEBUG && level <= LOG_ERROR ? names[level] : "?    ";
+}
+
+// Уровень по имени (debug, info, warn, error); -1 - имя неизвестно
+inline int parseLogLevel(const char* name) {
+    static const char* names[] = {"debug", "info", "warn", "error"};
+    for (int i = LOG_DEBUG; i <= LOG_ERROR; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Асинхронный журнал сервера.
+// Поток запроса не форматирует текст: он кладет в кольцо запись фиксированного
+// размера - уровень, время, указатель на строку формата (литерал) и аргументы
+// в двоичном виде (числа как есть, строки копией). Кольцо устроено как
+// RequestRing: писателей много, вставка одним CAS без блокировок.
+// Фоновый поток разбирает записи по формату, копит текст и пишет его в файл
+// пачками. Если кольцо заполнено, запись теряется (поток запроса не ждет),
+// потерянные записи считаются и попадают в журнал.
+// Уровень можно менять на ходу (setLevel), записи ниже уровня не кладутся в кольцо.
+class AsyncLogger {
+public:
+    AsyncLogger() : fd(-1), running(false), outLength(0) {
+        head.store(0, std::memory_order_relaxed);
+        doorbell.store(0, std::memory_order_relaxed);
+        writerSleeping.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+        level.store(LOG_INFO, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < LOG_RING_SIZE; i++) {
+            records[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Открываем файл на дозапись и запускаем поток журнала; без файла пишем в stdout
+    bool start(const char* path) {
+        fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+        bool opened = fd != -1;
+        if (!opened) {
+            fd = STDOUT_FILENO;
+        }
+        running.store(true, std::memory_order_release);
+        writer = std::thread(&AsyncLogger::writerLoop, this);
+        return opened;
+    }
+
+    // Дописываем все, что осталось в кольце, и останавливаем поток
+    void stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+        ring();
+        writer.join();
+        if (fd != STDOUT_FILENO) {
+            ::close(fd);
+        }
+        fd = -1;
+    }
+
+    void setLevel(int newLevel) {
+        level.store(newLevel, std::memory_order_relaxed);
+    }
+
+    int getLevel() const {
+        return level.load(std::memory_order_relaxed);
+    }
+
+    bool enabled(int recordLevel) const {
+        return recordLevel >= level.load(std::memory_order_relaxed);
+    }
+
+    template <class... Args>
+    void debug(const char* format, const Args&... args) {
+        write(LOG_DEBUG, format, args...);
+    }
+
+    template <class... Args>
+    void info(const char* format, const Args&... args) {
+        write(LOG_INFO, format, args...);
+    }
+
+    template <class... Args>
+    void warn(const char* format, const Args&... args) {
+        write(LOG_WARN, format, args...);
+    }
+
+    template <class... Args>
+    void error(const char* format, const Args&... args) {
+        write(LOG_ERROR, format, args...);
+    }
+
+    // Запись в журнал. format - строковый литерал в стиле printf без модификаторов
+    // длины (%d, %u, %x, %c, %f, %s); аргументы - целые, числа с плавающей точкой,
+    // const char* или std::string_view
+    template <class... Args>
+    void write(int recordLevel, const char* format, const Args&... args) {
+        if (!enabled(recordLevel)) {
+            return;
+        }
+        uint32_t pos;
+        Record* record = claim(pos);
+        if (record == nullptr) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        record->level = (uint8_t)recordLevel;
+        record->format = format;
+        clock_gettime(CLOCK_REALTIME, &record->time);
+        record->payloadSize = 0;
+        (encodeArg(*record, args), ...);
+        publish(record, pos);
+    }
+
+private:
+    // Теги аргументов в записи
+    enum ArgTag : uint8_t {
+        ARG_INT = 1,     // int64_t
+        ARG_UINT = 2,    // uint64_t
+        ARG_DOUBLE = 3,  // double
+        ARG_STRING = 4   // uint8_t длина и байты строки
+    };
+
+    struct Record {
+        std::atomic<uint32_t> sequence;
+        uint8_t level;
+        uint16_t payloadSize;
+        struct timespec time;
+        const char* format;
+        uint8_t payload[LOG_PAYLOAD_SIZE];
+    };
+
+    // Писатель: место в кольце, nullptr - кольцо заполнено
+    Record* claim(uint32_t& pos) {
+        pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Record* record = &records[pos & (LOG_RING_SIZE - 1)];
+            uint32_t seq = record->sequence.load(std::memory_order_acquire);
+            int32_t diff = (int32_t)(seq - pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return record;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void publish(Record* record, uint32_t pos) {
+        record->sequence.store(pos + 1, std::memory_order_release);
+        // Поток журнала мог уйти в сон, не увидев запись - будим
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writerSleeping.load(std::memory_order_relaxed)) {
+            ring();
+        }
+    }
+
+    void ring() {
+        doorbell.fetch_add(1, std::memory_order_release);
+        futexWake(&doorbell);
+    }
+
+    static void putBytes(Record& record, const void* data, size_t size) {
+        memcpy(record.payload + record.payloadSize, data, size);
+        record.payloadSize += (uint16_t)size;
+    }
+
+    template <class T>
+    static void encodeArg(Record& record, const T& value) {
+        if constexpr (std::is_same<T, bool>::value || std::is_integral<T>::value || std::is_enum<T>::value) {
+            if (record.payloadSize + 1 + 8 > LOG_PAYLOAD_SIZE) {
+                return;
+            }
+            if constexpr (std::is_unsigned<T>::value) {
+                uint64_t v = (uint64_t)value;
+                record.payload[record.payloadSize++] = ARG_UINT;
+                putBytes(record, &v, sizeof(v));
+            } else {
+                int64_t v = (int64_t)value;
+                record.payload[record.payloadSize++] = ARG_INT;
+                putBytes(record, &v, sizeof(v));
+            }
+        } else if constexpr (std::is_floating_point<T>::value) {
+            if (record.payloadSize + 1 + 8 > LOG_PAYLOAD_SIZE) {
+                return;
+            }
+            double v = (double)value;
+            record.payload[record.payloadSize++] = ARG_DOUBLE;
+            putBytes(record, &v, sizeof(v));
+        } else {
+            encodeString(record, std::string_view(value));
+        }
+    }
+
+    static void encodeString(Record& record, std::string_view text) {
+        if (record.payloadSize + 2 > LOG_PAYLOAD_SIZE) {
+            return;
+        }
+        size_t length = std::min(text.size(), std::min((size_t)255, (size_t)(LOG_PAYLOAD_SIZE - record.payloadSize - 2)));
+        record.payload[record.payloadSize++] = ARG_STRING;
+        record.payload[record.payloadSize++] = (uint8_t)length;
+        putBytes(record, text.data(), length);
+    }
+
+    template <size_t N>
+    static void encodeArg(Record& record, const char (&text)[N]) {
+        encodeString(record, std::string_view(text, strnlen(text, N)));
+    }
+
+    static void encodeArg(Record& record, const char* text) {
+        encodeString(record, text != nullptr ? std::string_view(text) : std::string_view("(null)"));
+    }
+
+    // Поток журнала
+
+    void writerLoop() {
+        uint32_t pos = 0;
+        while (true) {
+            bool stopping = !running.load(std::memory_order_acquire);
+            int count = 0;
+            while (true) {
+                Record* record = &records[pos & (LOG_RING_SIZE - 1)];
+                if ((int32_t)(record->sequence.load(std::memory_order_acquire) - (pos + 1)) < 0) {
+                    break; // кольцо пусто
+                }
+                formatRecord(*record);
+                record->sequence.store(pos + LOG_RING_SIZE, std::memory_order_release);
+                pos++;
+                count++;
+            }
+
+            uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+            if (lost > 0) {
+                appendText("Log ring overflow: ");
+                appendFormat("%llu records dropped\n", (unsigned long long)lost);
+            }
+
+            if (count > 0) {
+                continue; // пока записи идут, копим их в буфере
+            }
+            flushText();
+            if (stopping) {
+                return;
+            }
+
+            // Засыпаем, только если кольцо действительно пусто
+            uint32_t bell = doorbell.load(std::memory_order_acquire);
+            writerSleeping.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const Record* next = &records[pos & (LOG_RING_SIZE - 1)];
+            if ((int32_t)(next->sequence.load(std::memory_order_acquire) - (pos + 1)) < 0 &&
+                running.load(std::memory_order_acquire)) {
+                futexWait(&doorbell, bell);
+            }
+            writerSleeping.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void flushText() {
+        size_t done = 0;
+        while (done < outLength) {
+            ssize_t n = ::write(fd, out + done, outLength - done);
+            if (n <= 0) {
+                break; // журнал не должен ронять сервер
+            }
+            done += (size_t)n;
+        }
+        outLength = 0;
+    }
+
+    void reserveText(size_t size) {
+        if (outLength + size > sizeof(out)) {
+            flushText();
+        }
+    }
+
+    void appendText(std::string_view text) {
+        reserveText(text.size());
+        size_t n = std::min(text.size(), sizeof(out) - outLength);
+        memcpy(out + outLength, text.data(), n);
+        outLength += n;
+    }
+
+    template <class... Args>
+    void appendFormat(const char* format, Args... args) {
+        reserveText(512);
+        int n = snprintf(out + outLength, sizeof(out) - outLength, format, args...);
+        if (n > 0) {
+            outLength += std::min((size_t)n, sizeof(out) - outLength - 1);
+        }
+    }
+
+    // Строка журнала: время, уровень и текст по формату записи
+    void formatRecord(const Record& record) {
+        struct tm local;
+        localtime_r(&record.time.tv_sec, &local);
+        appendFormat("%04d-%02d-%02d %02d:%02d:%02d.%06ld %s ",
+                     local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+                     local.tm_hour, local.tm_min, local.tm_sec,
+                     record.time.tv_nsec / 1000, logLevelName(record.level));
+
+        const char* p = record.format;
+        size_t offset = 0;
+        while (*p) {
+            const char* percent = strchr(p, '%');
+            if (percent == nullptr) {
+                appendText(p);
+                break;
+            }
+            appendText(std::string_view(p, percent - p));
+            if (percent[1] == '%') {
+                appendText("%");
+                p = percent + 2;
+                continue;
+            }
+
+            // Спецификатор: флаги, ширина и точность оставляем, тип берем из записи
+            const char* conv = percent + 1;
+            while (*conv && strchr("-+ #0123456789.", *conv)) {
+                conv++;
+            }
+            if (*conv == '\0') {
+                appendText(percent);
+                break;
+            }
+            char spec[32];
+            size_t specLength = std::min((size_t)(conv - percent), sizeof(spec) - 4);
+            memcpy(spec, percent, specLength);
+            formatArg(record, offset, spec, specLength, *conv);
+            p = conv + 1;
+        }
+        appendText("\n");
+    }
+
+    void formatArg(const Record& record, size_t& offset, char* spec, size_t specLength, char conv) {
+        if (offset >= record.payloadSize) {
+            appendText("?");
+            return;
+        }
+        uint8_t tag = record.payload[offset++];
+        if (tag == ARG_STRING) {
+            size_t length = record.payload[offset++];
+            char text[256];
+            memcpy(text, record.payload + offset, length);
+            text[length] = '\0';
+            offset += length;
+            spec[specLength] = 's';
+            spec[specLength + 1] = '\0';
+            appendFormat(spec, text);
+            return;
+        }
+
+        uint64_t bits;
+        memcpy(&bits, record.payload + offset, sizeof(bits));
+        offset += sizeof(bits);
+        int64_t asInt;
+        double asDouble;
+        if (tag == ARG_DOUBLE) {
+            memcpy(&asDouble, &bits, sizeof(asDouble));
+            asInt = (int64_t)asDouble;
+        } else {
+            asInt = (int64_t)bits;
+            asDouble = tag == ARG_UINT ? (double)bits : (double)asInt;
+        }
+
+        if (strchr("feEgG", conv)) {
+            spec[specLength] = conv;
+            spec[specLength + 1] = '\0';
+            appendFormat(spec, asDouble);
+        } else if (conv == 'c') {
+            spec[specLength] = 'c';
+            spec[specLength + 1] = '\0';
+            appendFormat(spec, (int)asInt);
+        } else {
+            // Целые (d, i, u, x, X) печатаем как long long
+            spec[specLength] = 'l';
+            spec[specLength + 1] = 'l';
+            spec[specLength + 2] = strchr("diuxX", conv) ? conv : 'd';
+            spec[specLength + 3] = '\0';
+            appendFormat(spec, (long long)asInt);
+        }
+    }
+
+    alignas(64) std::atomic<uint32_t> head;           // Позиция записи (потоки запросов)
+    alignas(64) std::atomic<uint32_t> doorbell;       // futex-слово для сна потока журнала
+    std::atomic<uint32_t> writerSleeping;
+    std::atomic<uint64_t> dropped;                    // Записи, не влезшие в кольцо
+    std::atomic<int> level;                           // Минимальный уровень записей
+    alignas(64) Record records[LOG_RING_SIZE];
+
+    int fd;
+    std::thread writer;
+    std::atomic<bool> running;
+    size_t outLength;
+    char out[LOG_WRITE_BUFFER];                       // Текст, еще не отданный в файл
+};
+
+#endif // LOG_H
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "log.h"
+#include "bench.h"
+
+// Цена строки журнала для потока запроса: прежний std::cout << ... << std::endl
+// (в файл) против AsyncLogger (log.h), который только кладет запись в кольцо.
+// Строки идут пачками по LOG_BENCH_BURST с паузой между ними, как запросы
+// шарда; мерится только время вызовов. Поток журнала делит ядра с потоком
+// запросов, поэтому считаем и записи, дошедшие до файла.
+//
+// ./logbench [directory] [lines]   (файлы создаются и удаляются в directory)
+
+#define LOG_BENCH_BURST 1000
+#define LOG_BENCH_PAUSE_US 2000
+
+// Время lines вызовов writeLine(i) пачками, нс на вызов
+template <class WriteLine>
+double timeBursts(int lines, WriteLine writeLine) {
+    double ns = 0;
+    for (int first = 0; first < lines; first += LOG_BENCH_BURST) {
+        int last = std::min(lines, first + LOG_BENCH_BURST);
+        Stopwatch stopwatch;
+        for (int i = first; i < last; i++) {
+            writeLine(i);
+        }
+        ns += stopwatch.nanoseconds();
+        usleep(LOG_BENCH_PAUSE_US);
+    }
+    return ns / lines;
+}
+
+// Строк в файле и из них строк о потерянных записях (их число - в начале строки)
+void countLines(const std::string& path, long& lines, long& droppedRecords) {
+    std::ifstream file(path);
+    std::string line;
+    lines = 0;
+    droppedRecords = 0;
+    while (std::getline(file, line)) {
+        size_t pos = line.find(" records dropped");
+        if (pos == std::string::npos) {
+            lines++;
+            continue;
+        }
+        // "Log ring overflow: N records dropped"
+        size_t start = line.rfind(' ', pos - 1);
+        droppedRecords += atol(line.c_str() + (start == std::string::npos ? 0 : start + 1));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[directory] [lines]");
+    std::string dir = args.text(1, ".");
+    int lines = (int)args.integer(2, 100000, 1, 100000000);
+    std::string path = dir + "/logbench." + std::to_string(getpid());
+    std::string_view username = "player_with_long_name_42";
+
+    // Прежний путь: поток запроса сам пишет строку и сбрасывает буфер
+    std::ofstream file(path);
+    std::streambuf* console = std::cout.rdbuf(file.rdbuf());
+    double coutNs = timeBursts(lines, [&](int i) {
+        std::cout << "Make move request: game" << i % 100 << " from " << username
+                  << " at (" << i % 10 << ", " << i % 7 << ")" << std::endl;
+    });
+    std::cout.rdbuf(console);
+    file.close();
+    unlink(path.c_str());
+
+    // Асинхронный журнал: мерим вызовы в потоке запроса, затем ждем дозаписи
+    AsyncLogger* log = new AsyncLogger();
+    log->start(path.c_str());
+    double asyncNs = timeBursts(lines, [&](int i) {
+        log->info("Make move request: game%d from %s at (%d, %d)", i % 100, username, i % 10, i % 7);
+    });
+
+    // Запись ниже уровня журнала: только проверка уровня
+    double filteredNs = timeBursts(lines, [&](int i) {
+        log->debug("Make move request: game%d from %s at (%d, %d)", i % 100, username, i % 10, i % 7);
+    });
+    log->stop();
+    delete log;
+
+    long written, droppedRecords;
+    countLines(path, written, droppedRecords);
+    unlink(path.c_str());
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "std::cout << std::endl:   " << coutNs << " ns per line" << std::endl;
+    std::cout << "AsyncLogger, info:        " << asyncNs << " ns per line (" << written << " written, "
+              << droppedRecords << " dropped of " << lines << ")" << std::endl;
+    std::cout << "AsyncLogger, below level: " << filteredNs << " ns per line" << std::endl;
+    return 0;
+}
@@ -0,0 +1,142 @@
+#ifndef NET_H
+#define NET_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// Адреса сокетного транспорта по умолчанию
+#define SERVER_SOCKET_PATH "/tmp/sea_battle.sock"
+#define SERVER_TCP_PORT 5555
+#define SERVER_TCP_HOST "127.0.0.1"   // Сервер слушает TCP только на этой машине (SEA_BATTLE_TCP_ADDRESS - другой адрес)
+
+// Разбор "host:port": порт можно опустить (SERVER_TCP_PORT), пустой хост - SERVER_TCP_HOST
+inline void splitHostPort(const std::string& address, std::string& host, std::string& port) {
+    host = address;
+    port = std::to_string(SERVER_TCP_PORT);
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos) {
+        port = host.substr(colon + 1);
+        host = host.substr(0, colon);
+    }
+    if (host.empty()) {
+        host = SERVER_TCP_HOST;
+    }
+}
+
+// Пишем буфер целиком (блокирующий сокет)
+inline bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// Читаем ровно size байт (блокирующий сокет); false - ошибка или соединение закрыто
+inline bool readAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+inline bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+// Подключение к серверу по адресу "unix:/path" или "tcp:host:port" (порт можно опустить).
+// Возвращает дескриптор или -1
+inline int connectToServer(const std::string& address) {
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        if (path.empty()) {
+            path = SERVER_SOCKET_PATH;
+        }
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        strcpy(addr.sun_path, path.c_str());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1) {
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    if (address.compare(0, 4, "tcp:") == 0) {
+        std::string host, port;
+        splitHostPort(address.substr(4), host, port);
+
+        struct addrinfo hints;
+        struct addrinfo* result = nullptr;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+            errno = EHOSTUNREACH;
+            return -1;
+        }
+
+        int fd = -1;
+        for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd == -1) {
+                continue;
+            }
+            if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                break;
+            }
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(result);
+
+        if (fd != -1) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return fd;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+#endif // NET_H
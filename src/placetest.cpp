@@ -0,0 +1,283 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "common.h"
+#include "board.h"
+#include "engine.h"
+#include "bench.h"
+
+// Смещение autoPlaceFleet: ее флоты сравниваются с эталоном, в котором все
+// допустимые флоты равновероятны. autoPlaceFleet лишь приближенно равномерна
+// (см. engine.h), поэтому проверка не ищет отличие, а меряет его: наибольшее
+// относительное смещение доли занятости клетки и среднеквадратичное
+// относительное смещение долей положений линкора (взвешенное долями). У обоих -
+// верхняя граница с учетом шума выборок на уровне 0.001 (у клеток с поправкой на
+// их число); она должна быть не больше PLACE_TEST_MAX_BIAS. Для сравнения
+// печатаются и меньшие числа проходов (на четверти выборки): их смещение больше.
+// Код возврата 1 - граница выше допуска при AUTO_PLACE_SWEEPS проходах или
+// отличие эталона от отбора.
+//
+// Эталон - последовательная расстановка с весами: корабли от больших к меньшим
+// ставятся каждый равновероятно в любое положение, свободное при уже
+// поставленных, а флот получает вес - произведение чисел таких положений.
+// Взвешенные доли оценивают доли равномерной выборки без смещения (выборка по
+// значимости); веса разбросаны мало, эффективный размер - около половины числа
+// флотов. Отбор целых флотов точен, но на большом поле годен один флот из
+// 790000, поэтому он только сверяет эталон на малом поле.
+//
+// ./placetest [fleets] [seed]   (флотов autoPlaceFleet на вариант)
+
+#define PLACE_TEST_MAX_BIAS 0.03        // Допуск относительного смещения долей клеток и положений линкора
+#define PLACE_TEST_REFERENCE_FACTOR 4   // Флотов эталона на флот autoPlaceFleet
+#define PLACE_TEST_REJECTION_FLEETS 100000  // Флотов отбора для сверки эталона
+
+// Частоты по выборке флотов с весами (у autoPlaceFleet и отбора веса единичные):
+// суммы весов и их квадратов - по всем флотам, по клеткам и по положениям линкора
+template <class Rules>
+struct FleetCounts {
+    double weight, weight2;
+    std::vector<double> cells, cells2;
+    std::vector<double> battleships, battleships2;   // Горизонтальные по клетке начала, затем вертикальные
+
+    FleetCounts() : weight(0), weight2(0), cells(Rules::CELLS), cells2(Rules::CELLS),
+                    battleships(2 * Rules::CELLS), battleships2(2 * Rules::CELLS) {}
+
+    void add(const ShipPlacement fleet[Rules::TOTAL_SHIPS], double w = 1) {
+        weight += w;
+        weight2 += w * w;
+        for (int i = 0; i < Rules::TOTAL_SHIPS; i++) {
+            const ShipPlacement& ship = fleet[i];
+            for (int k = 0; k < ship.length; k++) {
+                int x = ship.horizontal ? ship.x + k : ship.x;
+                int y = ship.horizontal ? ship.y : ship.y + k;
+                cells[y * Rules::SIZE + x] += w;
+                cells2[y * Rules::SIZE + x] += w * w;
+            }
+            if (ship.length == BATTLESHIP) {
+                int position = (ship.horizontal ? 0 : Rules::CELLS) + ship.y * Rules::SIZE + ship.x;
+                battleships[position] += w;
+                battleships2[position] += w * w;
+            }
+        }
+    }
+
+    // Эффективный размер выборки (Киш)
+    double size() const {
+        return weight * weight / weight2;
+    }
+
+    // Доля флотов с признаком (sum, sum2 - суммы весов и квадратов весов таких флотов)
+    // и дисперсия ее оценки: у единичных весов это p(1 - p)/n
+    double share(double sum) const {
+        return sum / weight;
+    }
+
+    double variance(double sum, double sum2) const {
+        double p = share(sum);
+        return ((1 - p) * (1 - p) * sum2 + p * p * (weight2 - sum2)) / (weight * weight);
+    }
+};
+
+// Флот отбором: true - корабли не задевают друг друга
+template <class Rules>
+bool rejectionFleet(ShipPlacement fleet[Rules::TOTAL_SHIPS], GameRandom& random) {
+    typedef typename Rules::Mask Mask;
+    const PlacementTable<Rules>& table = g_placementTable<Rules>;
+    const int* lengths = g_fleetLengths<Rules>.lengths;
+    Mask forbidden = 0;
+
+    // Большие корабли первыми: так отказ обычно виден раньше
+    for (int i = Rules::TOTAL_SHIPS - 1; i >= 0; i--) {
+        int length = lengths[i];
+        int orientations = length == SUBMARINE ? 1 : 2;
+        int chosen;
+        const ShipPosition<Mask>* position;
+        do {
+            chosen = random.below(orientations * Rules::CELLS);
+            position = &table.positions[length][chosen / Rules::CELLS][chosen % Rules::CELLS];
+        } while (position->footprint == 0);   // Корабль не помещается на поле
+        if (position->footprint & forbidden) {
+            return false;
+        }
+        forbidden |= position->halo;
+
+        int cell = chosen % Rules::CELLS;
+        fleet[i].x = cell % Rules::SIZE;
+        fleet[i].y = cell / Rules::SIZE;
+        fleet[i].length = length;
+        fleet[i].horizontal = chosen < Rules::CELLS;
+    }
+    return true;
+}
+
+// Флот эталона и логарифм его веса; -INFINITY - очередному кораблю места нет (вес 0)
+template <class Rules>
+double weightedFleet(ShipPlacement fleet[Rules::TOTAL_SHIPS], GameRandom& random) {
+    typedef typename Rules::Mask Mask;
+    const int* lengths = g_fleetLengths<Rules>.lengths;
+    Mask forbidden = 0;
+    double logWeight = 0;
+
+    for (int i = Rules::TOTAL_SHIPS - 1; i >= 0; i--) {
+        int length = lengths[i];
+        Mask horizontal = freeStarts<Rules>(length, 0, forbidden);
+        Mask vertical = length == SUBMARINE ? Mask(0) : freeStarts<Rules>(length, 1, forbidden);
+        int horizontalCount = maskPopcount(horizontal);
+        int count = horizontalCount + maskPopcount(vertical);
+        if (count == 0) {
+            return -INFINITY;
+        }
+        logWeight += std::log((double)count);
+
+        int chosen = random.below(count);
+        int cell = chosen < horizontalCount ? maskSelect(horizontal, chosen)
+                                            : maskSelect(vertical, chosen - horizontalCount);
+        fleet[i].x = cell % Rules::SIZE;
+        fleet[i].y = cell / Rules::SIZE;
+        fleet[i].length = length;
+        fleet[i].horizontal = chosen < horizontalCount;
+        forbidden |= shipPosition<Rules>(fleet[i]).halo;
+    }
+    return logWeight;
+}
+
+// Порог |z| нормального распределения для двусторонней вероятности p (делением пополам)
+double normalLimit(double p) {
+    double low = 0, high = 40;
+    for (int i = 0; i < 100; i++) {
+        double middle = (low + high) / 2;
+        (std::erfc(middle / std::sqrt(2.0)) > p ? low : high) = middle;
+    }
+    return low;
+}
+
+// Порог хи-квадрат с df степенями свободы для нормального квантиля z (Уилсон - Хилферти)
+double chiSquareLimit(int df, double z) {
+    double k = 2.0 / (9.0 * df);
+    return df * std::pow(1 - k + z * std::sqrt(k), 3);
+}
+
+// Сравнение выборки с эталоном
+struct Comparison {
+    double maxZ, zLimit;      // Наибольшее |z| разности долей клеток
+    double bias, bound;       // Наибольшее смещение доли клетки и его верхняя граница (относительные)
+    double chiSquare, chiLimit;
+    double spread, spreadBound;   // Среднеквадратичное смещение долей положений линкора и его граница
+};
+
+template <class Rules>
+Comparison compareCounts(const FleetCounts<Rules>& reference, const FleetCounts<Rules>& sample) {
+    Comparison result = {0, normalLimit(0.001 / Rules::CELLS), 0, 0, 0, 0, 0, 0};
+    for (int cell = 0; cell < Rules::CELLS; cell++) {
+        double p1 = reference.share(reference.cells[cell]), p2 = sample.share(sample.cells[cell]);
+        double error = std::sqrt(reference.variance(reference.cells[cell], reference.cells2[cell]) +
+                                 sample.variance(sample.cells[cell], sample.cells2[cell]));
+        result.maxZ = std::max(result.maxZ, std::fabs(p2 - p1) / error);
+        result.bias = std::max(result.bias, std::fabs(p2 / p1 - 1));
+        result.bound = std::max(result.bound, (std::fabs(p2 - p1) + result.zLimit * error) / p1);
+    }
+
+    // Линкор: хи-квадрат разностей долей положений и оценка суммы d^2/p по
+    // положениям (d - смещение доли p) без вклада шума, с ее погрешностью
+    int df = -1;
+    double divergence = 0, noise = 0;
+    for (size_t i = 0; i < reference.battleships.size(); i++) {
+        double variance = reference.variance(reference.battleships[i], reference.battleships2[i]) +
+                          sample.variance(sample.battleships[i], sample.battleships2[i]);
+        if (variance > 0) {
+            double p = reference.share(reference.battleships[i]);
+            double difference = sample.share(sample.battleships[i]) - p;
+            result.chiSquare += difference * difference / variance;
+            divergence += (difference * difference - variance) / p;
+            noise += 2 * (variance / p) * (variance / p);
+            df++;
+        }
+    }
+    double z = normalLimit(0.002);   // Уровень 0.001
+    result.chiLimit = chiSquareLimit(df, z);
+    result.spread = std::sqrt(std::max(divergence, 0.0));
+    result.spreadBound = std::sqrt(std::max(divergence + z * std::sqrt(noise), 0.0));
+    return result;
+}
+
+void printComparison(const Comparison& result) {
+    std::cout << std::fixed << std::setprecision(2) << "cells " << 100 * result.bias << "% (bound "
+              << 100 * result.bound << "%, max |z| " << result.maxZ << "), battleship " << 100 * result.spread
+              << "% (bound " << 100 * result.spreadBound << "%, chi2 " << std::setprecision(0)
+              << result.chiSquare << "/" << result.chiLimit << ")";
+}
+
+template <class Rules>
+bool checkVariant(const char* name, long fleets, bool checkReference, GameRandom& random) {
+    ShipPlacement fleet[Rules::TOTAL_SHIPS];
+
+    // Веса - относительно веса первого флота: разброс логарифмов мал, переполнения нет
+    FleetCounts<Rules> reference;
+    double shift = NAN;
+    Stopwatch stopwatch;
+    for (long i = 0; i < fleets * PLACE_TEST_REFERENCE_FACTOR; i++) {
+        double logWeight = weightedFleet<Rules>(fleet, random);
+        if (logWeight == -INFINITY) {
+            continue;
+        }
+        if (std::isnan(shift)) {
+            shift = logWeight;
+        }
+        reference.add(fleet, std::exp(logWeight - shift));
+    }
+    double referenceRate = fleets * PLACE_TEST_REFERENCE_FACTOR / stopwatch.seconds();
+
+    std::cout << name << ": reference " << std::fixed << std::setprecision(0) << referenceRate
+              << " fleets/s, effective size " << reference.size() << " of "
+              << fleets * PLACE_TEST_REFERENCE_FACTOR << std::endl;
+
+    bool passed = true;
+    if (checkReference) {
+        FleetCounts<Rules> rejection;
+        while (rejection.weight < PLACE_TEST_REJECTION_FLEETS) {
+            if (rejectionFleet<Rules>(fleet, random)) {
+                rejection.add(fleet);
+            }
+        }
+        Comparison result = compareCounts(reference, rejection);
+        passed = result.maxZ <= result.zLimit && result.chiSquare <= result.chiLimit;
+        std::cout << "  rejection: cells max |z| " << std::setprecision(2) << result.maxZ << " (limit "
+                  << result.zLimit << "), battleship chi2 " << std::setprecision(0) << result.chiSquare
+                  << " (limit " << result.chiLimit << ")" << (passed ? "" : " DIFFERENT") << std::endl;
+    }
+
+    for (int sweeps = 0; sweeps <= AUTO_PLACE_SWEEPS; sweeps++) {
+        long count = sweeps == AUTO_PLACE_SWEEPS ? fleets : fleets / 4;
+        FleetCounts<Rules> sample;
+        stopwatch.restart();
+        for (long i = 0; i < count; i++) {
+            autoPlaceFleet<Rules>(fleet, random, sweeps);
+            sample.add(fleet);
+        }
+        double rate = count / stopwatch.seconds();
+        Comparison result = compareCounts(reference, sample);
+        std::cout << "  " << sweeps << " sweeps: " << std::setprecision(0) << rate << " fleets/s, ";
+        printComparison(result);
+        if (sweeps == AUTO_PLACE_SWEEPS) {
+            bool within = result.bound <= PLACE_TEST_MAX_BIAS && result.spreadBound <= PLACE_TEST_MAX_BIAS;
+            std::cout << (within ? "" : " TOO BIASED");
+            passed = within && passed;
+        }
+        std::cout << std::endl;
+    }
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[fleets] [seed]");
+    long fleets = args.integer(1, 1000000, 1000);
+    uint64_t seed = args.seed(2, 1);
+
+    GameRandom random(seed);
+    bool passed = checkVariant<QuickRules>("quick", fleets, true, random);
+    passed = checkVariant<ClassicRules>("classic", fleets, false, random) && passed;
+    passed = checkVariant<LargeRules>("large", fleets, false, random) && passed;
+    return passed ? 0 : 1;
+}
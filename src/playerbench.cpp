@@ -0,0 +1,77 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include "common.h"
+#include "players.h"
+#include "bench.h"
+
+// Задержка поиска игрока по имени в зависимости от числа игроков:
+// таблица игроков сервера (players.h) против прежнего перебора массива со strcmp.
+// Имена ищутся в случайном порядке, все они есть в таблице.
+//
+// ./playerbench [max players]   (по умолчанию до 1000000)
+
+#define LOOKUPS 1000000
+#define SCAN_LOOKUPS 2000   // Перебор медленный - ищем меньше раз
+
+void playerName(char* out, size_t size, int idx) {
+    snprintf(out, size, "player%d", idx);
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[max players]");
+    long maxPlayers = args.integer(1, 1000000, 100);
+
+    std::cout << std::setw(10) << "players" << std::setw(14) << "table ns" << std::setw(14) << "scan ns" << std::endl;
+    std::mt19937 random(1);
+    for (long players = 100; players <= maxPlayers; players *= 10) {
+        PlayerTable* table = new PlayerTable();
+        std::vector<PlayerStats> array(players);
+        char name[64];
+        for (long i = 0; i < players; i++) {
+            playerName(name, sizeof(name), (int)i);
+            bool added;
+            table->findOrAdd(name, added);
+            strcpy(array[i].username, name);
+        }
+
+        // Имена для поиска готовим заранее, чтобы мерить только поиск
+        std::vector<std::string> names(LOOKUPS);
+        for (std::string& lookup : names) {
+            playerName(name, sizeof(name), (int)(random() % players));
+            lookup = name;
+        }
+
+        Stopwatch stopwatch;
+        long found = 0;
+        for (const std::string& lookup : names) {
+            found += table->find(lookup.c_str()) != -1;
+        }
+        double tableNs = stopwatch.nanoseconds() / LOOKUPS;
+
+        stopwatch.restart();
+        for (int i = 0; i < SCAN_LOOKUPS; i++) {
+            const char* lookup = names[i].c_str();
+            for (long j = 0; j < players; j++) {
+                if (strcmp(array[j].username, lookup) == 0) {
+                    found++;
+                    break;
+                }
+            }
+        }
+        double scanNs = stopwatch.nanoseconds() / SCAN_LOOKUPS;
+
+        if (found != LOOKUPS + SCAN_LOOKUPS) {
+            std::cerr << "Lookup failed: found " << found << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(10) << players << std::fixed << std::setprecision(1)
+                  << std::setw(14) << tableNs << std::setw(14) << scanNs << std::endl;
+        delete table;
+    }
+    return 0;
+}
@@ -0,0 +1,255 @@
+#ifndef PLAYERS_H
+#define PLAYERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "common.h"
+
+// Хеш-индекс по имени: открытая адресация с линейным пробированием.
+// Хеш имени хранится в записи, поэтому strcmp вызывается только при совпадении хешей,
+// а рост и удаление обходятся без самих имен.
+struct NameIndex {
+    struct Entry {
+        uint32_t hash;
+        int32_t idx;    // Номер записи (игрока, игры), -1 - пустая ячейка
+    };
+
+    std::vector<Entry> entries;
+    size_t count = 0;
+
+    // Очищаем индекс; емкость - степень двойки
+    void reset(size_t capacity) {
+        entries.assign(capacity, Entry{0, -1});
+        count = 0;
+    }
+
+    // Поиск по имени; nameOf(idx) возвращает имя записи idx
+    template <class NameOf>
+    int find(const char* name, uint32_t hash, NameOf nameOf) const {
+        if (entries.empty()) {
+            return -1;
+        }
+        size_t mask = entries.size() - 1;
+        for (size_t pos = hash & mask; entries[pos].idx != -1; pos = (pos + 1) & mask) {
+            if (entries[pos].hash == hash && strcmp(nameOf(entries[pos].idx), name) == 0) {
+                return entries[pos].idx;
+            }
+        }
+        return -1;
+    }
+
+    // Вставка; при заполнении больше чем наполовину растем вдвое
+    void insert(uint32_t hash, int idx) {
+        if ((count + 1) * 2 > entries.size()) {
+            std::vector<Entry> old;
+            old.swap(entries);
+            reset(old.empty() ? 1024 : old.size() * 2);
+            for (const Entry& entry : old) {
+                if (entry.idx != -1) {
+                    place(entry.hash, entry.idx);
+                }
+            }
+        }
+        place(hash, idx);
+    }
+
+    // Удаление записи idx со сдвигом следующих записей назад (без надгробий)
+    void erase(uint32_t hash, int idx) {
+        if (entries.empty()) {
+            return;
+        }
+        size_t mask = entries.size() - 1;
+        size_t pos = hash & mask;
+        while (entries[pos].idx != idx) {
+            if (entries[pos].idx == -1) {
+                return; // такой записи нет
+            }
+            pos = (pos + 1) & mask;
+        }
+
+        size_t hole = pos;
+        for (size_t next = (hole + 1) & mask; entries[next].idx != -1; next = (next + 1) & mask) {
+            size_t home = entries[next].hash & mask;
+            // Запись можно сдвинуть в дыру, если дыра лежит между ее домом и текущим местом
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                entries[hole] = entries[next];
+                hole = next;
+            }
+        }
+        entries[hole].idx = -1;
+        count--;
+    }
+
+private:
+    void place(uint32_t hash, int idx) {
+        size_t mask = entries.size() - 1;
+        size_t pos = hash & mask;
+        while (entries[pos].idx != -1) {
+            pos = (pos + 1) & mask;
+        }
+        entries[pos].hash = hash;
+        entries[pos].idx = idx;
+        count++;
+    }
+};
+
+// Хеш имени игрока (FNV-1a)
+inline uint32_t hashName(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Таблица игроков, общая для всех шардов. Записи лежат в сегментах, которые не
+// переезжают при росте, поэтому номер игрока действует без блокировок.
+// Индекс имен разбит на полосы по хешу имени, каждая под своим мьютексом;
+// поля записи меняются под мьютексом ее полосы по номеру (lockOf).
+// Рядом с записью - сессия, через которую игрок вошел: она живет только в
+// памяти сервера и в снимок статистики не попадает.
+#define PLAYER_SEGMENT_SIZE 1024
+#define PLAYER_MAX_SEGMENTS 4096
+#define PLAYER_STRIPES 16
+
+class PlayerTable {
+public:
+    PlayerTable() : count(0) {
+        for (int i = 0; i < PLAYER_MAX_SEGMENTS; i++) {
+            segments[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~PlayerTable() {
+        for (int i = 0; i < PLAYER_MAX_SEGMENTS; i++) {
+            delete[] segments[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Число записей (включая те, что прямо сейчас заполняются другим потоком)
+    int size() const {
+        return count.load(std::memory_order_acquire);
+    }
+
+    PlayerStats& at(int idx) {
+        return record(idx).stats;
+    }
+
+    // Сессия вошедшего игрока (NO_SESSION - не входил с запуска сервера); под lockOf
+    SessionId& sessionOf(int idx) {
+        return record(idx).session;
+    }
+
+    // Мьютекс, под которым меняются поля записи idx
+    std::mutex& lockOf(int idx) {
+        return recordLocks[idx % PLAYER_STRIPES];
+    }
+
+    // Поиск игрока по имени, -1 - не найден
+    int find(const char* username) {
+        uint32_t hash = hashName(username);
+        Stripe& stripe = stripes[hash % PLAYER_STRIPES];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        return findLocked(stripe, username, hash);
+    }
+
+    // Поиск игрока; нового регистрируем (added = true). -1 - таблица заполнена
+    int findOrAdd(const char* username, bool& added) {
+        uint32_t hash = hashName(username);
+        Stripe& stripe = stripes[hash % PLAYER_STRIPES];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+
+        added = false;
+        int idx = findLocked(stripe, username, hash);
+        if (idx != -1) {
+            return idx;
+        }
+
+        idx = count.fetch_add(1, std::memory_order_acq_rel);
+        if (!ensureSegment(idx / PLAYER_SEGMENT_SIZE)) {
+            count.fetch_sub(1, std::memory_order_acq_rel);
+            return -1;
+        }
+        initRecord(record(idx), username);
+        stripe.index.insert(hash, idx);
+        added = true;
+        return idx;
+    }
+
+    // Запись с заранее известным номером (загрузка снимка и повтор журнала, один поток)
+    PlayerStats* insertAt(int idx, const char* username) {
+        if (idx < 0 || !ensureSegment(idx / PLAYER_SEGMENT_SIZE)) {
+            return nullptr;
+        }
+        if (idx >= count.load(std::memory_order_relaxed)) {
+            count.store(idx + 1, std::memory_order_release);
+        }
+        initRecord(record(idx), username);
+
+        uint32_t hash = hashName(at(idx).username);
+        stripes[hash % PLAYER_STRIPES].index.insert(hash, idx);
+        return &at(idx);
+    }
+
+    // Очистка таблицы (только пока шарды не запущены)
+    void clear() {
+        for (int i = 0; i < PLAYER_MAX_SEGMENTS; i++) {
+            delete[] segments[i].exchange(nullptr, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < PLAYER_STRIPES; i++) {
+            stripes[i].index.reset(1024);
+        }
+        count.store(0, std::memory_order_release);
+    }
+
+private:
+    struct Record {
+        PlayerStats stats;
+        SessionId session;
+    };
+
+    struct Stripe {
+        std::mutex mutex;
+        NameIndex index;
+    };
+
+    Record& record(int idx) {
+        return segments[idx / PLAYER_SEGMENT_SIZE].load(std::memory_order_acquire)[idx % PLAYER_SEGMENT_SIZE];
+    }
+
+    int findLocked(Stripe& stripe, const char* username, uint32_t hash) {
+        return stripe.index.find(username, hash, [this](int idx) { return at(idx).username; });
+    }
+
+    static void initRecord(Record& record, const char* username) {
+        record.stats = PlayerStats();
+        strncpy(record.stats.username, username, sizeof(record.stats.username) - 1);
+        record.stats.username[sizeof(record.stats.username) - 1] = '\0';
+        record.session = NO_SESSION;
+    }
+
+    bool ensureSegment(int segment) {
+        if (segment >= PLAYER_MAX_SEGMENTS) {
+            return false;
+        }
+        if (segments[segment].load(std::memory_order_acquire) == nullptr) {
+            std::lock_guard<std::mutex> lock(growMutex);
+            if (segments[segment].load(std::memory_order_relaxed) == nullptr) {
+                segments[segment].store(new Record[PLAYER_SEGMENT_SIZE](), std::memory_order_release);
+            }
+        }
+        return true;
+    }
+
+    std::atomic<Record*> segments[PLAYER_MAX_SEGMENTS];
+    std::atomic<int> count;
+    std::mutex growMutex;
+    Stripe stripes[PLAYER_STRIPES];
+    std::mutex recordLocks[PLAYER_STRIPES];
+};
+
+#endif // PLAYERS_H
@@ -0,0 +1,190 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <semaphore.h>
+#include "bench.h"
+#include "ipc.h"
+
+// Пропускная способность запрос-ответ: семафоры прежнего сервера против кольца
+// запросов из ipc.h. Клиенты - потоки, сервер - отдельный поток; каждый клиент
+// шлет запрос и ждет ответа, сервер только увеличивает число в слоте.
+//
+// ./ringbench [requests] [clients...]   (по умолчанию 200000 запросов, 1 8 64 256 клиентов)
+
+#define BENCH_MAX_CLIENTS 256
+
+enum BenchState : uint32_t {
+    BENCH_IDLE = 0,
+    BENCH_REQUEST = 1,
+    BENCH_RESPONSE = 2,
+    BENCH_SLEEPING = 3    // Клиент спит на futex слота (только кольцо)
+};
+
+struct alignas(64) BenchSlot {
+    std::atomic<uint32_t> state;
+    uint64_t value;
+    sem_t responseReady;  // Только семафоры
+};
+
+struct BenchShared {
+    BenchSlot slots[BENCH_MAX_CLIENTS];
+    RequestRing ring;
+    sem_t clientReady;
+    std::atomic<bool> stop;
+};
+
+// Семафоры: клиент постит общий семафор, сервер просыпается, обходит все
+// слоты и постит семафор каждого, кому ответил (как сервер до кольца)
+void semaphoreServer(BenchShared* shared, int clients) {
+    while (true) {
+        while (sem_wait(&shared->clientReady) == -1) {
+        }
+        if (shared->stop.load(std::memory_order_acquire)) {
+            return;
+        }
+        for (int i = 0; i < clients; i++) {
+            BenchSlot& slot = shared->slots[i];
+            if (slot.state.load(std::memory_order_acquire) != BENCH_REQUEST) {
+                continue;
+            }
+            slot.value++;
+            slot.state.store(BENCH_RESPONSE, std::memory_order_release);
+            sem_post(&slot.responseReady);
+        }
+    }
+}
+
+void semaphoreClient(BenchShared* shared, int idx, int requests) {
+    BenchSlot& slot = shared->slots[idx];
+    for (int r = 0; r < requests; r++) {
+        slot.state.store(BENCH_REQUEST, std::memory_order_release);
+        sem_post(&shared->clientReady);
+        while (sem_wait(&slot.responseReady) == -1) {
+        }
+        slot.state.store(BENCH_IDLE, std::memory_order_relaxed);
+    }
+}
+
+#define BENCH_STOP UINT32_MAX   // Запрос остановки сервера кольца
+
+// Кольцо: клиент кладет номер слота в кольцо, сервер разбирает его пачками и
+// будит клиента через futex, только если тот успел уснуть
+void ringServer(BenchShared* shared) {
+    uint32_t batch[64];
+    while (true) {
+        int count = shared->ring.popBatch(batch, 64);
+        if (count == 0) {
+            shared->ring.waitForRequests();
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (batch[i] == BENCH_STOP) {
+                return;
+            }
+            BenchSlot& slot = shared->slots[batch[i]];
+            slot.value++;
+            if (slot.state.exchange(BENCH_RESPONSE, std::memory_order_acq_rel) == BENCH_SLEEPING) {
+                futexWake(&slot.state);
+            }
+        }
+    }
+}
+
+void ringClient(BenchShared* shared, int idx, int requests) {
+    BenchSlot& slot = shared->slots[idx];
+    for (int r = 0; r < requests; r++) {
+        slot.state.store(BENCH_REQUEST, std::memory_order_release);
+        while (!shared->ring.push((uint32_t)idx)) {
+            sched_yield();
+        }
+
+        bool done = false;
+        for (int spin = 0; spin < 1000 && !done; spin++) {
+            done = slot.state.load(std::memory_order_acquire) == BENCH_RESPONSE;
+        }
+        uint32_t expected = BENCH_REQUEST;
+        if (!done && slot.state.compare_exchange_strong(expected, BENCH_SLEEPING, std::memory_order_acq_rel)) {
+            while (slot.state.load(std::memory_order_acquire) == BENCH_SLEEPING) {
+                futexWait(&slot.state, BENCH_SLEEPING);
+            }
+        }
+        slot.state.store(BENCH_IDLE, std::memory_order_relaxed);
+    }
+}
+
+// Запросов в секунду при clients клиентах
+double runBench(bool useRing, int clients, int requests) {
+    BenchShared* shared = new BenchShared();
+    shared->ring.init();
+    shared->stop.store(false, std::memory_order_relaxed);
+    sem_init(&shared->clientReady, 0, 0);
+    for (int i = 0; i < clients; i++) {
+        shared->slots[i].state.store(BENCH_IDLE, std::memory_order_relaxed);
+        shared->slots[i].value = 0;
+        sem_init(&shared->slots[i].responseReady, 0, 0);
+    }
+
+    int perClient = requests / clients;
+    Stopwatch stopwatch;
+    std::thread server = useRing ? std::thread(ringServer, shared) : std::thread(semaphoreServer, shared, clients);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; i++) {
+        threads.emplace_back(useRing ? ringClient : semaphoreClient, shared, i, perClient);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = stopwatch.seconds();
+
+    shared->stop.store(true, std::memory_order_release);
+    if (useRing) {
+        shared->ring.push(BENCH_STOP);
+    } else {
+        sem_post(&shared->clientReady);
+    }
+    server.join();
+
+    uint64_t answered = 0;
+    for (int i = 0; i < clients; i++) {
+        answered += shared->slots[i].value;
+        sem_destroy(&shared->slots[i].responseReady);
+    }
+    sem_destroy(&shared->clientReady);
+    delete shared;
+
+    if (answered != (uint64_t)perClient * clients) {
+        std::cerr << "Lost requests: " << answered << " of " << (uint64_t)perClient * clients << std::endl;
+        exit(1);
+    }
+    return answered / seconds;
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[requests] [clients...]");
+    int requests = (int)args.integer(1, 200000, 1, INT_MAX);
+    std::vector<int> clientCounts;
+    for (int i = 2; i < args.count(); i++) {
+        clientCounts.push_back((int)args.integer(i, 1, 1, BENCH_MAX_CLIENTS));
+    }
+    if (clientCounts.empty()) {
+        clientCounts = {1, 8, 64, 256};
+    }
+
+    std::cout << "Requests: " << requests << ", cores: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << std::setw(8) << "clients" << std::setw(16) << "semaphore/s" << std::setw(16) << "ring/s"
+              << std::setw(10) << "ratio" << std::endl;
+    for (int clients : clientCounts) {
+        if (requests < clients) {
+            args.fail();
+        }
+        double semaphore = runBench(false, clients, requests);
+        double ring = runBench(true, clients, requests);
+        std::cout << std::setw(8) << clients << std::fixed << std::setprecision(0)
+                  << std::setw(16) << semaphore << std::setw(16) << ring
+                  << std::setw(10) << std::setprecision(2) << ring / semaphore << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <cstdint>
+
+// Варианты игры: размер поля и состав флота.
+// Поле, расстановка и выстрелы (board.h, engine.h) - шаблоны по правилам, так что
+// у каждого варианта свой код, где размер поля и число кораблей - константы.
+// Вариант выбирается для каждой игры при CREATE_GAME и хранится в Game::rules;
+// по номеру варианта код нужных правил вызывает withRules()
+
+#define MAX_BOARD_SIZE 16    // Самое большое поле из вариантов
+#define MAX_FLEET_SHIPS 20   // Самый большой флот из вариантов
+
+// Типы кораблей
+enum ShipType {
+    BATTLESHIP = 4,   // Линкор (4 клетки)
+    CRUISER = 3,      // Крейсер (3 клетки)
+    DESTROYER = 2,    // Эсминец (2 клетки)
+    SUBMARINE = 1     // Подводная лодка (1 клетка)
+};
+
+// Маска поля 16x16: 256 бит четырьмя словами. Полям до 8x8 и до 11x11 хватает
+// uint64_t и unsigned __int128 - их операции дает компилятор, эта повторяет их
+// для четырех слов (все операции constexpr: на них строятся таблицы положений)
+struct WideMask {
+    uint64_t words[4];
+
+    constexpr WideMask() : words{0, 0, 0, 0} {}
+    constexpr WideMask(uint64_t low) : words{low, 0, 0, 0} {}
+
+    constexpr explicit operator bool() const {
+        return (words[0] | words[1] | words[2] | words[3]) != 0;
+    }
+
+    constexpr WideMask operator~() const {
+        WideMask result;
+        for (int i = 0; i < 4; i++) {
+            result.words[i] = ~words[i];
+        }
+        return result;
+    }
+
+    constexpr WideMask& operator&=(const WideMask& other) {
+        for (int i = 0; i < 4; i++) {
+            words[i] &= other.words[i];
+        }
+        return *this;
+    }
+
+    constexpr WideMask& operator|=(const WideMask& other) {
+        for (int i = 0; i < 4; i++) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    constexpr WideMask operator<<(int shift) const {
+        WideMask result;
+        int wordShift = shift / 64;
+        int bitShift = shift % 64;
+        for (int i = 3; i >= wordShift; i--) {
+            result.words[i] = words[i - wordShift] << bitShift;
+            if (bitShift != 0 && i - wordShift > 0) {
+                result.words[i] |= words[i - wordShift - 1] >> (64 - bitShift);
+            }
+        }
+        return result;
+    }
+
+    constexpr WideMask operator>>(int shift) const {
+        WideMask result;
+        int wordShift = shift / 64;
+        int bitShift = shift % 64;
+        for (int i = 0; i + wordShift < 4; i++) {
+            result.words[i] = words[i + wordShift] >> bitShift;
+            if (bitShift != 0 && i + wordShift < 3) {
+                result.words[i] |= words[i + wordShift + 1] << (64 - bitShift);
+            }
+        }
+        return result;
+    }
+
+    friend constexpr WideMask operator&(WideMask a, const WideMask& b) {
+        return a &= b;
+    }
+
+    friend constexpr WideMask operator|(WideMask a, const WideMask& b) {
+        return a |= b;
+    }
+
+    friend constexpr bool operator==(const WideMask& a, const WideMask& b) {
+        return a.words[0] == b.words[0] && a.words[1] == b.words[1] &&
+               a.words[2] == b.words[2] && a.words[3] == b.words[3];
+    }
+
+    friend constexpr bool operator!=(const WideMask& a, const WideMask& b) {
+        return !(a == b);
+    }
+};
+
+// Правила варианта: номер (Game::rules), сторона поля, число кораблей каждой длины
+// и тип маски поля (бит y * SIZE + x, клеток должно хватить)
+template <int Id, int Size, int Battleships, int Cruisers, int Destroyers, int Submarines, class MaskType>
+struct GameRules {
+    typedef MaskType Mask;
+
+    static constexpr int ID = Id;
+    static constexpr int SIZE = Size;
+    static constexpr int CELLS = Size * Size;
+    static constexpr int TOTAL_SHIPS = Battleships + Cruisers + Destroyers + Submarines;
+
+    // Кораблей длины length
+    static constexpr int shipCount(int length) {
+        return length == BATTLESHIP ? Battleships :
+               length == CRUISER ? Cruisers :
+               length == DESTROYER ? Destroyers :
+               length == SUBMARINE ? Submarines : 0;
+    }
+
+    static_assert(CELLS <= (int)sizeof(Mask) * 8, "Board does not fit into the mask");
+    static_assert(Size <= MAX_BOARD_SIZE && TOTAL_SHIPS <= MAX_FLEET_SHIPS, "Raise MAX_BOARD_SIZE / MAX_FLEET_SHIPS");
+};
+
+// Номера вариантов (0 - классика: клиенты, не знающие о вариантах, играют в нее)
+enum GameRulesId {
+    RULES_CLASSIC = 0,
+    RULES_QUICK = 1,
+    RULES_LARGE = 2,
+    RULES_COUNT = 3
+};
+
+typedef GameRules<RULES_CLASSIC, 10, 1, 2, 3, 4, unsigned __int128> ClassicRules;   // 10x10, 10 кораблей
+typedef GameRules<RULES_QUICK, 8, 1, 1, 2, 3, uint64_t> QuickRules;                 // 8x8, 7 кораблей
+typedef GameRules<RULES_LARGE, 16, 2, 4, 6, 8, WideMask> LargeRules;                // 16x16, 20 кораблей
+
+// Описание варианта для меню и проверок, где правила известны только во время работы
+struct RulesInfo {
+    const char* name;
+    int boardSize;
+    int totalShips;
+    int shipCounts[BATTLESHIP + 1];   // Индекс - длина корабля
+};
+
+template <class Rules>
+constexpr RulesInfo makeRulesInfo(const char* name) {
+    return {name, Rules::SIZE, Rules::TOTAL_SHIPS,
+            {0, Rules::shipCount(SUBMARINE), Rules::shipCount(DESTROYER),
+             Rules::shipCount(CRUISER), Rules::shipCount(BATTLESHIP)}};
+}
+
+// По номеру варианта
+inline constexpr RulesInfo g_rulesInfo[RULES_COUNT] = {
+    makeRulesInfo<ClassicRules>("classic 10x10"),
+    makeRulesInfo<QuickRules>("quick 8x8"),
+    makeRulesInfo<LargeRules>("large 16x16"),
+};
+
+inline bool isValidRules(int rules) {
+    return rules >= 0 && rules < RULES_COUNT;
+}
+
+// Описание варианта; неизвестный номер - классика (как в withRules)
+inline const RulesInfo& rulesInfo(int rules) {
+    return g_rulesInfo[isValidRules(rules) ? rules : (int)RULES_CLASSIC];
+}
+
+// Вызов visit(Rules()) для варианта с номером rules (неизвестный номер - классика).
+// Код, работающий с полями игры, пишется шаблоном по правилам, а сюда передается
+// обобщенной лямбдой: [&](auto rules) { typedef decltype(rules) Rules; ... }
+template <class Visitor>
+inline auto withRules(int rules, Visitor&& visit) {
+    switch (rules) {
+        case RULES_QUICK: return visit(QuickRules());
+        case RULES_LARGE: return visit(LargeRules());
+        default: return visit(ClassicRules());
+    }
+}
+
+#endif // RULES_H
@@ -2,925 +2,2227 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
-#include <semaphore.h>
 #include <signal.h>
 #include <fstream>
 #include <cstring>
 #include <vector>
+#include <deque>
 #include <ctime>
 #include <cstdlib>
+#include <cstddef>
+#include <cstdarg>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <mutex>
 #include "common.h"
+#include "board.h"
+#include "engine.h"
+#include "journal.h"
+#include "transport.h"
+#include "arena.h"
+#include "log.h"
+#include "bot.h"
+#include "players.h"
+#include "text.h"
 
 // Global variables to store player data
-PlayerStats g_players[MAX_PLAYERS];
-int g_playerCount = 0;
-
+PlayerTable g_players;
+
+// Шард - часть таблицы игр со своим потоком. Шарду k принадлежат слоты
+// с номером slot % SERVER_SHARDS == k, а игра с именем name живет в шарде
+// hashName(name) % SERVER_SHARDS, так что запрос по имени и по номеру игры
+// попадает в один и тот же поток. Своими играми шард владеет без блокировок.
+struct Shard {
+    int id;
+    RequestRing queue;          // Запросы от диспетчера (номера почтовых слотов)
+    NameIndex gameIndex;        // Индекс игр шарда по имени
+    std::deque<int> freeGames[RULES_COUNT];  // Освобожденные слоты шарда по вариантам
+    int nextSlot[RULES_COUNT];  // Следующий ни разу не занятый слот шарда в кусках варианта
+    GameRandom random;          // Флоты бота в играх шарда
+    std::vector<int64_t> gameChanged;  // Последнее изменение игры (по slot / SERVER_SHARDS), 0 - с запуска
+    int64_t nextSweep;          // Когда снова искать брошенные игры
+};
+
+Shard g_shards[SERVER_SHARDS];
+
+// Слоты шарда в куске идут через SERVER_SHARDS: первый слот шарда в следующем
+// куске - тот же слот куска
+static_assert(GAME_CHUNK % SERVER_SHARDS == 0, "GAME_CHUNK is not a multiple of SERVER_SHARDS");
+
+// Все запросы в работе помещаются и в кольцо сервера, и в очередь любого шарда:
+// писатели не ждут места, а диспетчер не ждет шард
+static_assert(MAX_CLIENTS * PIPELINE_DEPTH + BOT_MAX_MOVES + SOCKET_RING_SHARE <= REQUEST_RING_SIZE,
+              "REQUEST_RING_SIZE is less than the requests in flight");
+
+// Запросов, отданных шардам и еще не отвеченных; диспетчер ждет на нем нуля
+std::atomic<uint32_t> g_inFlight(0);
+std::atomic<uint32_t> g_barrierWaiting(0);
 
 // Глобальные переменные для обработки сигналов
 SharedMemory* g_sharedMem = nullptr;
-int g_shm_fd = -1;
-sem_t* g_semClientReady = nullptr;
-sem_t* g_semServerReady = nullptr;
+SharedArena g_arena;
+std::mutex g_arenaMutex;  // Рост сегмента (куски таблицы игр добавляют шарды)
+
+// Журнал сервера: запросы пишутся в него, а не в std::cout
+AsyncLogger g_log;
+
+// Бот - второй игрок игр PLAY_VS_BOT (свой поток и транспорт)
+BotPlayer g_bot;
+
+// Транспорты по номеру из старших битов номера запроса
+SocketTransport g_socketTransport;
+Transport* g_transports[TRANSPORT_COUNT] = {};
+
+// Диспетчер: разбираем кадр пришедшего запроса; nullptr - номер неверен
+Message* receiveRequest(uint32_t requestId) {
+    uint32_t transport = requestId >> TRANSPORT_SHIFT;
+    if (transport >= TRANSPORT_COUNT || g_transports[transport] == nullptr) {
+        return nullptr;
+    }
+    return g_transports[transport]->receive(requestId & TRANSPORT_LOCAL_MASK);
+}
+
+// Сообщение запроса по его номеру; nullptr - номер неверен
+Message* requestMessage(uint32_t requestId) {
+    uint32_t transport = requestId >> TRANSPORT_SHIFT;
+    if (transport >= TRANSPORT_COUNT || g_transports[transport] == nullptr) {
+        return nullptr;
+    }
+    return g_transports[transport]->message(requestId & TRANSPORT_LOCAL_MASK);
+}
+
+// Отдаем ответ клиенту тем же транспортом, которым пришел запрос
+void completeRequest(uint32_t requestId) {
+    g_transports[requestId >> TRANSPORT_SHIFT]->complete(requestId & TRANSPORT_LOCAL_MASK);
+}
+
+// Канал сессии все еще у того же клиента (соединение открыто, процесс слота жив)
+bool sessionAlive(SessionId session) {
+    uint32_t channel = (uint32_t)session;
+    uint32_t transport = channel >> TRANSPORT_SHIFT;
+    if (session == NO_SESSION || transport >= TRANSPORT_COUNT || g_transports[transport] == nullptr) {
+        return false;
+    }
+    return g_transports[transport]->sessionAlive(channel & TRANSPORT_LOCAL_MASK, (uint32_t)(session >> 32));
+}
+
+// Журнал изменений статистики: между снимками player_stats.dat каждое изменение
+// (новый игрок, победа, поражение) дописывается в конец журнала.
+enum StatsJournalType {
+    STATS_NEW_PLAYER = 1,
+    STATS_WIN = 2,
+    STATS_LOSS = 3
+};
+
+struct StatsJournalRecord {
+    uint64_t lsn;          // Порядковый номер записи
+    uint32_t type;         // StatsJournalType
+    int32_t playerIdx;
+    char username[64];     // Имя нового игрока (STATS_NEW_PLAYER)
+    uint32_t checksum;     // Отсекает недописанную запись в конце журнала
+};
+
+// Заголовок снимка статистики; файлы без него - старый формат (сразу число игроков)
+#define STATS_SNAPSHOT_MAGIC 0x33534253u // "SBS3" (текущая игра - номером)
+#define STATS_SNAPSHOT_MAGIC_V2 0x32534253u // "SBS2"
+
+// Запись игрока в снимках до SBS3: текущая игра хранилась именем
+struct PlayerStatsV2 {
+    char username[64];
+    int wins;
+    int losses;
+    bool active;
+    bool inGame;
+    char currentGame[64];
+};
+
+Journal g_statsJournal;
+std::mutex g_commitMutex;            // Одна групповая фиксация за раз
+struct timespec g_journalLastSync;   // Время последнего fdatasync (под g_commitMutex)
+std::atomic<bool> g_compactRequested(false);
+// Журнал не пишется (диск полон, ошибка ввода-вывода): пока сброс не удастся,
+// запросы с изменениями отклоняются - подтвердить их сохранение нечем
+std::atomic<bool> g_journalFailed(false);
+// Записей журналов, добавленных потоком (шард видит, какой запрос что-то изменил)
+thread_local uint32_t t_journalRecords = 0;
+std::atomic<bool> g_shutdownRequested(false);   // SIGINT: диспетчер сохраняет данные и выходит
 
 // Загрузка статистики из файла
-void loadStats() {
+uint64_t loadStats() {
+    g_players.clear();
+
     std::ifstream file(STATS_FILE, std::ios::binary);
     if (!file) {
         std::cout << "Stats file not found, starting with empty database." << std::endl;
-        g_playerCount = 0;
-        return;
+        return 0;
     }
 
-    file.read(reinterpret_cast<char*>(&g_playerCount), sizeof(int));
+    uint64_t snapshotLsn = 0;
+    int playerCount = 0;
+    uint32_t magic = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    if (magic == STATS_SNAPSHOT_MAGIC || magic == STATS_SNAPSHOT_MAGIC_V2) {
+        file.read(reinterpret_cast<char*>(&snapshotLsn), sizeof(snapshotLsn));
+        file.read(reinterpret_cast<char*>(&playerCount), sizeof(int));
+    } else {
+        playerCount = (int)magic;
+    }
 
-    if (g_playerCount > MAX_PLAYERS) {
+    if (!file || playerCount < 0 || playerCount > PLAYER_SEGMENT_SIZE * PLAYER_MAX_SEGMENTS) {
+        std::cerr << "Warning: Corrupt stats file. Resetting." << std::endl;
+        return 0;
+    }
+
+    // Из снимка берем только имя и счет; текущие игры восстанавливает recoverGames
+    size_t recordSize = (magic == STATS_SNAPSHOT_MAGIC) ? sizeof(PlayerStats) : sizeof(PlayerStatsV2);
+    std::vector<char> records((size_t)playerCount * recordSize);
+    file.read(records.data(), (std::streamsize)records.size());
+    if (!file) {
         std::cerr << "Warning: Corrupt stats file or too many players. Resetting." << std::endl;
-        g_playerCount = 0;
-        return;
+        return 0;
     }
 
-    for (int i = 0; i < g_playerCount; i++) {
-        file.read(reinterpret_cast<char*>(&g_players[i]), sizeof(PlayerStats));
-        g_players[i].active = false;
-        g_players[i].inGame = false;
+    for (int i = 0; i < playerCount; i++) {
+        const char* record = records.data() + i * recordSize;
+        char username[64];
+        int wins, losses;
+        memcpy(username, record + offsetof(PlayerStats, username), sizeof(username));
+        memcpy(&wins, record + offsetof(PlayerStats, wins), sizeof(wins));
+        memcpy(&losses, record + offsetof(PlayerStats, losses), sizeof(losses));
+        username[sizeof(username) - 1] = '\0';
+
+        PlayerStats* player = g_players.insertAt(i, username);
+        player->wins = wins;
+        player->losses = losses;
     }
 
-    std::cout << "Loaded " << g_playerCount << " player records." << std::endl;
+    std::cout << "Loaded " << playerCount << " player records." << std::endl;
     file.close();
+    return snapshotLsn;
+}
+
+// Пишем файл целиком во временный и атомарно подменяем им старый
+bool writeFileAtomically(const char* path, const std::vector<char>& data) {
+    std::string tmpName = std::string(path) + ".tmp";
+    int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n <= 0) {
+            close(fd);
+            return false;
+        }
+        written += (size_t)n;
+    }
+    fsync(fd);
+    close(fd);
+
+    return rename(tmpName.c_str(), path) == 0;
 }
 
-// Сохранение статистики в файл
+// Дописываем значение в буфер снимка
+template <typename T>
+void appendBytes(std::vector<char>& data, const T* value, size_t count = 1) {
+    const char* bytes = reinterpret_cast<const char*>(value);
+    data.insert(data.end(), bytes, bytes + count * sizeof(T));
+}
+
+// Сохранение статистики в файл (снимок с номером последней вошедшей записи журнала).
+// Вызывается, только когда шарды стоят
 void saveStats() {
-    std::ofstream file(STATS_FILE, std::ios::binary);
-    if (!file) {
-        std::cerr << "Error: Cannot open stats file for writing!" << std::endl;
+    uint32_t magic = STATS_SNAPSHOT_MAGIC;
+    uint64_t snapshotLsn = g_statsJournal.lastLsn();
+    int playerCount = g_players.size();
+    std::vector<char> data;
+    data.reserve(sizeof(magic) + sizeof(snapshotLsn) + sizeof(int) + playerCount * sizeof(PlayerStats));
+    appendBytes(data, &magic);
+    appendBytes(data, &snapshotLsn);
+    appendBytes(data, &playerCount);
+    for (int i = 0; i < playerCount; i++) {
+        appendBytes(data, &g_players.at(i));
+    }
+
+    if (!writeFileAtomically(STATS_FILE, data)) {
+        std::cerr << "Error: Cannot write stats file: " << strerror(errno) << std::endl;
         return;
     }
 
-    file.write(reinterpret_cast<const char*>(&g_playerCount), sizeof(int));
+    std::cout << "Saved " << playerCount << " player records." << std::endl;
+}
 
-    for (int i = 0; i < g_playerCount; i++) {
-        file.write(reinterpret_cast<const char*>(&g_players[i]), sizeof(PlayerStats));
+// Дописываем изменение статистики в журнал (на диск попадет при commitJournals)
+void journalStats(StatsJournalType type, int playerIdx) {
+    if (!g_statsJournal.isOpen()) {
+        return; // идет восстановление
     }
+    StatsJournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.playerIdx = playerIdx;
+    if (type == STATS_NEW_PLAYER) {
+        strcpy(record.username, g_players.at(playerIdx).username);
+    }
+    g_statsJournal.appendRecord(record);
+    t_journalRecords++;
+}
 
-    std::cout << "Saved " << g_playerCount << " player records." << std::endl;
+// Сворачиваем журнал в новый снимок статистики (шарды стоят)
+void compactStats() {
+    g_statsJournal.flush(true);
+    saveStats();
+    g_statsJournal.truncate();
+}
+
+// Восстановление: снимок + журнал с записями новее снимка
+void recoverStats() {
+    uint64_t snapshotLsn = loadStats();
+    uint64_t lastLsn = snapshotLsn;
+
+    int replayed = 0;
+    std::ifstream file(STATS_JOURNAL_FILE, std::ios::binary);
+    StatsJournalRecord record;
+    while (file && file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        if (record.checksum != journalChecksum(&record, offsetof(StatsJournalRecord, checksum))) {
+            std::cerr << "Warning: Torn record at the end of stats journal, ignoring the rest." << std::endl;
+            break;
+        }
+        if (record.lsn <= snapshotLsn) {
+            continue; // уже в снимке
+        }
+
+        // Номер игрока берем из записи: шарды регистрируют игроков параллельно,
+        // и порядок записей в журнале не совпадает с порядком номеров
+        if (record.type == STATS_NEW_PLAYER) {
+            record.username[sizeof(record.username) - 1] = '\0';
+            g_players.insertAt(record.playerIdx, record.username);
+        } else if (record.playerIdx >= 0 && record.playerIdx < g_players.size()) {
+            if (record.type == STATS_WIN) {
+                g_players.at(record.playerIdx).wins++;
+            } else if (record.type == STATS_LOSS) {
+                g_players.at(record.playerIdx).losses++;
+            }
+        }
+        lastLsn = record.lsn;
+        replayed++;
+    }
     file.close();
+
+    if (!g_statsJournal.open(STATS_JOURNAL_FILE)) {
+        std::cerr << "Error: Cannot open stats journal: " << strerror(errno) << std::endl;
+    }
+    g_statsJournal.setLastLsn(lastLsn);
+    clock_gettime(CLOCK_MONOTONIC, &g_journalLastSync);
+
+    // Переписываем снимок сразу, чтобы журнал начинался с чистого листа
+    if (replayed > 0) {
+        std::cout << "Replayed " << replayed << " stats journal records." << std::endl;
+        compactStats();
+    }
 }
 
 // Поиск игрока по имени
 int findPlayer(const char* username) {
-    for (int i = 0; i < g_playerCount; i++) {
-        if (strcmp(g_players[i].username, username) == 0) {
-            return i;
-        }
+    return g_players.find(username);
+}
+
+// Имя игрока для отображения; имя записи не меняется, блокировка не нужна
+const char* playerName(PlayerId player) {
+    if (player < 0 || player >= g_players.size()) {
+        return "";
+    }
+    return g_players.at(player).username;
+}
+
+// Отправитель запроса: номер из LOGIN_RESPONSE. По имени не ищем - иначе любой
+// мог бы действовать от имени другого; для сокетов номер подставляет соединение
+PlayerId requestPlayer(const Message& msg) {
+    if (msg.playerId >= 0 && msg.playerId < g_players.size()) {
+        return msg.playerId;
+    }
+    return NO_PLAYER;
+}
+
+// Соединение игрока закрылось (поток epoll): он больше не в сети, если с тех пор
+// не вошел через другой канал. Клиентов общей памяти проверяет handleLogin по pid
+void releasePlayerSession(PlayerId player, SessionId session) {
+    if (player < 0 || player >= g_players.size()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_players.lockOf(player));
+    if (g_players.sessionOf(player) == session) {
+        g_players.at(player).active = false;
+        g_players.sessionOf(player) = NO_SESSION;
     }
-    return -1;
 }
 
-// Добавление нового игрока
-int addPlayer(const char* username) {
-    if (g_playerCount >= MAX_PLAYERS) {
-        return -1; // max players reached
+// Номер участника игры: 1 или 2, 0 - игрок в ней не участвует
+int participantOf(const Game& game, PlayerId player) {
+    if (player == NO_PLAYER) {
+        return 0;
+    }
+    if (game.player1 == player) {
+        return 1;
+    }
+    return game.player2 == player ? 2 : 0;
+}
+
+// Игрок заходит в игру (или выходит из нее, если game - INVALID_GAME_HANDLE)
+void setPlayerGame(PlayerId player, GameHandle game) {
+    if (player < 0 || player >= g_players.size()) {
+        return;
     }
+    std::lock_guard<std::mutex> lock(g_players.lockOf(player));
+    PlayerStats& stats = g_players.at(player);
+    stats.inGame = (game != INVALID_GAME_HANDLE);
+    stats.currentGame = game;
+}
 
-    int idx = g_playerCount++;
-    strncpy(g_players[idx].username, username, sizeof(g_players[idx].username) - 1);
-    g_players[idx].username[sizeof(g_players[idx].username) - 1] = '\0';
-    g_players[idx].wins = 0;
-    g_players[idx].losses = 0;
-    g_players[idx].active = true;
-    g_players[idx].inGame = false;
-    g_players[idx].currentGame[0] = '\0';
+// Шард, которому принадлежит игра с таким именем
+int shardOfName(const char* gameName) {
+    return (int)(hashName(gameName) % SERVER_SHARDS);
+}
 
-    return idx;
+// Поиск игры шарда по имени
+int findGame(Shard& shard, SharedMemory* sharedMem, const char* gameName) {
+    return shard.gameIndex.find(gameName, hashName(gameName),
+                                [sharedMem](int idx) { return gameAt(sharedMem, idx).name; });
 }
 
-// Поиск игры по имени
-int findGame(SharedMemory* sharedMem, const char* gameName) {
-    for (int i = 0; i < sharedMem->gameCount; i++) {
-        if (strcmp(sharedMem->games[i].name, gameName) == 0 && sharedMem->games[i].active) {
-            return i;
+// Поиск игры по номеру (handle); устаревший номер от освобожденного слота не подходит
+int findGameByHandle(Shard& shard, SharedMemory* sharedMem, GameHandle handle) {
+    uint32_t idx = gameHandleSlot(handle);
+    if (handle == INVALID_GAME_HANDLE || idx >= (uint32_t)sharedMem->gameCount.load(std::memory_order_acquire) ||
+        (int)(idx % SERVER_SHARDS) != shard.id) {
+        return -1;
+    }
+    const Game& game = gameAt(sharedMem, idx);
+    if (!game.active || game.generation != gameHandleGeneration(handle)) {
+        return -1;
+    }
+    return (int)idx;
+}
+
+// Игра из запроса: по номеру, если клиент его прислал, иначе по имени
+int resolveGame(Shard& shard, SharedMemory* sharedMem, const Message& msg) {
+    if (msg.gameHandle != INVALID_GAME_HANDLE) {
+        return findGameByHandle(shard, sharedMem, msg.gameHandle);
+    }
+    return findGame(shard, sharedMem, msg.gameName);
+}
+
+// Писатель seqlock (только поток шарда игры): до изменения записи версия
+// становится нечетной, после - снова четной, и ждущие клиенты просыпаются.
+// Читатели без блокировок (readGameView) повторяют копирование, если попали на запись
+void beginGameWrite(Game& game) {
+    game.version.store(game.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void endGameWrite(Game& game) {
+    game.version.store(game.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    futexWake(&game.version);
+}
+
+// Журнал ходов: между снимками games_data.dat каждое изменение игры дописывается
+// в конец журнала, при перезапуске сервер повторяет их поверх снимка.
+enum GameJournalType {
+    GAME_CREATED = 1,
+    GAME_JOINED = 2,
+    GAME_SHIP_PLACED = 3,
+    GAME_FLEET_PLACED = 4,
+    GAME_SHIPS_READY = 5,
+    GAME_MOVE = 6,
+    GAME_RELEASED = 7
+};
+
+struct GameJournalRecord {
+    uint64_t lsn;
+    uint32_t type;                    // GameJournalType
+    int32_t slot;
+    uint32_t generation;              // Поколение слота: отсекает записи о прежней игре в нем
+    int32_t player;                   // 1 или 2
+    int32_t x, y;
+    int32_t length;
+    int32_t horizontal;
+    int32_t fleetSize;
+    int32_t markReady;
+    int32_t rules;                    // GAME_CREATED - вариант игры
+    char name[64];                    // GAME_CREATED - имя игры, GAME_JOINED - имя второго игрока
+    char player1[64];                 // GAME_CREATED - создатель игры
+    ShipPlacement fleet[MAX_FLEET_SHIPS]; // GAME_FLEET_PLACED
+    uint32_t checksum;
+};
+
+#define GAMES_SNAPSHOT_MAGIC 0x37474253u // "SBG7" (куски таблицы по вариантам)
+
+Journal g_gamesJournal;
+
+// Заготовка записи журнала ходов для игры в слоте idx
+GameJournalRecord makeGameRecord(GameJournalType type, int idx, int player = 0) {
+    GameJournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.slot = idx;
+    record.generation = gameAt(g_sharedMem, idx).generation;
+    record.player = player;
+    return record;
+}
+
+// Секунды монотонных часов
+int64_t monotonicSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+// Брошенные игры: запуск сервера и срок без изменений (SEA_BATTLE_ABANDON_SECONDS)
+int64_t g_startTime = 0;
+int64_t g_abandonSeconds = GAME_ABANDON_SECONDS;
+
+// Игра изменилась: срок до ее освобождения как брошенной отсчитывается заново.
+// Зовут поток шарда игры и восстановление до запуска шардов
+void touchGame(int idx) {
+    Shard& shard = g_shards[idx % SERVER_SHARDS];
+    size_t pos = idx / SERVER_SHARDS;
+    if (shard.gameChanged.size() <= pos) {
+        shard.gameChanged.resize(pos + 1, 0);
+    }
+    shard.gameChanged[pos] = monotonicSeconds();
+}
+
+// Дописываем изменение игры в журнал (на диск попадет при commitJournals)
+void journalGame(GameJournalRecord& record) {
+    touchGame(record.slot);
+    if (!g_gamesJournal.isOpen()) {
+        return; // идет восстановление
+    }
+    g_gamesJournal.appendRecord(record);
+    t_journalRecords++;
+}
+
+// Освобождаем слот законченной игры для повторного использования
+void releaseGame(Shard& shard, SharedMemory* sharedMem, int idx) {
+    Game& game = gameAt(sharedMem, idx);
+    if (!game.active) {
+        return;
+    }
+    GameJournalRecord record = makeGameRecord(GAME_RELEASED, idx);
+    journalGame(record);
+
+    shard.gameIndex.erase(hashName(game.name), idx);
+    beginGameWrite(game);
+    game.active = false;
+    // Будим тех, кто еще ждет эту игру - они увидят, что ее больше нет
+    endGameWrite(game);
+    shard.freeGames[game.rules].push_back(idx);
+}
+
+// Игрок в сети: вошел, и канал его сессии жив (бот в сеть не входит)
+bool playerOnline(PlayerId player) {
+    if (player < 0 || player >= g_players.size()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_players.lockOf(player));
+    return g_players.at(player).active && sessionAlive(g_players.sessionOf(player));
+}
+
+// Брошенная игра: никого из ее игроков нет в сети, и она не менялась g_abandonSeconds.
+// Такая игра (ждет соперника, на расстановке или посреди партии) держала бы слот
+// и имя вечно - ее освобождаем. Вернувшийся раньше срока игрок продолжает игру
+bool isAbandoned(Shard& shard, int idx, int64_t now) {
+    const Game& game = gameAt(g_sharedMem, idx);
+    size_t pos = idx / SERVER_SHARDS;
+    int64_t changed = g_startTime;
+    if (pos < shard.gameChanged.size() && shard.gameChanged[pos] != 0) {
+        changed = shard.gameChanged[pos];
+    }
+    return game.active && now - changed >= g_abandonSeconds && !playerOnline(game.player1) &&
+           !playerOnline(game.player2);
+}
+
+void releaseAbandonedGame(Shard& shard, int idx) {
+    g_log.info("Releasing abandoned game: %s", gameAt(g_sharedMem, idx).name);
+    releaseGame(shard, g_sharedMem, idx);
+}
+
+// Раз в GAME_SWEEP_SECONDS шард освобождает свои брошенные игры
+void sweepAbandonedGames(Shard& shard) {
+    int64_t now = monotonicSeconds();
+    if (now < shard.nextSweep) {
+        return;
+    }
+    shard.nextSweep = now + GAME_SWEEP_SECONDS;
+    int gameCount = g_sharedMem->gameCount.load(std::memory_order_relaxed);
+    for (int i = shard.id; i < gameCount; i += SERVER_SHARDS) {
+        if (isAbandoned(shard, i, now)) {
+            releaseAbandonedGame(shard, i);
         }
     }
-    return -1;
 }
 
-// Создание новой игры
-int createGame(SharedMemory* sharedMem, const char* gameName, const char* playerName) {
-    if (sharedMem->gameCount >= MAX_GAMES) {
-        return -1; // достигнут максимум игр
+// Пустые игры куска варианта rules: записям проставляем вариант и место досок
+void initGameChunk(char* chunk, int rules) {
+    withRules(rules, [&](auto variant) {
+        typedef GameBoards<decltype(variant)> Boards;
+        Game* games = reinterpret_cast<Game*>(chunk);
+        Boards* boards = reinterpret_cast<Boards*>(chunk + GAME_CHUNK * sizeof(Game));
+        for (int i = 0; i < GAME_CHUNK; i++) {
+            Game* game = new (&games[i]) Game();
+            game->rules = (uint8_t)rules;
+            game->boards = (uint32_t)(reinterpret_cast<char*>(&boards[i]) - reinterpret_cast<char*>(game));
+        }
+    });
+}
+
+// Заводим кусок k таблицы игр варианта rules: записи игр и их доски.
+// false - арена достигла предела. Вызывается под g_arenaMutex
+bool addGameChunk(SharedMemory* sharedMem, int k, int rules) {
+    uint64_t offset = g_arena.grow(gameChunkBytes(rules));
+    if (offset == 0) {
+        return false;
     }
+    // Новые страницы сегмента нулевые - это пустые доски
+    initGameChunk(reinterpret_cast<char*>(sharedMem) + offset, rules);
+    sharedMem->chunkRules[k] = (uint8_t)rules;
+    sharedMem->gameChunks[k].store(offset, std::memory_order_release);
+    return true;
+}
 
-    // Проверяем, не занято ли это имя
-    if (findGame(sharedMem, gameName) != -1) {
-        return -2; // игра с таким именем уже существует
+// Следующий ни разу не занятый слот шарда в кусках варианта rules.
+// Куски заводятся по порядку: если кусок под курсором шарда еще не заведен, все
+// меньшие уже есть, и новый кусок получает вариант того, кто завел его первым.
+// Кусок чужого варианта шард пропускает. -1 - арена достигла предела
+int nextFreshSlot(Shard& shard, SharedMemory* sharedMem, int rules) {
+    int& next = shard.nextSlot[rules];
+    while (next < MAX_GAMES) {
+        int k = next / GAME_CHUNK;
+        if (sharedMem->gameChunks[k].load(std::memory_order_acquire) == 0) {
+            std::lock_guard<std::mutex> lock(g_arenaMutex);
+            if (sharedMem->gameChunks[k].load(std::memory_order_relaxed) == 0 &&
+                !addGameChunk(sharedMem, k, rules)) {
+                return -1;
+            }
+        }
+        if (sharedMem->chunkRules[k] != rules) {
+            next = (k + 1) * GAME_CHUNK + shard.id;
+            continue;
+        }
+        int idx = next;
+        next += SERVER_SHARDS;
+        return idx;
+    }
+    return -1;
+}
+
+// Берем свободный слот шарда в кусках варианта rules: из очереди освобожденных, новый,
+// а если слоты кончились - забираем слот у законченной или брошенной игры шарда того же варианта
+int allocateGameSlot(Shard& shard, SharedMemory* sharedMem, int rules) {
+    std::deque<int>& freeGames = shard.freeGames[rules];
+    if (freeGames.empty()) {
+        int idx = nextFreshSlot(shard, sharedMem, rules);
+        if (idx != -1) {
+            // gameCount - верхняя граница занятых слотов всех шардов
+            int count = sharedMem->gameCount.load(std::memory_order_relaxed);
+            while (count < idx + 1 &&
+                   !sharedMem->gameCount.compare_exchange_weak(count, idx + 1, std::memory_order_release)) {
+            }
+            return idx;
+        }
+        int64_t now = monotonicSeconds();
+        int gameCount = sharedMem->gameCount.load(std::memory_order_relaxed);
+        for (int i = shard.id; i < gameCount; i += SERVER_SHARDS) {
+            if (gameAt(sharedMem, i).rules != rules) {
+                continue;
+            }
+            if (gameAt(sharedMem, i).active && gameAt(sharedMem, i).state == GAME_OVER) {
+                releaseGame(shard, sharedMem, i);
+            } else if (isAbandoned(shard, i, now)) {
+                releaseAbandonedGame(shard, i);
+            }
+        }
+        if (freeGames.empty()) {
+            return -1;
         }
+    }
 
-    int idx = sharedMem->gameCount++;
-    strncpy(sharedMem->games[idx].name, gameName, sizeof(sharedMem->games[idx].name) - 1);
-    sharedMem->games[idx].name[sizeof(sharedMem->games[idx].name) - 1] = '\0';
+    // FIFO: слот, освобожденный раньше всех, переиспользуем первым
+    int idx = freeGames.front();
+    freeGames.pop_front();
+    return idx;
+}
 
-    strncpy(sharedMem->games[idx].player1, playerName, sizeof(sharedMem->games[idx].player1) - 1);
-    sharedMem->games[idx].player1[sizeof(sharedMem->games[idx].player1) - 1] = '\0';
+// Новая игра в слоте (его кусок - того же варианта): создатель ждет соперника, поля пустые
+void resetGame(Game& game, const char* gameName, PlayerId creator) {
+    strncpy(game.name, gameName, sizeof(game.name) - 1);
+    game.name[sizeof(game.name) - 1] = '\0';
 
-    sharedMem->games[idx].player2[0] = '\0';
-    sharedMem->games[idx].state = WAITING_FOR_PLAYER;
-    sharedMem->games[idx].winner = 0;
-    sharedMem->games[idx].active = true;
+    game.player1 = creator;
+    game.player2 = NO_PLAYER;
+    game.state = WAITING_FOR_PLAYER;
+    game.winner = 0;
+    game.active = true;
+    game.eventSeq = 0;
 
     // Очищаем игровые поля
-    sharedMem->games[idx].board1.clear();
-    sharedMem->games[idx].board2.clear();
+    withRules(game.rules, [&](auto variant) {
+        typedef decltype(variant) Rules;
+        game.board<Rules>(true).clear();
+        game.board<Rules>(false).clear();
+    });
+}
 
-    // Обновляем статус игрока
-    int playerIdx = findPlayer(playerName);
-    if (playerIdx != -1) {
-        g_players[playerIdx].inGame = true;
-        strncpy(g_players[playerIdx].currentGame, gameName,
-                sizeof(g_players[playerIdx].currentGame) - 1);
-        g_players[playerIdx].currentGame[sizeof(g_players[playerIdx].currentGame) - 1] = '\0';
+// Создание новой игры
+int createGame(Shard& shard, SharedMemory* sharedMem, const char* gameName, PlayerId creator, int rules) {
+    // Проверяем, не занято ли это имя; имя брошенной игры освобождаем
+    int existing = findGame(shard, sharedMem, gameName);
+    if (existing != -1 && isAbandoned(shard, existing, monotonicSeconds())) {
+        releaseAbandonedGame(shard, existing);
+        existing = -1;
+    }
+    if (existing != -1) {
+        return -2; // игра с таким именем уже существует
+    }
+
+    int idx = allocateGameSlot(shard, sharedMem, rules);
+    if (idx == -1) {
+        return -1; // достигнут максимум игр
     }
+    beginGameWrite(gameAt(sharedMem, idx));
+    resetGame(gameAt(sharedMem, idx), gameName, creator);
+    gameAt(sharedMem, idx).generation++; // старые номера этого слота перестают действовать
+    endGameWrite(gameAt(sharedMem, idx));
+    shard.gameIndex.insert(hashName(gameAt(sharedMem, idx).name), idx);
+
+    GameJournalRecord record = makeGameRecord(GAME_CREATED, idx);
+    record.rules = rules;
+    strcpy(record.name, gameAt(sharedMem, idx).name);
+    strcpy(record.player1, playerName(creator)); // журнал хранит имена: он не зависит от номеров игроков
+    journalGame(record);
+
+    // Обновляем статус игрока
+    setPlayerGame(creator, makeGameHandle(idx, gameAt(sharedMem, idx).generation));
 
     return idx;
 }
 
 // Подсоединение к игре
-bool joinGame(SharedMemory* sharedMem, const char* gameName, const char* playerName) {
-    int gameIdx = findGame(sharedMem, gameName);
-    if (gameIdx == -1) {
-        return false; // Игры не найдено
+bool joinGame(SharedMemory* sharedMem, int gameIdx, PlayerId player) {
+    if (gameIdx == -1 || player == NO_PLAYER) {
+        return false; // Игры не найдено или игрок не вошел
     }
 
     // Special case: создатель присоединяется в своей же игре
-    if (strcmp(sharedMem->games[gameIdx].player1, playerName) == 0 &&
-        sharedMem->games[gameIdx].state == PLACING_SHIPS) {
+    if (gameAt(sharedMem, gameIdx).player1 == player &&
+        gameAt(sharedMem, gameIdx).state == PLACING_SHIPS) {
         return true; // Allow player1 to join their own game for ship placement
         }
 
     // Если игрка не в состоянии ожидания или игрок хочет подключится сам к себе - стоп
-    if (sharedMem->games[gameIdx].state != WAITING_FOR_PLAYER) {
+    if (gameAt(sharedMem, gameIdx).state != WAITING_FOR_PLAYER) {
         return false;
         }
 
     // Подсоединяем игрока к игре
-    strncpy(sharedMem->games[gameIdx].player2, playerName, sizeof(sharedMem->games[gameIdx].player2) - 1);
-    sharedMem->games[gameIdx].player2[sizeof(sharedMem->games[gameIdx].player2) - 1] = '\0';
+    beginGameWrite(gameAt(sharedMem, gameIdx));
+    gameAt(sharedMem, gameIdx).player2 = player;
 
     // Состояние игры - расстановка корабле
-    sharedMem->games[gameIdx].state = PLACING_SHIPS;
+    gameAt(sharedMem, gameIdx).state = PLACING_SHIPS;
+    endGameWrite(gameAt(sharedMem, gameIdx));
+
+    GameJournalRecord record = makeGameRecord(GAME_JOINED, gameIdx, 2);
+    strcpy(record.name, playerName(player));
+    journalGame(record);
 
     // Обновляем статус игрока
-    int playerIdx = findPlayer(playerName);
-    if (playerIdx != -1) {
-        g_players[playerIdx].inGame = true;
-        strncpy(g_players[playerIdx].currentGame, gameName,
-                sizeof(g_players[playerIdx].currentGame) - 1);
-        g_players[playerIdx].currentGame[sizeof(g_players[playerIdx].currentGame) - 1] = '\0';
+    setPlayerGame(player, makeGameHandle(gameIdx, gameAt(sharedMem, gameIdx).generation));
+
+    return true;
+}
+
+// Расставляем весь флот на копии поля: либо все корабли, либо ни одного
+template <class Rules>
+bool placeFleet(GameBoard<Rules>& board, const ShipPlacement* fleet, int fleetSize) {
+    GameBoard<Rules> staged;
+    bool placed = (fleetSize == Rules::TOTAL_SHIPS);
+    for (int i = 0; placed && i < fleetSize; i++) {
+        placed = canPlaceShipOfLength(staged, fleet[i].length) &&
+                 placeShip(staged, fleet[i].x, fleet[i].y, fleet[i].length, fleet[i].horizontal);
+    }
+
+    if (!placed || !areAllShipsPlaced(staged)) {
+        return false;
+    }
+    board = staged;
+    return true;
+}
+
+// Игрок готов: если корабли расставил и соперник, начинаем игру
+bool startGameIfReady(Game& game, bool isPlayer1) {
+    bool otherPlaced = withRules(game.rules, [&](auto variant) {
+        return areAllShipsPlaced(game.board<decltype(variant)>(!isPlayer1));
+    });
+    if (!otherPlaced) {
+        return false;
+    }
+    game.state = PLAYER1_TURN;
+    return true;
+}
+
+// Выстрел игрока и смена состояния игры; результат - как у processMove
+int applyMove(Game& game, bool isPlayer1, int x, int y) {
+    int result = withRules(game.rules, [&](auto variant) {
+        return processMove(game.board<decltype(variant)>(!isPlayer1), x, y);
+    });
+    int shooter = isPlayer1 ? 1 : 2;
+
+    // Очередь хода - по тем же правилам, что и в симуляции (engine.h)
+    int next = nextTurn(shooter, result);
+    if (next == 0) {
+        game.state = GAME_OVER;
+        game.winner = shooter;
+    } else {
+        game.state = next == 1 ? PLAYER1_TURN : PLAYER2_TURN;
+    }
+
+    // Запоминаем ход в кольце событий игры
+    if (result >= 0) {
+        MoveEvent& event = game.events[game.eventSeq % GAME_EVENT_RING];
+        event.seq = ++game.eventSeq;
+        event.shooter = shooter;
+        event.x = (uint8_t)x;
+        event.y = (uint8_t)y;
+        event.result = (int8_t)result;
+    }
+    return result;
+}
+
+// Начало куска k таблицы игр
+char* gameChunk(SharedMemory* sharedMem, int k) {
+    return reinterpret_cast<char*>(sharedMem) + sharedMem->gameChunks[k].load(std::memory_order_acquire);
+}
+
+// Сохранение таблицы игр (снимок с номером последней вошедшей записи журнала ходов).
+// Куски пишутся целиком, каждый - с вариантом: записи игр и их доски
+void saveGames(SharedMemory* sharedMem) {
+    uint32_t magic = GAMES_SNAPSHOT_MAGIC;
+    uint64_t snapshotLsn = g_gamesJournal.lastLsn();
+    int gameCount = sharedMem->gameCount.load(std::memory_order_acquire);
+    int chunks = (gameCount + GAME_CHUNK - 1) / GAME_CHUNK;
+    std::vector<char> data;
+    data.reserve(sizeof(magic) + sizeof(snapshotLsn) + sizeof(int) + chunks * (sizeof(int) + MAX_GAME_CHUNK_BYTES));
+    appendBytes(data, &magic);
+    appendBytes(data, &snapshotLsn);
+    appendBytes(data, &gameCount);
+    for (int k = 0; k < chunks; k++) {
+        int rules = sharedMem->chunkRules[k];
+        appendBytes(data, &rules);
+        appendBytes(data, gameChunk(sharedMem, k), gameChunkBytes(rules));
+    }
+
+    if (!writeFileAtomically(GAMES_FILE, data)) {
+        std::cerr << "Error: Cannot write games file: " << strerror(errno) << std::endl;
+    }
+}
+
+// Загрузка таблицы игр из снимка; возвращает номер последней вошедшей в него записи
+uint64_t loadGames(SharedMemory* sharedMem) {
+    std::ifstream file(GAMES_FILE, std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+
+    uint32_t magic = 0;
+    uint64_t snapshotLsn = 0;
+    int gameCount = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&snapshotLsn), sizeof(snapshotLsn));
+    file.read(reinterpret_cast<char*>(&gameCount), sizeof(int));
+    if (!file || magic != GAMES_SNAPSHOT_MAGIC || gameCount < 0 || gameCount > MAX_GAMES) {
+        std::cerr << "Warning: Corrupt games file. Starting without saved games." << std::endl;
+        return 0;
+    }
+
+    // Снимок читается прямо в куски таблицы в общей памяти
+    int chunks = (gameCount + GAME_CHUNK - 1) / GAME_CHUNK;
+    int loaded = 0;
+    bool corrupt = false;
+    std::lock_guard<std::mutex> lock(g_arenaMutex);
+    for (; loaded < chunks; loaded++) {
+        int rules = -1;
+        file.read(reinterpret_cast<char*>(&rules), sizeof(rules));
+        if (!file || !isValidRules(rules)) {
+            corrupt = true;
+            break;
+        }
+        if (!addGameChunk(sharedMem, loaded, rules)) {
+            std::cerr << "Warning: Cannot grow shared memory for saved games. Starting without them." << std::endl;
+            break;
+        }
+        if (!file.read(gameChunk(sharedMem, loaded), gameChunkBytes(rules))) {
+            corrupt = true;
+            loaded++;
+            break;
+        }
+    }
+    if (corrupt || loaded < chunks) {
+        if (corrupt) {
+            std::cerr << "Warning: Corrupt games file. Starting without saved games." << std::endl;
+        }
+        // Прочитанные куски остаются в сегменте (куски заводятся по порядку), но пустыми
+        for (int k = 0; k < loaded; k++) {
+            initGameChunk(gameChunk(sharedMem, k), sharedMem->chunkRules[k]);
+        }
+        return 0;
+    }
+    for (int i = 0; i < gameCount; i++) {
+        gameAt(sharedMem, i).version.store(0, std::memory_order_relaxed);
+    }
+    sharedMem->gameCount.store(gameCount, std::memory_order_release);
+    return snapshotLsn;
+}
+
+// Повтор одной записи журнала ходов поверх таблицы игр
+// Куски, заведенные после снимка, появляются здесь по первой записи об игре
+// в них, с вариантом этой игры. Шарды пишут журнал в своем порядке, так что
+// кусок может прийти раньше меньших: пропуски заполняет recoverGames
+void replayGameRecord(SharedMemory* sharedMem, const GameJournalRecord& record) {
+    if (record.slot < 0 || record.slot >= MAX_GAMES) {
+        return;
+    }
+    int k = record.slot / GAME_CHUNK;
+    if (sharedMem->gameChunks[k].load(std::memory_order_relaxed) == 0) {
+        std::lock_guard<std::mutex> lock(g_arenaMutex);
+        if (record.type != GAME_CREATED || !isValidRules(record.rules) ||
+            !addGameChunk(sharedMem, k, record.rules)) {
+            return;
+        }
+    }
+    Game& game = gameAt(sharedMem, record.slot);
+
+    if (record.type == GAME_CREATED) {
+        if (record.rules != game.rules) {
+            return; // все игры куска одного варианта - запись не отсюда
+        }
+        char name[64];
+        char player1[64];
+        memcpy(name, record.name, sizeof(name));
+        memcpy(player1, record.player1, sizeof(player1));
+        name[sizeof(name) - 1] = '\0';
+        player1[sizeof(player1) - 1] = '\0';
+
+        resetGame(game, name, findPlayer(player1));
+        game.generation = record.generation;
+        if (record.slot >= sharedMem->gameCount.load(std::memory_order_relaxed)) {
+            sharedMem->gameCount.store(record.slot + 1, std::memory_order_release);
+        }
+        return;
+    }
+
+    // Запись о другой (уже освобожденной) игре в этом слоте
+    if (!game.active || game.generation != record.generation) {
+        return;
+    }
+
+    bool isPlayer1 = (record.player == 1);
+
+    switch (record.type) {
+        case GAME_JOINED:
+            {
+                char player2[64];
+                memcpy(player2, record.name, sizeof(player2));
+                player2[sizeof(player2) - 1] = '\0';
+                game.player2 = findPlayer(player2);
+                game.state = PLACING_SHIPS;
+            }
+            break;
+        case GAME_SHIP_PLACED:
+            withRules(game.rules, [&](auto variant) {
+                GameBoard<decltype(variant)>& typed = game.board<decltype(variant)>(isPlayer1);
+                if (canPlaceShipOfLength(typed, record.length)) {
+                    placeShip(typed, record.x, record.y, record.length, record.horizontal != 0);
+                }
+            });
+            break;
+        case GAME_FLEET_PLACED:
+            {
+                bool placed = withRules(game.rules, [&](auto variant) {
+                    return placeFleet(game.board<decltype(variant)>(isPlayer1), record.fleet, record.fleetSize);
+                });
+                if (placed && record.markReady) {
+                    startGameIfReady(game, isPlayer1);
+                }
+            }
+            break;
+        case GAME_SHIPS_READY:
+            startGameIfReady(game, isPlayer1);
+            break;
+        case GAME_MOVE:
+            applyMove(game, isPlayer1, record.x, record.y);
+            break;
+        case GAME_RELEASED:
+            game.active = false;
+            break;
+    }
+}
+
+// Сворачиваем журнал ходов в новый снимок таблицы игр
+void compactGames(SharedMemory* sharedMem) {
+    g_gamesJournal.flush(true);
+    saveGames(sharedMem);
+    g_gamesJournal.truncate();
+}
+
+// Восстановление игр после перезапуска: снимок + журнал ходов с записями новее снимка
+void recoverGames(SharedMemory* sharedMem) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint64_t snapshotLsn = loadGames(sharedMem);
+    uint64_t lastLsn = snapshotLsn;
+
+    int replayed = 0;
+    std::ifstream file(GAMES_JOURNAL_FILE, std::ios::binary);
+    GameJournalRecord record;
+    while (file && file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        if (record.checksum != journalChecksum(&record, offsetof(GameJournalRecord, checksum))) {
+            std::cerr << "Warning: Torn record at the end of games journal, ignoring the rest." << std::endl;
+            break;
+        }
+        if (record.lsn <= snapshotLsn) {
+            continue; // уже в снимке
+        }
+        replayGameRecord(sharedMem, record);
+        lastLsn = record.lsn;
+        replayed++;
+    }
+    file.close();
+
+    // Куски ниже gameCount, о которых журнал не дописан, заводим пустыми:
+    // читатели рассчитывают, что все куски до gameCount есть
+    int gameCount = sharedMem->gameCount.load(std::memory_order_relaxed);
+    for (int k = 0; k * GAME_CHUNK < gameCount; k++) {
+        std::lock_guard<std::mutex> lock(g_arenaMutex);
+        if (sharedMem->gameChunks[k].load(std::memory_order_relaxed) == 0 &&
+            !addGameChunk(sharedMem, k, RULES_CLASSIC)) {
+            gameCount = k * GAME_CHUNK;
+            sharedMem->gameCount.store(gameCount, std::memory_order_release);
+        }
+    }
+
+    // Индексы имен и очереди свободных слотов шардов строим по восстановленной таблице
+    for (int k = 0; k < SERVER_SHARDS; k++) {
+        int first = k;
+        while (first < gameCount) {
+            first += SERVER_SHARDS;
+        }
+        for (int rules = 0; rules < RULES_COUNT; rules++) {
+            g_shards[k].freeGames[rules].clear();
+            g_shards[k].nextSlot[rules] = first;
+        }
+    }
+    for (int i = 0; i < g_players.size(); i++) {
+        setPlayerGame(i, INVALID_GAME_HANDLE);
+    }
+
+    int liveGames = 0;
+    for (int i = 0; i < gameCount; i++) {
+        Game& game = gameAt(sharedMem, i);
+        Shard& shard = g_shards[i % SERVER_SHARDS];
+        if (!game.active) {
+            shard.freeGames[game.rules].push_back(i);
+            continue;
+        }
+        if (shardOfName(game.name) != shard.id) {
+            // Снимок сделан при другом SERVER_SHARDS: по имени игру не найти, только по номеру
+            std::cerr << "Warning: Game '" << game.name << "' is in a slot of another shard." << std::endl;
+        }
+        shard.gameIndex.insert(hashName(game.name), i);
+        if (game.state == GAME_OVER) {
+            continue;
+        }
+        liveGames++;
+
+        // Игрокам незаконченных игр возвращаем текущую игру, чтобы они могли в нее вернуться
+        setPlayerGame(game.player1, makeGameHandle(i, game.generation));
+        setPlayerGame(game.player2, makeGameHandle(i, game.generation));
+    }
+
+    if (!g_gamesJournal.open(GAMES_JOURNAL_FILE)) {
+        std::cerr << "Error: Cannot open games journal: " << strerror(errno) << std::endl;
+    }
+    g_gamesJournal.setLastLsn(lastLsn);
+    if (replayed > 0) {
+        compactGames(sharedMem);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsedUs = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    std::cout << "Recovered " << liveGames << " games in progress (" << replayed
+              << " journal records) in " << elapsedUs / 1000.0 << " ms." << std::endl;
+}
+
+// Журнал перестал или снова начал писаться; в лог - только смена состояния
+void setJournalFailed(bool failed) {
+    if (g_journalFailed.exchange(failed, std::memory_order_acq_rel) == failed) {
+        return;
+    }
+    if (failed) {
+        g_log.error("Cannot write journal: %s. Rejecting changes until it is writable.", strerror(errno));
+    } else {
+        g_log.info("Journal is writable again, accepting changes.");
+    }
+}
+
+// Групповая фиксация: шард вызывает ее после своей пачки запросов, до отправки ответов.
+// write() - на каждую пачку, fdatasync - раз в JOURNAL_SYNC_RECORDS записей
+// или JOURNAL_SYNC_INTERVAL_MS миллисекунд. Пока один шард пишет, остальные ждут
+// и затем находят свои записи уже сброшенными.
+// false - записи не сохранены: они остаются в буфере журнала, и следующая фиксация
+// (шарда или диспетчера по таймауту) пробует снова
+bool commitJournals() {
+    std::lock_guard<std::mutex> lock(g_commitMutex);
+    size_t unsynced = g_statsJournal.unsyncedRecordCount() + g_gamesJournal.unsyncedRecordCount();
+    if (unsynced == 0) {
+        setJournalFailed(false); // все уже на диске (например, свернуто в снимок)
+        return true;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsedMs = (now.tv_sec - g_journalLastSync.tv_sec) * 1000 +
+                     (now.tv_nsec - g_journalLastSync.tv_nsec) / 1000000;
+    bool sync = unsynced >= JOURNAL_SYNC_RECORDS || elapsedMs >= JOURNAL_SYNC_INTERVAL_MS;
+
+    bool ok = g_statsJournal.flush(sync);
+    ok = g_gamesJournal.flush(sync) && ok;
+    if (!ok) {
+        setJournalFailed(true);
+        return false;
+    }
+    setJournalFailed(false);
+    if (sync) {
+        g_journalLastSync = now;
+    }
+
+    // Снимок требует остановки шардов - его сделает диспетчер
+    if (g_statsJournal.recordCount() >= STATS_COMPACT_RECORDS ||
+        g_gamesJournal.recordCount() >= GAMES_COMPACT_RECORDS) {
+        g_compactRequested.store(true, std::memory_order_release);
+    }
+    return true;
+}
+
+// Диспетчер: ждем, пока шарды ответят на все отданные им запросы
+void waitForShardsIdle() {
+    g_barrierWaiting.store(1, std::memory_order_seq_cst);
+    uint32_t inFlight;
+    while ((inFlight = g_inFlight.load(std::memory_order_seq_cst)) != 0) {
+        futexWait(&g_inFlight, inFlight);
+    }
+    g_barrierWaiting.store(0, std::memory_order_relaxed);
+}
+
+// Диспетчер: сворачиваем журналы в снимки, пока шарды стоят
+void compactJournals() {
+    waitForShardsIdle();
+    compactStats();
+    compactGames(g_sharedMem);
+    g_compactRequested.store(false, std::memory_order_relaxed);
+}
+
+// Обработчик сигнала для корректного завершения.
+// SIGINT только поднимает флаг и будит диспетчера: снимки, ожидание шардов и
+// выход - в его цикле между пачками (здесь он мог прерваться посреди пачки
+// или внутри commitJournals с захваченными мьютексами журналов)
+void signalHandler(int sig) {
+    if (sig == SIGINT) {
+        int savedErrno = errno;
+        g_shutdownRequested.store(true, std::memory_order_release);
+        if (g_sharedMem) {
+            g_sharedMem->ring.interrupt();
+        }
+        errno = savedErrno;
+        return;
+    }
+
+    // Подробность журнала на ходу: SIGUSR1 - подробнее, SIGUSR2 - короче
+    if (sig == SIGUSR1 || sig == SIGUSR2) {
+        int level = g_log.getLevel() + (sig == SIGUSR1 ? -1 : 1);
+        if (level >= LOG_DEBUG && level <= LOG_ERROR) {
+            g_log.setLevel(level);
+        }
+        g_log.write(LOG_ERROR, "Log level: %s", logLevelName(g_log.getLevel())); // видно при любом уровне
+    }
+}
+
+// Расчет процента побед
+float calculateWinRate(int wins, int losses) {
+    int total = wins + losses;
+    if (total == 0) {
+        return 0.0f;
+    }
+    return (float)wins * 100.0f / (float)total;
+}
+
+// Функция для красивого вывода
+void centerText(char* buffer, size_t size, const char* text, size_t width) {
+    size_t textLen = strlen(text);
+    if (textLen >= width) {
+        // If text is longer than width, just copy it
+        snprintf(buffer, size, "%s", text);
+    } else {
+        // Calculate padding
+        size_t padding = (width - textLen) / 2;
+        snprintf(buffer, size, "%*s%s%*s", (int)padding, "", text, (int)(width - textLen - padding), "");
+    }
+}
+
+// Игрок расставил все корабли: начинаем игру, если готов и соперник
+void markShipsReady(Message& msg, Game& game, bool isPlayer1) {
+    // Проверяем, готовы ли оба игрока
+    beginGameWrite(game);
+    bool started = startGameIfReady(game, isPlayer1);
+    endGameWrite(game);
+    if (started) {
+        // Оба игрока готовы, начинаем игру
+        TextBuffer text(msg.data);
+        text.append("Both players are ready! Game starts now.");
+        msg.gameState = PLAYER1_TURN;
+
+        // Указываем, чей сейчас ход
+        if (isPlayer1) {
+            text.append(" It's your turn!");
+            strcpy(msg.opponent, playerName(game.player2));
+        } else {
+            text.append(" Waiting for opponent's move.");
+            strcpy(msg.opponent, playerName(game.player1));
+        }
+    } else {
+        // Ждем второго игрока
+        strcpy(msg.data, "\nYour ships are ready! Waiting for your opponent...");
+        msg.gameState = PLACING_SHIPS;
+
+        // Указываем оппонента
+        if (isPlayer1) {
+            strcpy(msg.opponent, playerName(game.player2));
+        } else {
+            strcpy(msg.opponent, playerName(game.player1));
+        }
+    }
+}
+
+// Доски участника в ответе: клиент без общей памяти видит игру только так
+template <class Rules>
+void fillBoardCells(Message& msg, const GameBoard<Rules>& own, const GameBoard<Rules>& enemy) {
+    own.toCells(msg.ownCells);
+    for (int y = 0; y < Rules::SIZE; y++) {
+        for (int x = 0; x < Rules::SIZE; x++) {
+            CellState cell = enemy.cellAt(x, y);
+            msg.enemyCells[y][x] = cell == SHIP ? EMPTY : cell;
+        }
+    }
+}
+
+void fillBoardView(Message& msg, const Game& game, bool isPlayer1) {
+    msg.player = isPlayer1 ? 1 : 2;
+    msg.rules = game.rules;
+    withRules(game.rules, [&](auto variant) {
+        typedef decltype(variant) Rules;
+        fillBoardCells(msg, game.board<Rules>(isPlayer1), game.board<Rules>(!isPlayer1));
+    });
+}
+
+// Сколько кораблей игрок уже поставил
+int shipsPlacedOf(const Game& game, bool isPlayer1) {
+    return withRules(game.rules, [&](auto variant) {
+        return (int)game.board<decltype(variant)>(isPlayer1).shipsPlaced;
+    });
+}
+
+// Проигравший узнал о конце игры (победитель узнал из MOVE_RESULT) - слот больше не нужен
+void releaseIfLoserInformed(Shard& shard, int gameIdx, bool isPlayer1) {
+    const Game& game = gameAt(g_sharedMem, gameIdx);
+    if (game.state == GAME_OVER && game.winner != (isPlayer1 ? 1 : 2)) {
+        releaseGame(shard, g_sharedMem, gameIdx);
+    }
+}
+
+// Обработчики запросов: каждый разбирает одно сообщение клиента в его шарде
+// и пишет ответ в то же сообщение. Строки берутся из полей сообщения без копирования
+
+void handleLogin(Shard& shard, Message& msg) {
+    std::string_view username = fieldView(msg.username);
+    g_log.info("Login request from: %s", username);
+
+    if (username == BOT_NAME) {
+        msg.type = Message::ERROR;
+        strcpy(msg.data, "This name is reserved!");
+        return;
+    }
+
+    bool isNewUser = false;
+    int playerIdx = g_players.findOrAdd(msg.username, isNewUser);
+    if (playerIdx == -1) {
+        msg.type = Message::ERROR;
+        strcpy(msg.data, "Player table is full!");
+        return;
+    }
+
+    // Игрок уже в сети, только если его прежний канал жив: закрытое соединение или
+    // упавший клиент не держат имя, и вход забирает сессию себе
+    bool isAlreadyActive;
+    int wins, losses;
+    GameHandle currentGame;
+    {
+        std::lock_guard<std::mutex> lock(g_players.lockOf(playerIdx));
+        PlayerStats& player = g_players.at(playerIdx);
+        SessionId& session = g_players.sessionOf(playerIdx);
+        isAlreadyActive = (!isNewUser && player.active && session != msg.session && sessionAlive(session));
+        if (!isAlreadyActive) {
+            player.active = true;
+            player.inGame = false; // Reset game status on login
+            session = msg.session;
+        }
+        wins = player.wins;
+        losses = player.losses;
+        currentGame = player.currentGame;
+    }
+
+    if (isNewUser) {
+        journalStats(STATS_NEW_PLAYER, playerIdx);
+        g_log.info("New player registered: %s", username);
+    } else {
+        g_log.info("Returning player: %s (W:%d/L:%d)", username, wins, losses);
+    }
+
+    // Form response
+    msg.type = Message::LOGIN_RESPONSE;
+    msg.newUser = isNewUser;
+    msg.playerId = isAlreadyActive ? NO_PLAYER : playerIdx; // чужую сессию не отдаем
+
+    if (isNewUser) {
+        strcpy(msg.data, "Registration successful!");
+    } else if (isAlreadyActive) {
+        strcpy(msg.data, "Already online");
+    } else {
+        TextBuffer(msg.data).format("Welcome back, %s! Your stats: %d wins, %d losses",
+                                    playerName(playerIdx), wins, losses);
+    }
+
+    // Незаконченная игра (например, прерванная перезапуском сервера) - клиент может в нее вернуться.
+    // Диспетчер отправил вход в шард этой игры, поэтому она ищется в своем шарде
+    msg.gameHandle = INVALID_GAME_HANDLE;
+    int gameIdx = -1;
+    if (currentGame != INVALID_GAME_HANDLE) {
+        gameIdx = findGameByHandle(shard, g_sharedMem, currentGame);
+    }
+    if (!isAlreadyActive && gameIdx != -1 && gameAt(g_sharedMem, gameIdx).state != GAME_OVER) {
+        const Game& game = gameAt(g_sharedMem, gameIdx);
+        int participant = participantOf(game, playerIdx);
+        bool isPlayer1 = (participant == 1);
+
+        if (participant != 0) {
+            setPlayerGame(playerIdx, currentGame);
+            strcpy(msg.gameName, game.name);
+            msg.gameHandle = currentGame;
+            msg.gameState = game.state;
+            msg.rules = game.rules;
+            strcpy(msg.opponent, playerName(isPlayer1 ? game.player2 : game.player1));
+            msg.shipLength = shipsPlacedOf(game, isPlayer1);
+        }
     }
-
-    return true;
 }
 
+void handleCreateGame(Shard& shard, Message& msg) {
+    // Имя игры обрезается до размера поля, как при создании
+    char gameName[sizeof(msg.gameName)];
+    snprintf(gameName, sizeof(gameName), "%.*s", (int)sizeof(gameName) - 1, msg.data);
+    PlayerId player = requestPlayer(msg);
+    int rules = isValidRules(msg.rules) ? msg.rules : (int)RULES_CLASSIC;
 
-// Размещение корабля на поле
-bool placeShip(GameBoard& board, int x, int y, int length, bool horizontal) {
-    // Проверка выхода за границы поля
-    if (x < 0 || y < 0 || x >= BOARD_SIZE || y >= BOARD_SIZE) {
-        return false;
-    }
+    g_log.info("Create game request: %s (%s) from %s", gameName, g_rulesInfo[rules].name, playerName(player));
+
+    int gameIdx = player == NO_PLAYER ? -3 : createGame(shard, g_sharedMem, gameName, player, rules);
+    msg.type = Message::CREATE_GAME_RESPONSE;
+    msg.rules = rules;
 
-    if (horizontal) {
-        if (x + length > BOARD_SIZE) return false;
+    // Игра не создана - номера игры в ответе нет (как в PLAY_VS_BOT)
+    if (gameIdx < 0) {
+        msg.gameState = GAME_OVER;
+        msg.gameHandle = INVALID_GAME_HANDLE;
+    }
+    if (gameIdx == -3) {
+        strcpy(msg.data, "Log in before creating a game!");
+    } else if (gameIdx == -1) {
+        strcpy(msg.data, "Maximum number of games reached!");
+    } else if (gameIdx == -2) {
+        strcpy(msg.data, "Game with this name already exists!");
     } else {
-        if (y + length > BOARD_SIZE) return false;
+        TextBuffer(msg.data).format("Game '%s' created successfully! Waiting for opponent...", gameName);
+        msg.gameState = WAITING_FOR_PLAYER;
+        strcpy(msg.gameName, gameName);
+        msg.gameHandle = makeGameHandle(gameIdx, gameAt(g_sharedMem, gameIdx).generation);
     }
+}
 
-    // Проверка пересечения с другими кораблями (включая соседние клетки)
-    for (int i = -1; i <= length; i++) {
-        for (int j = -1; j <= 1; j++) {
-            int checkX = horizontal ? x + i : x + j;
-            int checkY = horizontal ? y + j : y + i;
-
-            if (checkX >= 0 && checkX < BOARD_SIZE && checkY >= 0 && checkY < BOARD_SIZE) {
-                if (board.cells[checkY][checkX] == SHIP) {
-                    return false;
+void handleListGames(Shard&, Message& msg) {
+    PlayerId player = requestPlayer(msg);
+    g_log.debug("List games request from %s", playerName(player));
+
+    // Создаем список доступных игр
+    msg.type = Message::GAMES_LIST;
+
+    TextBuffer gamesList(msg.data);
+    gamesList.append("Available games:\n");
+    bool foundGames = false;
+
+    // Игры других шардов меняют их потоки - читаем их снимками seqlock, как клиенты
+    int gameCount = g_sharedMem->gameCount.load(std::memory_order_acquire);
+    for (int i = 0; i < gameCount && !gamesList.full(); i++) {
+        GameView view;
+        uint32_t version = GAME_VIEW_NONE;
+        readGameView(gameAt(g_sharedMem, i), view, version);
+        if (view.active) {
+            // Игры в статусе ожидания
+            if (view.state == WAITING_FOR_PLAYER &&
+                view.player1 != player) {
+                gamesList.append("- ").append(view.name).append(" (created by ")
+                         .append(playerName(view.player1)).append(", ")
+                         .append(rulesInfo(view.rules).name).append(")\n");
+                foundGames = true;
                 }
-            }
         }
     }
 
-    // Размещаем корабль на поле
-    if (board.shipsPlaced >= TOTAL_SHIPS) {
-        return false; // все корабли уже размещены
+    if (!foundGames) {
+        gamesList.append("No games available. Create your own game!\n");
     }
+}
+
+void handleJoinGame(Shard& shard, Message& msg) {
+    std::string_view gameName = fieldView(msg.gameName);
+    PlayerId player = requestPlayer(msg);
 
-    board.ships[board.shipsPlaced].x = x;
-    board.ships[board.shipsPlaced].y = y;
-    board.ships[board.shipsPlaced].length = length;
-    board.ships[board.shipsPlaced].horizontal = horizontal;
-    board.ships[board.shipsPlaced].hits = 0;
+    g_log.info("Join game request: %s from %s", gameName, playerName(player));
 
-    // Отмечаем клетки на поле
-    for (int i = 0; i < length; i++) {
-        if (horizontal) {
-            board.cells[y][x + i] = SHIP;
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    bool joined = joinGame(g_sharedMem, gameIdx, player);
+    msg.type = Message::JOIN_GAME_RESPONSE;
+
+    if (!joined) {
+        strcpy(msg.data,
+               "Could not join game. It may not exist, already started, or you created it.");
+        msg.gameState = GAME_OVER; // Для индикации клиенту об ошибке
+    } else {
+        TextBuffer(msg.data).format("Successfully joined game '%s'! Place your ships.",
+                                    gameAt(g_sharedMem, gameIdx).name);
+
+        // Возвращаем состояние игры, ее вариант и номер для следующих запросов
+        msg.gameState = gameAt(g_sharedMem, gameIdx).state;
+        msg.rules = gameAt(g_sharedMem, gameIdx).rules;
+        strcpy(msg.gameName, gameAt(g_sharedMem, gameIdx).name);
+        msg.gameHandle = makeGameHandle(gameIdx, gameAt(g_sharedMem, gameIdx).generation);
+
+        // Ставим нужного оппонент
+        if (gameAt(g_sharedMem, gameIdx).player1 == player) {
+            // Player 1 is joining, so opponent is player 2
+            strcpy(msg.opponent, playerName(gameAt(g_sharedMem, gameIdx).player2));
         } else {
-            board.cells[y + i][x] = SHIP;
+            // Player 2 is joining, so opponent is player 1
+            strcpy(msg.opponent, playerName(gameAt(g_sharedMem, gameIdx).player1));
         }
     }
-
-    board.shipsPlaced++;
-    return true;
 }
 
-// Проверка, что все корабли размещены
-bool areAllShipsPlaced(const GameBoard& board) {
-    int expected[5] = {0, SUBMARINE_COUNT, DESTROYER_COUNT, CRUISER_COUNT, BATTLESHIP_COUNT};
-    int actual[5] = {0}; // Индекс - длина корабля
+void handleGameStatus(Shard& shard, Message& msg) {
+    PlayerId player = requestPlayer(msg);
 
-    for (int i = 0; i < board.shipsPlaced; i++) {
-        if (board.ships[i].length >= 1 && board.ships[i].length <= 4) {
-            actual[board.ships[i].length]++;
-        }
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    msg.type = Message::GAME_STATUS;
+
+    if (gameIdx == -1) {
+        strcpy(msg.data, "Game not found!");
+        msg.gameState = GAME_OVER;
+        return;
     }
 
-    for (int i = 1; i <= 4; i++) {
-        if (actual[i] != expected[i]) {
-            return false;
-        }
+    // Возвращаем текущее состояние игры
+    msg.gameState = gameAt(g_sharedMem, gameIdx).state;
+
+    // Чей ход
+    int participant = participantOf(gameAt(g_sharedMem, gameIdx), player);
+    bool isPlayer1 = (participant == 1);
+    bool isPlayer2 = (participant == 2);
+
+    if (!isPlayer1 && !isPlayer2) {
+        strcpy(msg.data, "You are not a participant in this game!");
+        return;
+    }
+    fillBoardView(msg, gameAt(g_sharedMem, gameIdx), isPlayer1);
+
+    // Последний ход игры и номер, с которого клиент может просить ходы дельтой
+    const Game& game = gameAt(g_sharedMem, gameIdx);
+    msg.eventSeq = game.eventSeq;
+    if (game.eventSeq > 0) {
+        const MoveEvent& last = game.events[(game.eventSeq - 1) % GAME_EVENT_RING];
+        msg.x = last.x;
+        msg.y = last.y;
+        msg.hitResult = last.result;
+    } else {
+        msg.x = -1;
+        msg.y = -1;
+        msg.hitResult = -1;
     }
 
-    return true;
+    if ((game.state == PLAYER1_TURN && isPlayer2) ||
+        (game.state == PLAYER2_TURN && isPlayer1)) {
+        strcpy(msg.data, "Waiting for opponent's move");
+        } else {
+            TextBuffer(msg.data).format("It's your turn in game %s", game.name);
+        }
+
+    releaseIfLoserInformed(shard, gameIdx, isPlayer1);
 }
 
+void handleGameEvents(Shard& shard, Message& msg) {
+    PlayerId player = requestPlayer(msg);
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    msg.type = Message::GAME_EVENTS_RESPONSE;
 
-// Обработка хода игрока
-int processMove(GameBoard& opponentBoard, int x, int y) {
-    if (x < 0 || y < 0 || x >= BOARD_SIZE || y >= BOARD_SIZE) {
-        return -1; // недопустимые координаты
+    if (gameIdx == -1) {
+        strcpy(msg.data, "Game not found!");
+        msg.gameState = GAME_OVER;
+        return;
     }
 
-    // Уже стреляли в эту клетку
-    if (opponentBoard.cells[y][x] == MISS || opponentBoard.cells[y][x] == HIT ||
-        opponentBoard.cells[y][x] == DESTROYED) {
-        return -2;
+    const Game& game = gameAt(g_sharedMem, gameIdx);
+    int participant = participantOf(game, player);
+    bool isPlayer1 = (participant == 1);
+    bool isPlayer2 = (participant == 2);
+    if (!isPlayer1 && !isPlayer2) {
+        strcpy(msg.data, "You are not a participant in this game!");
+        return;
     }
 
-    // Промах
-    if (opponentBoard.cells[y][x] == EMPTY) {
-        opponentBoard.cells[y][x] = MISS;
-        return 0;
+    // Отдаем только ходы после известного клиенту
+    msg.gameState = game.state;
+    fillGameEvents(msg, msg.eventSeq, game.eventSeq, game.events);
+
+    releaseIfLoserInformed(shard, gameIdx, isPlayer1);
+}
+
+void handlePlaceShip(Shard& shard, Message& msg) {
+    std::string_view gameName = fieldView(msg.gameName);
+    PlayerId player = requestPlayer(msg);
+    int x = msg.x;
+    int y = msg.y;
+    int length = msg.shipLength;
+    bool horizontal = msg.shipHorizontal;
+
+    g_log.debug("Place ship request from %s in game %s at (%d,%d), length %d %s",
+                playerName(player), gameName, x, y, length, horizontal ? "horizontal" : "vertical");
+
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    msg.type = Message::PLACE_SHIP_RESPONSE;
+
+    if (gameIdx == -1) {
+        strcpy(msg.data, "Game not found!");
+        return;
     }
 
-    // Попадание
-    if (opponentBoard.cells[y][x] == SHIP) {
-        opponentBoard.cells[y][x] = HIT;
+    // Определяем номер игрока
+    int participant = participantOf(gameAt(g_sharedMem, gameIdx), player);
+    bool isPlayer1 = (participant == 1);
+    bool isPlayer2 = (participant == 2);
 
-        // Проверяем, какой корабль поражен
-        for (int i = 0; i < opponentBoard.shipsPlaced; i++) {
-            Ship& ship = opponentBoard.ships[i];
-            bool hit = false;
+    if (!isPlayer1 && !isPlayer2) {
+        strcpy(msg.data, "You are not a participant in this game!");
+        return;
+    }
 
-            for (int j = 0; j < ship.length; j++) {
-                int shipX = ship.horizontal ? ship.x + j : ship.x;
-                int shipY = ship.horizontal ? ship.y : ship.y + j;
+    // Проверяем, что игра в фазе расстановки кораблей
+    if (gameAt(g_sharedMem, gameIdx).state != PLACING_SHIPS) {
+        strcpy(msg.data, "Game is not in the ship placement phase!");
+        return;
+    }
 
-                if (shipX == x && shipY == y) {
-                    ship.hits++;
-                    hit = true;
-                    break;
-                }
-            }
+    // Выбираем соответствующую доску (поле варианта игры)
+    Game& game = gameAt(g_sharedMem, gameIdx);
+    msg.rules = game.rules;
+    withRules(game.rules, [&](auto variant) {
+        GameBoard<decltype(variant)>& board = game.board<decltype(variant)>(isPlayer1);
 
-            if (hit) {
-                // Проверяем, уничтожен ли корабль
-                if (ship.isDestroyed()) {
-                    // Помечаем все клетки корабля как уничтоженные
-                    for (int j = 0; j < ship.length; j++) {
-                        int shipX = ship.horizontal ? ship.x + j : ship.x;
-                        int shipY = ship.horizontal ? ship.y : ship.y + j;
-                        opponentBoard.cells[shipY][shipX] = DESTROYED;
-                    }
+        // Проверяем, что осталось место для корабля
+        if (!canPlaceShipOfLength(board, length)) {
+            strcpy(msg.data, "You have placed all ships of this type!");
+            return;
+        }
 
-                    // Проверяем, все ли корабли уничтожены
-                    if (opponentBoard.allShipsDestroyed()) {
-                        return 3; // победа
-                    }
-                    return 2; // корабль уничтожен
-                }
-                return 1; // попадание
+        // Размещаем корабль
+        beginGameWrite(game);
+        bool placed = placeShip(board, x, y, length, horizontal);
+        endGameWrite(game);
+
+        if (!placed) {
+            strcpy(msg.data, "Cannot place ship at this position!");
+        } else {
+            TextBuffer text(msg.data);
+            text.format("Ship of length %d placed successfully!", length);
+
+            GameJournalRecord record = makeGameRecord(GAME_SHIP_PLACED, gameIdx, isPlayer1 ? 1 : 2);
+            record.x = x;
+            record.y = y;
+            record.length = length;
+            record.horizontal = horizontal;
+            journalGame(record);
+
+            // Проверяем, все ли корабли размещены
+            if (areAllShipsPlaced(board)) {
+                text.append(" All ships are now placed!");
             }
         }
-    }
 
-    // Не должны сюда добраться, но на всякий случай
-    return 0;
+        // Отправляем обновленное количество размещенных кораблей
+        msg.shipLength = board.shipsPlaced;
+    });
 }
 
-// Обработчик сигнала для корректного завершения
-void signalHandler(int sig) {
-    if (sig == SIGINT) {
-        std::cout << "\nReceived SIGINT. Saving data and cleaning up..." << std::endl;
+void handlePlaceFleet(Shard& shard, Message& msg) {
+    std::string_view gameName = fieldView(msg.gameName);
+    PlayerId player = requestPlayer(msg);
 
-        if (g_sharedMem) {
-            saveStats(); // Updated to not use sharedMem
-            munmap(g_sharedMem, MMF_SIZE);
-        }
+    g_log.info("Place fleet request from %s in game %s (%d ships%s)",
+               playerName(player), gameName, msg.fleetSize, msg.markReady ? ", ready" : "");
+
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    msg.type = Message::PLACE_FLEET_RESPONSE;
 
-        // Rest of the handler remains the same
-        if (g_semClientReady) sem_close(g_semClientReady);
-        if (g_semServerReady) sem_close(g_semServerReady);
+    if (gameIdx == -1) {
+        strcpy(msg.data, "Game not found!");
+        return;
+    }
 
-        sem_unlink(SEM_CLIENT_READY);
-        sem_unlink(SEM_SERVER_READY);
+    // Определяем номер игрока
+    int participant = participantOf(gameAt(g_sharedMem, gameIdx), player);
+    bool isPlayer1 = (participant == 1);
+    bool isPlayer2 = (participant == 2);
 
-        if (g_shm_fd != -1) close(g_shm_fd);
-        shm_unlink(MMF_NAME);
+    if (!isPlayer1 && !isPlayer2) {
+        strcpy(msg.data, "You are not a participant in this game!");
+        return;
+    }
 
-        exit(0);
+    // Проверяем, что игра в фазе расстановки кораблей
+    if (gameAt(g_sharedMem, gameIdx).state != PLACING_SHIPS) {
+        strcpy(msg.data, "Game is not in the ship placement phase!");
+        return;
     }
-}
 
-// Расчет процента побед
-float calculateWinRate(int wins, int losses) {
-    int total = wins + losses;
-    if (total == 0) {
-        return 0.0f;
+    Game& game = gameAt(g_sharedMem, gameIdx);
+    msg.rules = game.rules;
+    beginGameWrite(game);
+    bool placed = withRules(game.rules, [&](auto variant) {
+        return placeFleet(game.board<decltype(variant)>(isPlayer1), msg.fleet, msg.fleetSize);
+    });
+    endGameWrite(game);
+    msg.shipLength = shipsPlacedOf(game, isPlayer1);
+    if (!placed) {
+        strcpy(msg.data, "Invalid fleet! Ships overlap, touch or do not match the required set.");
+        msg.gameState = PLACING_SHIPS;
+        return;
     }
-    return (float)wins * 100.0f / (float)total;
-}
 
-// Функция для красивого вывода
-void centerText(char* buffer, const char* text, size_t width) {
-    size_t textLen = strlen(text);
-    if (textLen >= width) {
-        // If text is longer than width, just copy it
-        strcpy(buffer, text);
+    GameJournalRecord record = makeGameRecord(GAME_FLEET_PLACED, gameIdx, isPlayer1 ? 1 : 2);
+    memcpy(record.fleet, msg.fleet, sizeof(record.fleet));
+    record.fleetSize = msg.fleetSize;
+    record.markReady = msg.markReady;
+    journalGame(record);
+
+    if (msg.markReady) {
+        markShipsReady(msg, gameAt(g_sharedMem, gameIdx), isPlayer1);
     } else {
-        // Calculate padding
-        size_t padding = (width - textLen) / 2;
-        // Use sprintf to center the text
-        sprintf(buffer, "%*s%s%*s", (int)padding, "", text, (int)(width - textLen - padding), "");
+        strcpy(msg.data, "All ships are now placed!");
+        msg.gameState = PLACING_SHIPS;
     }
 }
 
-int main() {
-    // Инициализируем генератор случайных чисел
-    srand(static_cast<unsigned int>(time(nullptr)));
+void handleAutoPlace(Shard& shard, Message& msg) {
+    // Флот расставляет сервер по правилам игры, дальше - как PLACE_FLEET:
+    // флот уходит в журнал и в ответ (игры нет - ответит handlePlaceFleet)
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    if (gameIdx != -1) {
+        withRules(gameAt(g_sharedMem, gameIdx).rules, [&](auto variant) {
+            typedef decltype(variant) Rules;
+            autoPlaceFleet<Rules>(msg.fleet, shard.random);
+            msg.fleetSize = Rules::TOTAL_SHIPS;
+        });
+    }
+    handlePlaceFleet(shard, msg);
+    if (msg.type == Message::PLACE_FLEET_RESPONSE) {
+        msg.type = Message::AUTO_PLACE_RESPONSE;
+    }
+}
 
-    // На всякий случай чистим
-    shm_unlink(MMF_NAME);
-    sem_unlink(SEM_CLIENT_READY);
-    sem_unlink(SEM_SERVER_READY);
+void handleShipsReady(Shard& shard, Message& msg) {
+    std::string_view gameName = fieldView(msg.gameName);
+    PlayerId player = requestPlayer(msg);
 
+    g_log.info("Ships ready notification from %s in game %s", playerName(player), gameName);
 
-    // Установка обработчика сигнала
-    signal(SIGINT, signalHandler);
-    std::cout << "Sigint handler initalized" << std::endl;
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    msg.type = Message::SHIPS_READY_RESPONSE;
 
-    std::cout << "Initializing shared memory..." << std::endl;
-    // Создаем объект в разделяемой памяти
-    g_shm_fd = shm_open(MMF_NAME, O_CREAT | O_RDWR, 0666);
-    if (g_shm_fd == -1) {
-        std::cerr << "Error creating shared memory: " << strerror(errno) << std::endl;
-        return 1;
+    if (gameIdx == -1) {
+        strcpy(msg.data, "Game not found!");
+        return;
     }
 
-    // Устанавливаем размер
-    if (ftruncate(g_shm_fd, MMF_SIZE) == -1) {
-        std::cerr << "Error setting shared memory size: " << strerror(errno) << std::endl;
-        close(g_shm_fd);
-        shm_unlink(MMF_NAME);
-        return 1;
+    // Определяем номер игрока
+    int participant = participantOf(gameAt(g_sharedMem, gameIdx), player);
+    bool isPlayer1 = (participant == 1);
+    bool isPlayer2 = (participant == 2);
+
+    if (!isPlayer1 && !isPlayer2) {
+        strcpy(msg.data, "You are not a participant in this game!");
+        return;
     }
 
-    // Отображаем в память
-    g_sharedMem = (SharedMemory*)mmap(NULL, MMF_SIZE,
-                                  PROT_READ | PROT_WRITE, MAP_SHARED, g_shm_fd, 0);
-    if (g_sharedMem == MAP_FAILED) {
-        std::cerr << "Error mapping shared memory: " << strerror(errno) << std::endl;
-        close(g_shm_fd);
-        shm_unlink(MMF_NAME);
-        return 1;
+    // Проверяем, что игра в фазе расстановки кораблей
+    if (gameAt(g_sharedMem, gameIdx).state != PLACING_SHIPS) {
+        strcpy(msg.data, "Game is not in the ship placement phase!");
+        return;
     }
 
-    // Ставим все в нули
-    memset(&g_sharedMem->message, 0, sizeof(Message));
-    g_sharedMem->gameCount = 0;
+    // Проверяем, все ли корабли размещены
+    const Game& game = gameAt(g_sharedMem, gameIdx);
+    bool allPlaced = withRules(game.rules, [&](auto variant) {
+        return areAllShipsPlaced(game.board<decltype(variant)>(isPlayer1));
+    });
 
-    // Безопасно инициализируем массивы
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        memset(&g_players[i], 0, sizeof(PlayerStats));
-    }
-    for (int i = 0; i < MAX_GAMES; i++) {
-        memset(&g_sharedMem->games[i], 0, sizeof(Game));
+    if (!allPlaced) {
+        strcpy(msg.data, "You haven't placed all your ships yet!");
+        return;
     }
-    std::cout << "Shared memory initalized" << std::endl;
 
-    // Загружаем статистику и игры
-    loadStats();
-    // loadGames(g_sharedMem);
-    std::cout << "Stats downloaded" << std::endl;
+    GameJournalRecord record = makeGameRecord(GAME_SHIPS_READY, gameIdx, isPlayer1 ? 1 : 2);
+    journalGame(record);
 
-    std::cout << "Initializing semaphores..." << std::endl;
-    // Создаем семафоры для синхронизации
-    g_semClientReady = sem_open(SEM_CLIENT_READY, O_CREAT, 0666, 0);
-    if (g_semClientReady == SEM_FAILED) {
-        std::cerr << "Error creating client semaphore: " << strerror(errno) << std::endl;
-        munmap(g_sharedMem, MMF_SIZE);
-        close(g_shm_fd);
-        shm_unlink(MMF_NAME);
-        return 1;
+    markShipsReady(msg, gameAt(g_sharedMem, gameIdx), isPlayer1);
+}
+
+void handleMakeMove(Shard& shard, Message& msg) {
+    std::string_view gameName = fieldView(msg.gameName);
+    PlayerId player = requestPlayer(msg);
+    int x = msg.x;
+    int y = msg.y;
+
+    g_log.debug("Move request from %s in game %s at (%d,%d)", playerName(player), gameName, x, y);
+
+    int gameIdx = resolveGame(shard, g_sharedMem, msg);
+    msg.type = Message::MOVE_RESULT;
+    msg.hitResult = -1; // ход не сделан, пока не дошли до applyMove
+
+    if (gameIdx == -1) {
+        strcpy(msg.data, "Game not found!");
+        return;
     }
 
-    g_semServerReady = sem_open(SEM_SERVER_READY, O_CREAT, 0666, 0);
-    if (g_semServerReady == SEM_FAILED) {
-        std::cerr << "Error creating server semaphore: " << strerror(errno) << std::endl;
-        sem_close(g_semClientReady);
-        sem_unlink(SEM_CLIENT_READY);
-        munmap(g_sharedMem, MMF_SIZE);
-        close(g_shm_fd);
-        shm_unlink(MMF_NAME);
-        return 1;
+    // Определяем номер игрока
+    int participant = participantOf(gameAt(g_sharedMem, gameIdx), player);
+    bool isPlayer1 = (participant == 1);
+    bool isPlayer2 = (participant == 2);
+
+    if (!isPlayer1 && !isPlayer2) {
+        strcpy(msg.data, "You are not a participant in this game!");
+        return;
     }
-    std::cout << "Initializing semaphores complete" << std::endl;
 
-//    // Чистим все ожидающие сигналы на семафорах
-//    while (sem_trywait(g_semClientReady) == 0) {
-//        // Пустой цикл для очищения семафора
-//    }
-//
-//    while (sem_trywait(g_semServerReady) == 0) {
-//        // Пустой цикл для очищения семафора
-//    }
+    // Ходить можно только в бою и только в свою очередь: applyMove сам выставляет
+    // следующее состояние и вернул бы в бой расстановку или законченную игру
+    GameState state = gameAt(g_sharedMem, gameIdx).state;
+    if (state != PLAYER1_TURN && state != PLAYER2_TURN) {
+        strcpy(msg.data, state == GAME_OVER ? "The game is over!" : "The game has not started yet!");
+        msg.gameState = state;
+        return;
+    }
+    if ((state == PLAYER1_TURN && !isPlayer1) || (state == PLAYER2_TURN && !isPlayer2)) {
+        strcpy(msg.data, "It's not your turn!");
+        return;
+    }
 
-    std::cout << "\nSea Battle Server started. Press Ctrl+C to save and exit." << std::endl;
+    // Выполняем ход (при промахе ход переходит, при победе игра заканчивается)
+    beginGameWrite(gameAt(g_sharedMem, gameIdx));
+    int result = applyMove(gameAt(g_sharedMem, gameIdx), isPlayer1, x, y);
+    endGameWrite(gameAt(g_sharedMem, gameIdx));
 
-    // Основной цикл сервера
-    while (true) {
-        // Ожидаем сообщение от клиента
-        sem_wait(g_semClientReady);
-
-        // Обрабатываем различные типы сообщений
-        switch (g_sharedMem->message.type) {
-            case Message::LOGIN:
-                {
-                    std::string username = g_sharedMem->message.username;
-                    std::cout << "Login request from: " << username << std::endl;
-
-                    int playerIdx = findPlayer(username.c_str());
-                    bool isNewUser = (playerIdx == -1);
-                    bool isAlreadyActive = (g_players[playerIdx].active == true);
-
-                    if (isNewUser) {
-                        playerIdx = addPlayer(username.c_str());
-                        std::cout << "New player registered: " << username << std::endl;
-                    } else {
-                        g_players[playerIdx].active = true;
-                        g_players[playerIdx].inGame = false; // Reset game status on login
-
-                        std::cout << "Returning player: " << username
-                                << " (W:" << g_players[playerIdx].wins
-                                << "/L:" << g_players[playerIdx].losses << ")" << std::endl;
-                    }
+    if (result == -1) {
+        strcpy(msg.data, "Invalid coordinates!");
+        return;
+    } else if (result == -2) {
+        strcpy(msg.data, "You already fired at this position!");
+        return;
+    }
 
-                    // Form response
-                    g_sharedMem->message.type = Message::LOGIN_RESPONSE;
-                    g_sharedMem->message.newUser = isNewUser;
-
-                    if (isNewUser) {
-                        strcpy(g_sharedMem->message.data, "Registration successful!");
-                    } else if (isAlreadyActive) {
-                        strcpy(g_sharedMem->message.data, "Already online");
-                    } else {
-                        sprintf(g_sharedMem->message.data,
-                                "Welcome back, %s! Your stats: %d wins, %d losses",
-                                username.c_str(),
-                                g_players[playerIdx].wins,
-                                g_players[playerIdx].losses);
-                    }
-                }
-                break;
-
-            case Message::CREATE_GAME:
-                {
-                    std::string gameName = g_sharedMem->message.data;
-                    std::string username = g_sharedMem->message.username;
-
-                    std::cout << "Create game request: " << gameName << " from " << username << std::endl;
-
-                    int gameIdx = createGame(g_sharedMem, gameName.c_str(), username.c_str());
-                    g_sharedMem->message.type = Message::CREATE_GAME_RESPONSE;
-
-                    if (gameIdx == -1) {
-                        strcpy(g_sharedMem->message.data, "Maximum number of games reached!");
-                    } else if (gameIdx == -2) {
-                        strcpy(g_sharedMem->message.data, "Game with this name already exists!");
-                    } else {
-                        sprintf(g_sharedMem->message.data,
-                                "Game '%s' created successfully! Waiting for opponent...",
-                                gameName.c_str());
-                        g_sharedMem->message.gameState = WAITING_FOR_PLAYER;
-                        strcpy(g_sharedMem->message.gameName, gameName.c_str());
-                    }
-                }
-                break;
-
-            case Message::LIST_GAMES:
-                {
-                    std::cout << "List games request from " << g_sharedMem->message.username << std::endl;
-
-                    // Создаем список доступных игр
-                    g_sharedMem->message.type = Message::GAMES_LIST;
-
-                    std::string gamesList = "Available games:\n";
-                    bool foundGames = false;
-
-                    for (int i = 0; i < g_sharedMem->gameCount; i++) {
-                        if (g_sharedMem->games[i].active) {
-                            // Игры в статусе ожидания
-                            if (g_sharedMem->games[i].state == WAITING_FOR_PLAYER &&
-                                strcmp(g_sharedMem->games[i].player1, g_sharedMem->message.username) != 0) {
-                                gamesList += "- ";
-                                gamesList += g_sharedMem->games[i].name;
-                                gamesList += " (created by ";
-                                gamesList += g_sharedMem->games[i].player1;
-                                gamesList += ")\n";
-                                foundGames = true;
-                                }
-                        }
-                    }
+    GameJournalRecord record = makeGameRecord(GAME_MOVE, gameIdx, isPlayer1 ? 1 : 2);
+    record.x = x;
+    record.y = y;
+    journalGame(record);
+
+    // Обрабатываем результат хода
+    msg.hitResult = result;
+    msg.gameState = gameAt(g_sharedMem, gameIdx).state;
+    msg.eventSeq = gameAt(g_sharedMem, gameIdx).eventSeq;
+
+        if (result == 0) {
+            centerText(msg.data, sizeof(msg.data), "❌ Miss! ❌", 54);
+        } else if (result == 1) {
+            centerText(msg.data, sizeof(msg.data), "💥 Hit! 💥", 54);
+            // Игрок продолжает ход после попадания
+        } else if (result == 2) {
+            centerText(msg.data, sizeof(msg.data), "🔥 Ship destroyed! 🔥", 54);
+            // Игрок продолжает ход после уничтожения корабля
+        } else if (result == 3) {
+            // Победа - все корабли уничтожены
+            centerText(msg.data, sizeof(msg.data), "🌟 Victory! All enemy ships destroyed! 🌟", 30);
+
+        // Обновляем статистику игроков
+        PlayerId winnerIdx = player;
+        PlayerId loserIdx = isPlayer1 ? gameAt(g_sharedMem, gameIdx).player2 : gameAt(g_sharedMem, gameIdx).player1;
+
+        if (winnerIdx != -1) {
+            {
+                std::lock_guard<std::mutex> lock(g_players.lockOf(winnerIdx));
+                g_players.at(winnerIdx).wins++;
+            }
+            journalStats(STATS_WIN, winnerIdx);
+            setPlayerGame(winnerIdx, INVALID_GAME_HANDLE);
+        }
 
-                    if (!foundGames) {
-                        gamesList += "No games available. Create your own game!\n";
-                    }
+        if (loserIdx != -1) {
+            {
+                std::lock_guard<std::mutex> lock(g_players.lockOf(loserIdx));
+                g_players.at(loserIdx).losses++;
+            }
+            journalStats(STATS_LOSS, loserIdx);
+            setPlayerGame(loserIdx, INVALID_GAME_HANDLE);
+        }
+    }
 
-                    strncpy(g_sharedMem->message.data, gamesList.c_str(), sizeof(g_sharedMem->message.data) - 1);
-                    g_sharedMem->message.data[sizeof(g_sharedMem->message.data) - 1] = '\0';
-                }
-                break;
-
-            case Message::JOIN_GAME:
-                {
-                    std::string gameName = g_sharedMem->message.gameName;
-                    std::string username = g_sharedMem->message.username;
-
-                    std::cout << "Join game request: " << gameName << " from " << username << std::endl;
-
-                    bool joined = joinGame(g_sharedMem, gameName.c_str(), username.c_str());
-                    g_sharedMem->message.type = Message::JOIN_GAME_RESPONSE;
-
-                    if (!joined) {
-                        strcpy(g_sharedMem->message.data,
-                               "Could not join game. It may not exist, already started, or you created it.");
-                        g_sharedMem->message.gameState = GAME_OVER; // Для индикации клиенту об ошибке
-                    } else {
-                        sprintf(g_sharedMem->message.data,
-                                "Successfully joined game '%s'! Place your ships.",
-                                gameName.c_str());
-
-                        // Находим игру для получения информации о состоянии
-                        int gameIdx = findGame(g_sharedMem, gameName.c_str());
-                        if (gameIdx != -1) {
-                            g_sharedMem->message.gameState = g_sharedMem->games[gameIdx].state;
-                            strcpy(g_sharedMem->message.gameName, gameName.c_str());
-
-                            // Ставим нужного оппонент
-                            if (strcmp(g_sharedMem->games[gameIdx].player1, username.c_str()) == 0) {
-                                // Player 1 is joining, so opponent is player 2
-                                strcpy(g_sharedMem->message.opponent, g_sharedMem->games[gameIdx].player2);
-                            } else {
-                                // Player 2 is joining, so opponent is player 1
-                                strcpy(g_sharedMem->message.opponent, g_sharedMem->games[gameIdx].player1);
-                            }
-                        }
-                    }
-                }
-            break;
+    // Игра с ботом: ход перешел к боту - отдаем игру ему; бот проиграл - слот
+    // можно освободить сразу, спрашивать о конце игры он не будет
+    const Game& game = gameAt(g_sharedMem, gameIdx);
+    if (isPlayer1 && game.player2 != NO_PLAYER && game.player2 == g_bot.id()) {
+        if (game.state == PLAYER2_TURN) {
+            g_bot.takeTurn(gameIdx);
+        } else if (game.state == GAME_OVER) {
+            releaseGame(shard, g_sharedMem, gameIdx);
+        }
+    }
+}
 
-            case Message::GAME_STATUS:
-                {
-                    std::string gameName = g_sharedMem->message.gameName;
-                    std::string username = g_sharedMem->message.username;
+void handlePlayVsBot(Shard& shard, Message& msg) {
+    // Имя игры обрезается до размера поля, как при создании
+    char gameName[sizeof(msg.gameName)];
+    snprintf(gameName, sizeof(gameName), "%.*s", (int)sizeof(gameName) - 1, msg.data);
+    PlayerId player = requestPlayer(msg);
 
-                    // std::cout << "Game status request from " << username << " for game " << gameName << std::endl;
+    int rules = isValidRules(msg.rules) ? msg.rules : (int)RULES_CLASSIC;
 
-                    int gameIdx = findGame(g_sharedMem, gameName.c_str());
-                    g_sharedMem->message.type = Message::GAME_STATUS;
+    g_log.info("Play vs bot request: %s (%s) from %s", gameName, g_rulesInfo[rules].name, playerName(player));
 
-                    if (gameIdx == -1) {
-                        strcpy(g_sharedMem->message.data, "Game not found!");
-                        g_sharedMem->message.gameState = GAME_OVER;
-                        break;
-                    }
+    msg.type = Message::PLAY_VS_BOT_RESPONSE;
+    if (g_bot.id() == NO_PLAYER) {
+        strcpy(msg.data, "The bot is not available!");
+        msg.gameState = GAME_OVER;
+        return;
+    }
+    int gameIdx = player == NO_PLAYER ? -3 : createGame(shard, g_sharedMem, gameName, player, rules);
+    msg.rules = rules;
 
-                    // Возвращаем текущее состояние игры
-                    g_sharedMem->message.gameState = g_sharedMem->games[gameIdx].state;
+    if (gameIdx == -3) {
+        strcpy(msg.data, "Log in before creating a game!");
+        msg.gameState = GAME_OVER;
+        return;
+    } else if (gameIdx == -1) {
+        strcpy(msg.data, "Maximum number of games reached!");
+        msg.gameState = GAME_OVER;
+        return;
+    } else if (gameIdx == -2) {
+        strcpy(msg.data, "Game with this name already exists!");
+        msg.gameState = GAME_OVER;
+        return;
+    }
 
-                    // Чей ход
-                    bool isPlayer1 = (strcmp(g_sharedMem->games[gameIdx].player1, username.c_str()) == 0);
-                    bool isPlayer2 = (strcmp(g_sharedMem->games[gameIdx].player2, username.c_str()) == 0);
+    // Бот садится вторым игроком и сразу расставляет флот (как PLACE_FLEET с готовностью)
+    Game& game = gameAt(g_sharedMem, gameIdx);
+    joinGame(g_sharedMem, gameIdx, g_bot.id());
+
+    GameJournalRecord record = makeGameRecord(GAME_FLEET_PLACED, gameIdx, 2);
+    record.markReady = true;
+    beginGameWrite(game);
+    withRules(rules, [&](auto variant) {
+        typedef decltype(variant) Rules;
+        autoPlaceFleet<Rules>(record.fleet, shard.random);
+        record.fleetSize = Rules::TOTAL_SHIPS;
+        placeFleet(game.board<Rules>(false), record.fleet, record.fleetSize);
+    });
+    startGameIfReady(game, false);
+    endGameWrite(game);
+    journalGame(record);
+
+    TextBuffer(msg.data).format("Game '%s' against the bot created! Place your ships.", gameName);
+    msg.gameState = game.state;
+    strcpy(msg.gameName, game.name);
+    strcpy(msg.opponent, playerName(g_bot.id()));
+    msg.gameHandle = makeGameHandle(gameIdx, game.generation);
+}
 
-                    if (!isPlayer1 && !isPlayer2) {
-                        strcpy(g_sharedMem->message.data, "You are not a participant in this game!");
-                        break;
-                    }
+void handleGetStats(Shard&, Message& msg) {
+    std::string_view username = fieldView(msg.username);
+    g_log.debug("Stats request from %s", username);
 
-                    // Для ждущего отправляем инфу о последнем ходе
-                    if ((g_sharedMem->games[gameIdx].state == PLAYER1_TURN && isPlayer2) ||
-                        (g_sharedMem->games[gameIdx].state == PLAYER2_TURN && isPlayer1)) {
-
-                        // In a real implementation, we would store and retrieve the last move's coordinates and result
-                        // For now, we'll use defaults
-                        g_sharedMem->message.x = -1;
-                        g_sharedMem->message.y = -1;
-                        g_sharedMem->message.hitResult = -1;
-                        strcpy(g_sharedMem->message.data, "Waiting for opponent's move");
-                        } else {
-                            sprintf(g_sharedMem->message.data, "It's your turn in game %s", gameName.c_str());
-                        }
-                }
-                break;
-
-            case Message::PLACE_SHIP:
-                {
-                    std::string gameName = g_sharedMem->message.gameName;
-                    std::string username = g_sharedMem->message.username;
-                    int x = g_sharedMem->message.x;
-                    int y = g_sharedMem->message.y;
-                    int length = g_sharedMem->message.shipLength;
-                    bool horizontal = g_sharedMem->message.shipHorizontal;
-
-                    std::cout << "Place ship request from " << username << " in game " << gameName
-                              << " at (" << x << "," << y << "), length " << length
-                              << (horizontal ? " horizontal" : " vertical") << std::endl;
-
-                    int gameIdx = findGame(g_sharedMem, gameName.c_str());
-                    g_sharedMem->message.type = Message::PLACE_SHIP_RESPONSE;
-
-                    if (gameIdx == -1) {
-                        strcpy(g_sharedMem->message.data, "Game not found!");
-                        break;
-                    }
+    int playerIdx = findPlayer(msg.username);
+    msg.type = Message::STATS_DATA;
 
-                    // Определяем номер игрока
-                    bool isPlayer1 = (strcmp(g_sharedMem->games[gameIdx].player1, username.c_str()) == 0);
-                    bool isPlayer2 = (strcmp(g_sharedMem->games[gameIdx].player2, username.c_str()) == 0);
+    if (playerIdx == -1) {
+        strcpy(msg.data, "Player not found!");
+    } else {
+        int wins, losses;
+        {
+            std::lock_guard<std::mutex> lock(g_players.lockOf(playerIdx));
+            wins = g_players.at(playerIdx).wins;
+            losses = g_players.at(playerIdx).losses;
+        }
+        TextBuffer(msg.data).format("Statistics for %s:\nWins: %d\nLosses: %d\nWin rate: %.1f%%",
+                                    playerName(playerIdx), wins, losses, calculateWinRate(wins, losses));
+    }
+}
 
-                    if (!isPlayer1 && !isPlayer2) {
-                        strcpy(g_sharedMem->message.data, "You are not a participant in this game!");
-                        break;
-                    }
+// Ответ ERROR вместо ответа на запрос; номер запроса остается
+void failRequest(Message& msg, const char* reason) {
+    uint32_t requestId = msg.requestId;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = Message::ERROR;
+    msg.requestId = requestId;
+    msg.playerId = NO_PLAYER;
+    strcpy(msg.data, reason);
+}
 
-                    // Проверяем, что игра в фазе расстановки кораблей
-                    if (g_sharedMem->games[gameIdx].state != PLACING_SHIPS) {
-                        strcpy(g_sharedMem->message.data, "Game is not in the ship placement phase!");
-                        break;
-                    }
+#define JOURNAL_FAILED_REASON "Server cannot save changes, try again later"
 
-                    // Выбираем соответствующую доску
-                    GameBoard& board = isPlayer1 ? g_sharedMem->games[gameIdx].board1 : g_sharedMem->games[gameIdx].board2;
+void handleUnknown(Shard&, Message& msg) {
+    g_log.warn("Received unknown message type: %d", (int)msg.type);
+    msg.type = Message::ERROR;
+    strcpy(msg.data, "Unknown command");
+}
 
-                    // Проверяем, что осталось место для корабля
-                    int shipsOfLength[5] = {0}; // Индекс - длина корабля
-                    for (int i = 0; i < board.shipsPlaced; i++) {
-                        shipsOfLength[board.ships[i].length]++;
-                    }
+// Таблица обработчиков по типу запроса; собирается при компиляции.
+// Типы ответов и неизвестные типы ведут в handleUnknown
+typedef void (*RequestHandler)(Shard& shard, Message& msg);
+const int REQUEST_TYPE_LIMIT = Message::AUTO_PLACE_RESPONSE + 1;
 
-                    bool canPlaceShip = false;
-                    if (length == BATTLESHIP && shipsOfLength[BATTLESHIP] < BATTLESHIP_COUNT) {
-                        canPlaceShip = true;
-                    } else if (length == CRUISER && shipsOfLength[CRUISER] < CRUISER_COUNT) {
-                        canPlaceShip = true;
-                    } else if (length == DESTROYER && shipsOfLength[DESTROYER] < DESTROYER_COUNT) {
-                        canPlaceShip = true;
-                    } else if (length == SUBMARINE && shipsOfLength[SUBMARINE] < SUBMARINE_COUNT) {
-                        canPlaceShip = true;
-                    }
+struct RequestHandlers {
+    RequestHandler byType[REQUEST_TYPE_LIMIT];
+    bool changes[REQUEST_TYPE_LIMIT];   // Запрос меняет игры или статистику (пишет журнал)
 
-                    if (!canPlaceShip) {
-                        strcpy(g_sharedMem->message.data, "You have placed all ships of this type!");
-                        break;
-                    }
+    constexpr RequestHandlers() : byType(), changes() {
+        for (int i = 0; i < REQUEST_TYPE_LIMIT; i++) {
+            byType[i] = handleUnknown;
+        }
+        byType[Message::LOGIN] = handleLogin;
+        byType[Message::CREATE_GAME] = handleCreateGame;
+        byType[Message::LIST_GAMES] = handleListGames;
+        byType[Message::JOIN_GAME] = handleJoinGame;
+        byType[Message::GAME_STATUS] = handleGameStatus;
+        byType[Message::GAME_EVENTS] = handleGameEvents;
+        byType[Message::PLACE_SHIP] = handlePlaceShip;
+        byType[Message::PLACE_FLEET] = handlePlaceFleet;
+        byType[Message::SHIPS_READY] = handleShipsReady;
+        byType[Message::MAKE_MOVE] = handleMakeMove;
+        byType[Message::GET_STATS] = handleGetStats;
+        byType[Message::PLAY_VS_BOT] = handlePlayVsBot;
+        byType[Message::AUTO_PLACE] = handleAutoPlace;
+
+        changes[Message::LOGIN] = true;         // Регистрация нового игрока
+        changes[Message::CREATE_GAME] = true;
+        changes[Message::JOIN_GAME] = true;
+        changes[Message::PLACE_SHIP] = true;
+        changes[Message::PLACE_FLEET] = true;
+        changes[Message::SHIPS_READY] = true;
+        changes[Message::MAKE_MOVE] = true;
+        changes[Message::PLAY_VS_BOT] = true;
+    }
+};
 
-                    // Размещаем корабль
-                    bool placed = placeShip(board, x, y, length, horizontal);
+constexpr RequestHandlers g_requestHandlers;
 
-                    if (!placed) {
-                        strcpy(g_sharedMem->message.data, "Cannot place ship at this position!");
-                    } else {
-                        sprintf(g_sharedMem->message.data, "Ship of length %d placed successfully!", length);
+// Обработка одного сообщения клиента в его шарде, ответ пишется в то же сообщение
+void handleMessage(Shard& shard, Message& msg) {
+    int type = msg.type;
+    if (type < 0 || type >= REQUEST_TYPE_LIMIT) {
+        handleUnknown(shard, msg);
+        return;
+    }
+    if (g_requestHandlers.changes[type] && g_journalFailed.load(std::memory_order_acquire)) {
+        failRequest(msg, JOURNAL_FAILED_REASON);
+        return;
+    }
+    g_requestHandlers.byType[type](shard, msg);
+}
 
-                        // Проверяем, все ли корабли размещены
-                        if (areAllShipsPlaced(board)) {
-                            strcat(g_sharedMem->message.data, " All ships are now placed!");
-                        }
+// Диспетчер: шард для запроса. Игровые запросы идут в шард своей игры, вход -
+// в шард незаконченной игры игрока (чтобы ее можно было вернуть), остальное - по номеру или имени игрока
+int routeRequest(const Message& msg) {
+    switch (msg.type) {
+        case Message::LOGIN:
+            {
+                int playerIdx = findPlayer(msg.username);
+                if (playerIdx != -1) {
+                    GameHandle currentGame;
+                    {
+                        std::lock_guard<std::mutex> lock(g_players.lockOf(playerIdx));
+                        currentGame = g_players.at(playerIdx).currentGame;
+                    }
+                    if (currentGame != INVALID_GAME_HANDLE) {
+                        return (int)(gameHandleSlot(currentGame) % SERVER_SHARDS);
                     }
-
-                    // Отправляем обновленное количество размещенных кораблей
-                    g_sharedMem->message.shipLength = board.shipsPlaced;
                 }
-                break;
+                return shardOfName(msg.username);
+            }
 
-            case Message::SHIPS_READY:
+        case Message::CREATE_GAME:
+        case Message::PLAY_VS_BOT:
             {
-                std::string gameName = g_sharedMem->message.gameName;
-                std::string username = g_sharedMem->message.username;
+                // Имя игры обрезается так же, как при создании
+                char gameName[64];
+                strncpy(gameName, msg.data, sizeof(gameName) - 1);
+                gameName[sizeof(gameName) - 1] = '\0';
+                return shardOfName(gameName);
+            }
 
-                std::cout << "Ships ready notification from " << username << " in game " << gameName << std::endl;
+        case Message::LIST_GAMES:
+            if (msg.playerId != NO_PLAYER) {
+                return (int)((uint32_t)msg.playerId % SERVER_SHARDS);
+            }
+            return shardOfName(msg.username);
 
-                int gameIdx = findGame(g_sharedMem, gameName.c_str());
-                g_sharedMem->message.type = Message::SHIPS_READY_RESPONSE;
+        case Message::GET_STATS:
+            return shardOfName(msg.username);
 
-                if (gameIdx == -1) {
-                    strcpy(g_sharedMem->message.data, "Game not found!");
-                    break;
-                }
+        default:
+            if (msg.gameHandle != INVALID_GAME_HANDLE) {
+                return (int)(gameHandleSlot(msg.gameHandle) % SERVER_SHARDS);
+            }
+            return shardOfName(msg.gameName);
+    }
+}
 
-                // Определяем номер игрока
-                bool isPlayer1 = (strcmp(g_sharedMem->games[gameIdx].player1, username.c_str()) == 0);
-                bool isPlayer2 = (strcmp(g_sharedMem->games[gameIdx].player2, username.c_str()) == 0);
+// Поток шарда: обрабатывает свои запросы пачками, фиксирует журналы и отвечает клиентам
+void shardLoop(Shard* shard) {
+    uint32_t batch[MAX_CLIENTS];
+    while (true) {
+        int count = shard->queue.popBatch(batch, MAX_CLIENTS);
+        if (count == 0) {
+            shard->queue.waitForRequests();
+            continue;
+        }
 
-                if (!isPlayer1 && !isPlayer2) {
-                    strcpy(g_sharedMem->message.data, "You are not a participant in this game!");
-                    break;
-                }
+        // Брошенные игры освобождаем до пачки: ее запросы их уже не найдут
+        sweepAbandonedGames(*shard);
+        bool changed[MAX_CLIENTS];
+        for (int i = 0; i < count; i++) {
+            uint32_t records = t_journalRecords;
+            handleMessage(*shard, *requestMessage(batch[i]));
+            changed[i] = (t_journalRecords != records);
+        }
 
-                // Проверяем, что игра в фазе расстановки кораблей
-                if (g_sharedMem->games[gameIdx].state != PLACING_SHIPS) {
-                    strcpy(g_sharedMem->message.data, "Game is not in the ship placement phase!");
-                    break;
+        // Изменения всей пачки пишем в журналы до отправки ответов. Не записались -
+        // их не подтверждаем: запросы, которые что-то изменили, получают ERROR
+        if (!commitJournals()) {
+            for (int i = 0; i < count; i++) {
+                if (changed[i]) {
+                    failRequest(*requestMessage(batch[i]), JOURNAL_FAILED_REASON);
                 }
+            }
+        }
 
-                // Проверяем, все ли корабли размещены
-                GameBoard& board = isPlayer1 ? g_sharedMem->games[gameIdx].board1 : g_sharedMem->games[gameIdx].board2;
-
-                if (!areAllShipsPlaced(board)) {
-                    strcpy(g_sharedMem->message.data, "You haven't placed all your ships yet!");
-                    break;
-                }
+        for (int i = 0; i < count; i++) {
+            completeRequest(batch[i]);
+        }
 
-                // Проверяем, готовы ли оба игрока
-                GameBoard& otherBoard = isPlayer1 ? g_sharedMem->games[gameIdx].board2 : g_sharedMem->games[gameIdx].board1;
-
-                if (areAllShipsPlaced(otherBoard)) {
-                    // Оба игрока готовы, начинаем игру
-                    g_sharedMem->games[gameIdx].state = PLAYER1_TURN;
-                    strcpy(g_sharedMem->message.data, "Both players are ready! Game starts now.");
-                    g_sharedMem->message.gameState = PLAYER1_TURN;
-
-                    // Указываем, чей сейчас ход
-                    if (isPlayer1) {
-                        strcat(g_sharedMem->message.data, " It's your turn!");
-                        strcpy(g_sharedMem->message.opponent, g_sharedMem->games[gameIdx].player2);
-                    } else {
-                        strcat(g_sharedMem->message.data, " Waiting for opponent's move.");
-                        strcpy(g_sharedMem->message.opponent, g_sharedMem->games[gameIdx].player1);
-                    }
-                } else {
-                    // Ждем второго игрока
-                    strcpy(g_sharedMem->message.data, "\nYour ships are ready! Waiting for your opponent...");
-                    g_sharedMem->message.gameState = PLACING_SHIPS;
-
-                    // Указываем оппонента
-                    if (isPlayer1) {
-                        strcpy(g_sharedMem->message.opponent, g_sharedMem->games[gameIdx].player2);
-                    } else {
-                        strcpy(g_sharedMem->message.opponent, g_sharedMem->games[gameIdx].player1);
-                    }
-                }
-            }
-            break;
+        // Диспетчер может ждать, пока шарды ответят на все запросы
+        if (g_inFlight.fetch_sub(count, std::memory_order_seq_cst) == (uint32_t)count &&
+            g_barrierWaiting.load(std::memory_order_seq_cst)) {
+            futexWake(&g_inFlight);
+        }
+    }
+}
 
-            case Message::MAKE_MOVE:
-            {
-                std::string gameName = g_sharedMem->message.gameName;
-                std::string username = g_sharedMem->message.username;
-                int x = g_sharedMem->message.x;
-                int y = g_sharedMem->message.y;
+// Есть записи журналов, еще не синхронизированные с диском
+bool journalsUnsynced() {
+    return g_statsJournal.unsyncedRecordCount() + g_gamesJournal.unsyncedRecordCount() > 0;
+}
 
-                std::cout << "Move request from " << username << " in game " << gameName
-                          << " at (" << x << "," << y << ")" << std::endl;
+int main() {
+    // На всякий случай чистим
+    shm_unlink(MMF_NAME);
 
-                int gameIdx = findGame(g_sharedMem, gameName.c_str());
-                g_sharedMem->message.type = Message::MOVE_RESULT;
 
-                if (gameIdx == -1) {
-                    strcpy(g_sharedMem->message.data, "Game not found!");
-                    break;
-                }
+    // Установка обработчика сигнала (SIGINT получает только основной поток - диспетчер)
+    signal(SIGINT, signalHandler);
+    signal(SIGUSR1, signalHandler);
+    signal(SIGUSR2, signalHandler);
+    sigset_t sigintMask;
+    sigemptyset(&sigintMask);
+    sigaddset(&sigintMask, SIGINT);
+    std::cout << "Sigint handler initalized" << std::endl;
 
-                // Определяем номер игрока
-                bool isPlayer1 = (strcmp(g_sharedMem->games[gameIdx].player1, username.c_str()) == 0);
-                bool isPlayer2 = (strcmp(g_sharedMem->games[gameIdx].player2, username.c_str()) == 0);
+    std::cout << "Initializing shared memory..." << std::endl;
+    // Создаем сегмент разделяемой памяти: пока только заголовок,
+    // куски таблицы игр добавятся по мере создания игр
+    if (!g_arena.create(MMF_NAME)) {
+        std::cerr << "Error creating shared memory: " << strerror(errno) << std::endl;
+        shm_unlink(MMF_NAME);
+        return 1;
+    }
+    g_sharedMem = g_arena.memory();
 
-                if (!isPlayer1 && !isPlayer2) {
-                    strcpy(g_sharedMem->message.data, "You are not a participant in this game!");
-                    break;
-                }
+    // Ставим все в нули
+    g_sharedMem->gameCount = 0;
 
-                // Проверяем, чей сейчас ход
-                if ((g_sharedMem->games[gameIdx].state == PLAYER1_TURN && !isPlayer1) ||
-                    (g_sharedMem->games[gameIdx].state == PLAYER2_TURN && !isPlayer2)) {
-                    strcpy(g_sharedMem->message.data, "It's not your turn!");
-                    break;
-                }
+    // Кольцо запросов и почтовые слоты клиентов
+    g_sharedMem->ring.init();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        g_sharedMem->slots[i].init();
+    }
+    for (int k = 0; k < MAX_GAME_CHUNKS; k++) {
+        g_sharedMem->gameChunks[k].store(0, std::memory_order_relaxed);
+        g_sharedMem->chunkRules[k] = 0;
+    }
+    std::cout << "Shared memory initalized" << std::endl;
 
-                // Выполняем ход
-                GameBoard& targetBoard = isPlayer1 ? g_sharedMem->games[gameIdx].board2 : g_sharedMem->games[gameIdx].board1;
-                int result = processMove(targetBoard, x, y);
+    // Загружаем статистику и игры; восстановленные игры ждут игроков полный срок
+    g_startTime = monotonicSeconds();
+    const char* abandonSeconds = getenv("SEA_BATTLE_ABANDON_SECONDS");
+    if (abandonSeconds != nullptr && atol(abandonSeconds) > 0) {
+        g_abandonSeconds = atol(abandonSeconds);
+    }
+    recoverStats();
+    recoverGames(g_sharedMem);
+    std::cout << "Stats downloaded" << std::endl;
 
-                if (result == -1) {
-                    strcpy(g_sharedMem->message.data, "Invalid coordinates!");
-                    break;
-                } else if (result == -2) {
-                    strcpy(g_sharedMem->message.data, "You already fired at this position!");
-                    break;
-                }
+    // Бот - обычный игрок с зарезервированным именем, его победы тоже в статистике
+    bool botAdded = false;
+    PlayerId botPlayer = g_players.findOrAdd(BOT_NAME, botAdded);
+    if (botAdded) {
+        journalStats(STATS_NEW_PLAYER, botPlayer);
+    }
 
-                // Обрабатываем результат хода
-                g_sharedMem->message.hitResult = result;
-
-                    if (result == 0) {
-                        centerText(g_sharedMem->message.data, "❌ Miss! ❌", 54);
-                        // Переход хода к другому игроку
-                        g_sharedMem->games[gameIdx].state = isPlayer1 ? PLAYER2_TURN : PLAYER1_TURN;
-                        g_sharedMem->message.gameState = g_sharedMem->games[gameIdx].state;
-                    } else if (result == 1) {
-                        centerText(g_sharedMem->message.data, "💥 Hit! 💥", 54);
-                        // Игрок продолжает ход после попадания
-                        g_sharedMem->message.gameState = g_sharedMem->games[gameIdx].state;
-                    } else if (result == 2) {
-                        centerText(g_sharedMem->message.data, "🔥 Ship destroyed! 🔥", 54);
-                        // Игрок продолжает ход после уничтожения корабля
-                        g_sharedMem->message.gameState = g_sharedMem->games[gameIdx].state;
-                    } else if (result == 3) {
-                        // Победа - все корабли уничтожены
-                        centerText(g_sharedMem->message.data, "🌟 Victory! All enemy ships destroyed! 🌟", 30);
-                        g_sharedMem->games[gameIdx].state = GAME_OVER;
-                        g_sharedMem->games[gameIdx].winner = isPlayer1 ? 1 : 2;
-                        g_sharedMem->message.gameState = GAME_OVER;
-
-                    // Обновляем статистику игроков
-                    int winnerIdx = findPlayer(username.c_str());
-                    int loserIdx = findPlayer(isPlayer1 ? g_sharedMem->games[gameIdx].player2 : g_sharedMem->games[gameIdx].player1);
-
-                    if (winnerIdx != -1) {
-                        g_players[winnerIdx].wins++;
-                        g_players[winnerIdx].inGame = false;
-                        g_players[winnerIdx].currentGame[0] = '\0';
-                    }
+    // Запускаем поток журнала и потоки шардов; они наследуют маску сигналов без SIGINT
+    pthread_sigmask(SIG_BLOCK, &sigintMask, nullptr);
+    const char* logLevel = getenv("SEA_BATTLE_LOG_LEVEL");
+    if (logLevel != nullptr && parseLogLevel(logLevel) != -1) {
+        g_log.setLevel(parseLogLevel(logLevel));
+    }
+    if (g_log.start(SERVER_LOG_FILE)) {
+        std::cout << "Logging to " << SERVER_LOG_FILE << " (level " << logLevelName(g_log.getLevel())
+                  << ", SIGUSR1/SIGUSR2 to change)" << std::endl;
+    } else {
+        std::cerr << "Warning: Cannot open " << SERVER_LOG_FILE << ", logging to stdout." << std::endl;
+    }
+    for (int k = 0; k < SERVER_SHARDS; k++) {
+        g_shards[k].id = k;
+        g_shards[k].random.seed((uint64_t)time(nullptr) * SERVER_SHARDS + k);
+        g_shards[k].queue.init();
+        std::thread(shardLoop, &g_shards[k]).detach();
+    }
+    pthread_sigmask(SIG_UNBLOCK, &sigintMask, nullptr);
+
+    // Клиенты общей памяти шлют номер своего слота - это транспорт 0
+    g_transports[TRANSPORT_SHM] = new ShmTransport(g_sharedMem);
+    g_transports[TRANSPORT_SOCKET] = &g_socketTransport;
+
+    // Сокетный транспорт кладет запросы в то же кольцо
+    pthread_sigmask(SIG_BLOCK, &sigintMask, nullptr);
+    // TCP по умолчанию только с этой машины; другой адрес - SEA_BATTLE_TCP_ADDRESS=host:port
+    const char* tcpAddress = getenv("SEA_BATTLE_TCP_ADDRESS");
+    std::string tcpListen = tcpAddress != nullptr ? tcpAddress : SERVER_TCP_HOST ":" + std::to_string(SERVER_TCP_PORT);
+    if (g_socketTransport.start(&g_sharedMem->ring, SERVER_SOCKET_PATH, tcpListen, releasePlayerSession)) {
+        std::cout << "Listening on " << SERVER_SOCKET_PATH << " and TCP " << tcpListen << std::endl;
+    } else {
+        std::cerr << "Warning: Socket transport is not available, shared memory only." << std::endl;
+    }
 
-                    if (loserIdx != -1) {
-                        g_players[loserIdx].losses++;
-                        g_players[loserIdx].inGame = false;
-                        g_players[loserIdx].currentGame[0] = '\0';
-                    }
-                }
+    // Бот шлет свои ходы в то же кольцо; восстановленные игры, где ход за ним, будим сразу
+    if (botPlayer != NO_PLAYER) {
+        g_transports[TRANSPORT_BOT] = &g_bot;
+        g_bot.start(g_sharedMem, botPlayer, &g_log);
+        int gameCount = g_sharedMem->gameCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < gameCount; i++) {
+            const Game& game = gameAt(g_sharedMem, i);
+            if (game.active && game.player2 == botPlayer && game.state == PLAYER2_TURN) {
+                g_bot.takeTurn(i);
             }
-            break;
+        }
+    } else {
+        std::cerr << "Warning: Player table is full, the bot is not available." << std::endl;
+    }
+    pthread_sigmask(SIG_UNBLOCK, &sigintMask, nullptr);
 
-            case Message::GET_STATS:
-                {
-                    std::string username = g_sharedMem->message.username;
-                    std::cout << "Stats request from " << username << std::endl;
-
-                    int playerIdx = findPlayer(username.c_str());
-                    g_sharedMem->message.type = Message::STATS_DATA;
-
-                    if (playerIdx == -1) {
-                        strcpy(g_sharedMem->message.data, "Player not found!");
-                    } else {
-                        sprintf(g_sharedMem->message.data,
-                                "Statistics for %s:\nWins: %d\nLosses: %d\nWin rate: %.1f%%",
-                                username.c_str(),
-                                g_players[playerIdx].wins,
-                                g_players[playerIdx].losses,
-                                calculateWinRate(g_players[playerIdx].wins, g_players[playerIdx].losses));
-                    }
-                }
-                break;
+    std::cout << "\nSea Battle Server started (" << SERVER_SHARDS
+              << " shards). Press Ctrl+C to save and exit." << std::endl;
 
-            default:
-                std::cout << "Received unknown message type: " << g_sharedMem->message.type << std::endl;
-                g_sharedMem->message.type = Message::ERROR;
-                strcpy(g_sharedMem->message.data, "Unknown command");
-                break;
+    // Основной цикл сервера: диспетчер раскладывает запросы по шардам
+    while (!g_shutdownRequested.load(std::memory_order_acquire)) {
+        // Снимки делаем, пока шарды стоят
+        if (g_compactRequested.load(std::memory_order_acquire)) {
+            compactJournals();
         }
 
-        // Уведомляем клиента, что ответ готов
-        sem_post(g_semServerReady);
+        // Забираем пачку запросов из кольца, спим только если оно пусто
+        uint32_t batch[MAX_CLIENTS];
+        int count = g_sharedMem->ring.popBatch(batch, MAX_CLIENTS);
+        if (count == 0) {
+            // Не синхронизированный журнал досинхронизируем по таймауту
+            if (journalsUnsynced()) {
+                g_sharedMem->ring.waitForRequests(JOURNAL_SYNC_INTERVAL_MS, &g_shutdownRequested);
+                commitJournals();
+            } else {
+                g_sharedMem->ring.waitForRequests(-1, &g_shutdownRequested);
+            }
+            continue;
+        }
+
+        g_inFlight.fetch_add(count, std::memory_order_seq_cst);
+        for (int i = 0; i < count; i++) {
+            Message* msg = receiveRequest(batch[i]);
+            if (msg == nullptr) {
+                g_inFlight.fetch_sub(1, std::memory_order_seq_cst);
+                continue;
+            }
+            RequestRing& queue = g_shards[routeRequest(*msg)].queue;
+            while (!queue.push(batch[i])) {
+                sched_yield(); // очередь шарда заполнена (много сокетных клиентов)
+            }
+        }
     }
 
-    saveStats();
-    // saveGames(g_sharedMem);
-    munmap(g_sharedMem, MMF_SIZE);
-    sem_close(g_semClientReady);
-    sem_close(g_semServerReady);
-    sem_unlink(SEM_CLIENT_READY);
-    sem_unlink(SEM_SERVER_READY);
-    close(g_shm_fd);
+    // SIGINT: все розданные запросы дошли до шардов - ждем ответов и сохраняемся
+    std::cout << "\nReceived SIGINT. Saving data and cleaning up..." << std::endl;
+    compactJournals();
+    unlink(SERVER_SOCKET_PATH);
+
+    g_arena.close();
     shm_unlink(MMF_NAME);
 
+    g_log.stop();
     return 0;
 }
\ No newline at end of file
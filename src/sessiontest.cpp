@@ -0,0 +1,288 @@
+#include <iostream>
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "common.h"
+#include "net.h"
+#include "wire.h"
+#include "bench.h"
+
+// Проверка сессий игроков на работающем сервере: вход, отключение и повторный
+// вход. Пока соединение игрока открыто, второй вход под тем же именем получает
+// "Already online"; после закрытия соединения имя снова свободно. То же для
+// клиента общей памяти, упавшего без освобождения слота (kill -9). Вернувшийся
+// игрок с незаконченной игрой получает ее при входе (возврат в игру).
+// Сервер узнает о закрытии асинхронно, поэтому повторный вход пробуем до
+// SESSION_TEST_WAIT_MS.
+// С abandon seconds (сервер запущен с тем же SEA_BATTLE_ABANDON_SECONDS) еще
+// проверяется, что игра ушедшего игрока по истечении срока освобождается вместе
+// с именем, а игра игрока в сети - нет.
+//
+// ./sessiontest [address] [client] [abandon seconds]   (адрес как у клиента, client - путь к ./client)
+
+#define SESSION_TEST_WAIT_MS 5000
+#define SESSION_TEST_RETRY_MS 10
+
+uint32_t g_requestId = 0;
+
+// Вход под именем; NO_PLAYER - отказ (или соединение закрыто)
+PlayerId login(int fd, const std::string& username, Message& response) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = Message::LOGIN;
+    msg.requestId = ++g_requestId;
+    snprintf(msg.username, sizeof(msg.username), "%s", username.c_str());
+    if (!sendMessage(fd, msg) || !readMessage(fd, response) || response.type != Message::LOGIN_RESPONSE) {
+        response.type = Message::ERROR;
+        return NO_PLAYER;
+    }
+    return response.playerId;
+}
+
+// Входим, пока сервер не ответит ожидаемым образом (online - "Already online")
+bool waitForLogin(int fd, const std::string& username, bool online, Message& response) {
+    for (int waited = 0; waited < SESSION_TEST_WAIT_MS; waited += SESSION_TEST_RETRY_MS) {
+        PlayerId player = login(fd, username, response);
+        if (response.type != Message::LOGIN_RESPONSE) {
+            return false;
+        }
+        if ((player == NO_PLAYER) == online) {
+            return true;
+        }
+        usleep(SESSION_TEST_RETRY_MS * 1000);
+    }
+    return false;
+}
+
+// Запрос в соединение и ответ на него; false - соединение закрыто
+bool exchange(int fd, Message& msg) {
+    msg.requestId = ++g_requestId;
+    return sendMessage(fd, msg) && readMessage(fd, msg);
+}
+
+// Входим в новом соединении, как перезапущенный клиент; -1 - не удалось
+int reconnect(const std::string& address, const std::string& username, Message& response) {
+    int fd = connectToServer(address);
+    if (fd != -1 && !waitForLogin(fd, username, false, response)) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Создаем игру; false - сервер отказал
+bool createGame(int fd, const std::string& gameName, Message& msg) {
+    memset(&msg, 0, sizeof(msg));
+    msg.type = Message::CREATE_GAME;
+    snprintf(msg.data, sizeof(msg.data), "%s", gameName.c_str());
+    return exchange(fd, msg) && msg.type == Message::CREATE_GAME_RESPONSE && msg.gameHandle != INVALID_GAME_HANDLE;
+}
+
+// Вход вернул незаконченную игру
+bool offersGame(const Message& response, GameHandle game, GameState state, const std::string& opponent) {
+    return response.type == Message::LOGIN_RESPONSE && response.gameHandle == game &&
+           response.gameState == state && opponent == response.opponent;
+}
+
+// Клиент общей памяти с заданным вводом. Его вывод читаем через output;
+// канал ввода (input) держим открытым, пока клиент нужен
+struct ClientProcess {
+    pid_t pid;
+    int input;
+    int output;
+};
+
+bool startClient(const char* clientPath, const std::string& text, ClientProcess& client) {
+    int in[2], out[2];
+    if (pipe(in) == -1 || pipe(out) == -1) {
+        return false;
+    }
+    client.pid = fork();
+    if (client.pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        execl(clientPath, clientPath, (char*)nullptr);
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    client.input = in[1];
+    client.output = out[0];
+    ssize_t written = write(client.input, text.c_str(), text.size());
+    (void)written;
+    return client.pid != -1;
+}
+
+// Ждем строки в выводе клиента; false - клиент завершился или не дождались
+bool waitForOutput(ClientProcess& client, const char* text) {
+    std::string seen;
+    for (int waited = 0; waited < SESSION_TEST_WAIT_MS; waited += SESSION_TEST_RETRY_MS) {
+        struct pollfd ready = {client.output, POLLIN, 0};
+        if (poll(&ready, 1, SESSION_TEST_RETRY_MS) == 1) {
+            char buffer[4096];
+            ssize_t n = read(client.output, buffer, sizeof(buffer));
+            if (n <= 0) {
+                return false;
+            }
+            seen.append(buffer, (size_t)n);
+            if (seen.find(text) != std::string::npos) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Клиент падает, не освободив слот
+void crashClient(ClientProcess& client) {
+    kill(client.pid, SIGKILL);
+    waitpid(client.pid, nullptr, 0);
+    close(client.input);
+    close(client.output);
+}
+
+bool check(const char* name, bool passed) {
+    std::cout << (passed ? "ok      " : "FAILED  ") << name << std::endl;
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    BenchArgs args(argc, argv, "[address] [client] [abandon seconds]");
+    std::string address = args.text(1, "unix:");
+    const char* clientPath = args.text(2, "./client");
+    int abandonSeconds = (int)args.integer(3, 0, 0, 3600);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Имена уникальны для запуска
+    std::string prefix = "session" + std::to_string(getpid()) + "_";
+    bool passed = true;
+    Message response;
+
+    // Вход, второй вход при живом соединении, вход после отключения
+    std::string name = prefix + "socket";
+    int first = connectToServer(address);
+    int second = connectToServer(address);
+    if (first == -1 || second == -1) {
+        std::cerr << "Error connecting to " << address << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    PlayerId player = login(first, name, response);
+    passed = check("login", player != NO_PLAYER) && passed;
+    bool refused = login(second, name, response) == NO_PLAYER && strcmp(response.data, "Already online") == 0;
+    passed = check("second login while online is refused", refused) && passed;
+    passed = check("same connection may log in again", login(first, name, response) == player) && passed;
+
+    close(first);
+    bool relogged = waitForLogin(second, name, false, response) && response.playerId == player;
+    passed = check("login after disconnect", relogged) && passed;
+    close(second);
+
+    // Клиент общей памяти входит и падает, не освободив слот
+    std::string shmName = prefix + "shm";
+    ClientProcess client;
+    bool started = startClient(clientPath, shmName + "\n", client);
+    int probe = connectToServer(address);
+    bool online = started && waitForOutput(client, "Registration successful!") && probe != -1 &&
+                  login(probe, shmName, response) == NO_PLAYER;
+    passed = check("shared memory client is online", online) && passed;
+    if (started) {
+        crashClient(client);
+    }
+    passed = check("login after shared memory client crash",
+                   online && waitForLogin(probe, shmName, false, response)) && passed;
+    if (probe != -1) {
+        close(probe);
+    }
+
+    // Оба игрока игры отключаются на расстановке и входят снова - игра возвращается
+    std::string host = prefix + "host", guest = prefix + "guest";
+    int hostFd = connectToServer(address);
+    int guestFd = connectToServer(address);
+    Message msg;
+    bool created = login(hostFd, host, response) != NO_PLAYER && createGame(hostFd, prefix + "game", msg);
+    GameHandle game = msg.gameHandle;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = Message::JOIN_GAME;
+    msg.gameHandle = game;
+    bool joined = created && login(guestFd, guest, response) != NO_PLAYER && exchange(guestFd, msg) &&
+                  msg.type == Message::JOIN_GAME_RESPONSE && msg.gameState == PLACING_SHIPS;
+    passed = check("create and join a game", joined) && passed;
+    close(hostFd);
+    close(guestFd);
+
+    hostFd = reconnect(address, host, response);
+    passed = check("host resumes after reconnect", offersGame(response, game, PLACING_SHIPS, guest)) && passed;
+    guestFd = reconnect(address, guest, response);
+    passed = check("guest resumes after reconnect", offersGame(response, game, PLACING_SHIPS, host)) && passed;
+    if (hostFd != -1) {
+        close(hostFd);
+    }
+    if (guestFd != -1) {
+        close(guestFd);
+    }
+
+    // Клиент общей памяти создает игру и падает - после перезапуска игра его ждет
+    std::string owner = prefix + "owner", shmGame = prefix + "shmgame";
+    started = startClient(clientPath, owner + "\n1\n" + shmGame + "\n\n", client);
+    probe = connectToServer(address);
+    bool waiting = false;
+    PlayerId prober = login(probe, prefix + "probe", response);
+    for (int waited = 0; started && prober != NO_PLAYER && waited < SESSION_TEST_WAIT_MS && !waiting;
+         waited += SESSION_TEST_RETRY_MS) {
+        // Игра есть, когда к ней можно присоединиться
+        memset(&msg, 0, sizeof(msg));
+        msg.type = Message::JOIN_GAME;
+        snprintf(msg.gameName, sizeof(msg.gameName), "%s", shmGame.c_str());
+        waiting = exchange(probe, msg) && msg.gameState == PLACING_SHIPS;
+        if (!waiting) {
+            usleep(SESSION_TEST_RETRY_MS * 1000);
+        }
+    }
+    game = msg.gameHandle;
+    passed = check("shared memory client creates a game", waiting) && passed;
+    if (started) {
+        crashClient(client);
+    }
+    int ownerFd = reconnect(address, owner, response);
+    passed = check("owner resumes after client restart",
+                   waiting && offersGame(response, game, PLACING_SHIPS, prefix + "probe")) && passed;
+    if (ownerFd != -1) {
+        close(ownerFd);
+    }
+    if (probe != -1) {
+        close(probe);
+    }
+
+    if (abandonSeconds == 0) {
+        return passed ? 0 : 1;
+    }
+
+    // Игрок создает игру и уходит, другой остается в сети со своей игрой
+    std::string gone = prefix + "gone", stays = prefix + "stays";
+    int goneFd = connectToServer(address);
+    int staysFd = connectToServer(address);
+    bool both = login(goneFd, gone, response) != NO_PLAYER && createGame(goneFd, prefix + "left", msg) &&
+                login(staysFd, stays, response) != NO_PLAYER && createGame(staysFd, prefix + "kept", msg);
+    passed = check("create games to abandon and keep", both) && passed;
+    close(goneFd);
+    sleep(abandonSeconds + 1);
+
+    // Имя брошенной игры снова свободно, имя игры игрока в сети - нет
+    int otherFd = connectToServer(address);
+    bool loggedIn = login(otherFd, prefix + "other", response) != NO_PLAYER;
+    passed = check("abandoned game is released", loggedIn && createGame(otherFd, prefix + "left", msg)) && passed;
+    passed = check("game of an online player is kept", loggedIn && !createGame(otherFd, prefix + "kept", msg) &&
+                   strcmp(msg.data, "Game with this name already exists!") == 0) && passed;
+    close(staysFd);
+    close(otherFd);
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "common.h"
+#include "board.h"
+#include "engine.h"
+
+// Автономная симуляция: N партий бот против бота на всех ядрах, без сервера и
+// общей памяти. Для оценки стратегий и проверки изменений правил.
+// Партия i играется с генератором, засеянным seed + i, поэтому итог при том же
+// зерне не зависит от числа потоков.
+//
+// ./simulate [games] [seed] [strategy1] [strategy2] [threads] [rules]
+// Стратегии: random, hunt, density; правила: classic, quick, large
+
+template <class Rules>
+using ShotStrategy = bool (*)(const GameBoard<Rules>& board, int& x, int& y, GameRandom& random);
+
+#define STRATEGY_COUNT 3
+
+// Стратегии по номеру; у каждого варианта правил свой экземпляр кода
+const char* const g_strategyNames[STRATEGY_COUNT] = {"random", "hunt", "density"};
+
+template <class Rules>
+inline constexpr ShotStrategy<Rules> g_strategies[STRATEGY_COUNT] = {
+    randomShot<Rules>, huntShot<Rules>, botChooseShot<Rules>,
+};
+
+// Имена вариантов правил в командной строке (по номеру варианта)
+const char* const g_rulesNames[RULES_COUNT] = {"classic", "quick", "large"};
+
+// Номер по имени в таблице, -1 - такого нет
+int findName(const char* const names[], int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Итоги потока; по своей линии кэша, чтобы потоки не мешали друг другу
+struct alignas(64) SimulationResult {
+    uint64_t games;
+    uint64_t shots;
+    uint64_t wins[2];
+};
+
+struct SimulationTask {
+    uint64_t firstGame;
+    uint64_t gameCount;
+    uint64_t seed;
+    int players[2];   // Номера стратегий
+    int rules;
+    SimulationResult* result;
+};
+
+// Одна партия до победы; флоты расставляются случайно
+template <class Rules>
+void playMatch(Match<Rules>& match, const ShotStrategy<Rules> players[2], GameRandom& random) {
+    ShipPlacement fleet[Rules::TOTAL_SHIPS];
+    for (int p = 0; p < 2; p++) {
+        autoPlaceFleet<Rules>(fleet, random);
+        setFleet(match.boards[p], fleet);
+    }
+
+    while (match.turn != 0) {
+        int x, y;
+        const GameBoard<Rules>& target = match.boards[2 - match.turn];
+        if (!players[match.turn - 1](target, x, y, random)) {
+            break; // стрелять некуда - быть не может, но не зацикливаемся
+        }
+        matchShot(match, x, y);
+    }
+}
+
+template <class Rules>
+void simulateGames(const SimulationTask& task) {
+    const ShotStrategy<Rules> players[2] = {g_strategies<Rules>[task.players[0]], g_strategies<Rules>[task.players[1]]};
+    SimulationResult result = {};
+    GameRandom random;
+    for (uint64_t i = 0; i < task.gameCount; i++) {
+        random.seed(task.seed + task.firstGame + i);
+        Match<Rules> match;
+        playMatch(match, players, random);
+
+        result.games++;
+        result.shots += match.shots[0] + match.shots[1];
+        if (match.winner != 0) {
+            result.wins[match.winner - 1]++;
+        }
+    }
+    *task.result = result;
+}
+
+void simulationThread(SimulationTask task) {
+    withRules(task.rules, [&](auto variant) {
+        simulateGames<decltype(variant)>(task);
+    });
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t games = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : (uint64_t)time(nullptr);
+    const char* names[2] = {argc > 3 ? argv[3] : "hunt", argc > 4 ? argv[4] : "hunt"};
+    int threads = argc > 5 ? atoi(argv[5]) : (int)std::thread::hardware_concurrency();
+    if (threads <= 0) {
+        threads = 1;
+    }
+    int rules = findName(g_rulesNames, RULES_COUNT, argc > 6 ? argv[6] : "classic");
+    if (rules < 0) {
+        std::cerr << "Unknown rules: " << argv[6] << " (classic, quick, large)" << std::endl;
+        return 1;
+    }
+
+    int players[2];
+    for (int p = 0; p < 2; p++) {
+        players[p] = findName(g_strategyNames, STRATEGY_COUNT, names[p]);
+        if (players[p] < 0) {
+            std::cerr << "Unknown strategy: " << names[p] << " (random, hunt, density)" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Simulating " << games << " games (" << names[0] << " vs " << names[1]
+              << ", " << g_rulesInfo[rules].name << ", seed " << seed << ") on " << threads
+              << " threads..." << std::endl;
+
+    std::vector<SimulationResult> results(threads);
+    std::vector<std::thread> workers;
+    struct timespec start, finish;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint64_t nextGame = 0;
+    for (int t = 0; t < threads; t++) {
+        SimulationTask task;
+        task.firstGame = nextGame;
+        task.gameCount = games / threads + ((uint64_t)t < games % threads ? 1 : 0);
+        task.seed = seed;
+        task.players[0] = players[0];
+        task.players[1] = players[1];
+        task.rules = rules;
+        task.result = &results[t];
+        nextGame += task.gameCount;
+        workers.emplace_back(simulationThread, task);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    double seconds = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9;
+
+    SimulationResult total = {};
+    for (const SimulationResult& result : results) {
+        total.games += result.games;
+        total.shots += result.shots;
+        total.wins[0] += result.wins[0];
+        total.wins[1] += result.wins[1];
+    }
+    if (total.games == 0) {
+        return 0;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Games/sec: " << total.games / seconds << " (" << std::setprecision(3) << seconds << " s)" << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "Average game length: " << (double)total.shots / total.games << " shots" << std::endl;
+    std::cout << "Player 1 (" << names[0] << ") wins: " << 100.0 * total.wins[0] / total.games << "%" << std::endl;
+    std::cout << "Player 2 (" << names[1] << ") wins: " << 100.0 * total.wins[1] / total.games << "%" << std::endl;
+    return 0;
+}
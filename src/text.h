@@ -0,0 +1,56 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <cstddef>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+// Поле сообщения как строка без копирования (поле может быть заполнено до конца без нуля)
+template <size_t N>
+std::string_view fieldView(const char (&field)[N]) {
+    return std::string_view(field, strnlen(field, N));
+}
+
+// Текст ответа пишется прямо в буфер сообщения: без кучи, не влезшее обрезается
+class TextBuffer {
+public:
+    template <size_t N>
+    explicit TextBuffer(char (&buffer)[N]) : data(buffer), capacity(N), length(0) {
+        data[0] = '\0';
+    }
+
+    // Не встраиваем: встроенный memcpy с известной верхней границей длины GCC -O2
+    // превращает в rep movsq, а на коротких строках это в разы медленнее вызова memcpy
+    __attribute__((noinline)) TextBuffer& append(std::string_view text) {
+        size_t n = std::min(text.size(), capacity - 1 - length);
+        memcpy(data + length, text.data(), n);
+        length += n;
+        data[length] = '\0';
+        return *this;
+    }
+
+    TextBuffer& format(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(data + length, capacity - length, fmt, args);
+        va_end(args);
+        if (n > 0) {
+            length = std::min(length + (size_t)n, capacity - 1);
+        }
+        return *this;
+    }
+
+    bool full() const {
+        return length == capacity - 1;
+    }
+
+private:
+    char* data;
+    size_t capacity;
+    size_t length;
+};
+
+#endif // TEXT_H
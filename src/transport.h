@@ -0,0 +1,536 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "net.h"
+#include "wire.h"
+
+// Транспорт: откуда пришел запрос и куда отдать ответ.
+// Обработчики работают только с Message и не знают, как он доставлен;
+// по каналу идет кадр wire.h.
+class Transport {
+public:
+    virtual ~Transport() {}
+
+    // Разбираем пришедший запрос (вызывает диспетчер); nullptr - неверный номер.
+    // Поврежденный кадр становится запросом типа ERROR
+    virtual Message* receive(uint32_t localId) = 0;
+
+    // Уже разобранное сообщение запроса
+    virtual Message* message(uint32_t localId) = 0;
+
+    // Ответ записан в сообщение - отдаем его клиенту (вызывают потоки шардов)
+    virtual void complete(uint32_t localId) = 0;
+
+    // Канал сессии (см. makeSession) все еще занят тем же клиентом (вызывают потоки шардов)
+    virtual bool sessionAlive(uint32_t channel, uint32_t generation) = 0;
+};
+
+// Сессия кончилась (соединение закрыто); player - вошедший через нее игрок
+typedef void (*SessionClosed)(PlayerId player, SessionId session);
+
+// Кадр ответа. Ответ, который не кодируется (encodeMessage вернул 0), заменяем
+// на ERROR с тем же номером запроса - клиент не должен ждать ответа вечно
+inline size_t encodeResponse(const Message& response, uint8_t* frame, size_t capacity) {
+    size_t size = encodeMessage(response, frame, capacity);
+    if (size == 0) {
+        Message error;
+        memset(&error, 0, sizeof(error));
+        error.type = Message::ERROR;
+        error.requestId = response.requestId;
+        strcpy(error.data, "Server cannot encode the response");
+        size = encodeMessage(error, frame, capacity);
+    }
+    return size;
+}
+
+// Общая память: ящики почтовых слотов клиентов
+class ShmTransport : public Transport {
+public:
+    explicit ShmTransport(SharedMemory* sharedMem) : sharedMem(sharedMem) {}
+
+    Message* receive(uint32_t localId) override {
+        if (localId >= MAX_CLIENTS * PIPELINE_DEPTH) {
+            return nullptr;
+        }
+        if (!decodeMessage(mailbox(localId).frame, WIRE_MAX_FRAME, messages[localId])) {
+            messages[localId].type = Message::ERROR;
+        }
+        uint32_t slot = localId / PIPELINE_DEPTH;
+        messages[localId].session = makeSession(TRANSPORT_SHM, slot, (uint32_t)sharedMem->slots[slot].ownerPid);
+        return &messages[localId];
+    }
+
+    Message* message(uint32_t localId) override {
+        return localId < MAX_CLIENTS * PIPELINE_DEPTH ? &messages[localId] : nullptr;
+    }
+
+    void complete(uint32_t localId) override {
+        ClientSlot& slot = sharedMem->slots[localId / PIPELINE_DEPTH];
+        Mailbox& box = mailbox(localId);
+        encodeResponse(messages[localId], box.frame, WIRE_MAX_FRAME);
+        box.state.store(SLOT_RESPONSE, std::memory_order_release);
+
+        // Уведомляем клиента, что ответ готов; будим, только если он уснул
+        slot.completions.fetch_add(1, std::memory_order_seq_cst);
+        if (slot.waiting.load(std::memory_order_seq_cst)) {
+            futexWake(&slot.completions);
+        }
+    }
+
+    // Слот не освобожден и не занят другим процессом, а его владелец жив.
+    // Упавший клиент слот не освобождает - его pid проверяем сами
+    bool sessionAlive(uint32_t channel, uint32_t generation) override {
+        if (channel >= MAX_CLIENTS) {
+            return false;
+        }
+        const ClientSlot& slot = sharedMem->slots[channel];
+        pid_t pid = (pid_t)generation;
+        return slot.state.load(std::memory_order_acquire) != SLOT_FREE && slot.ownerPid == pid &&
+               !(kill(pid, 0) == -1 && errno == ESRCH);
+    }
+
+private:
+    Mailbox& mailbox(uint32_t localId) {
+        return sharedMem->slots[localId / PIPELINE_DEPTH].boxes[localId % PIPELINE_DEPTH];
+    }
+
+    SharedMemory* sharedMem;
+    Message messages[MAX_CLIENTS * PIPELINE_DEPTH];   // Разобранные запросы ящиков (у сервера)
+};
+
+#define MAX_CONNECTIONS 16384   // Соединений сокетного транспорта одновременно
+#define SOCKET_EVENTS 256       // Событий epoll за один вызов
+#define SOCKET_INPUT_SIZE (4 * WIRE_MAX_FRAME)  // Буфер чтения соединения
+#define SOCKET_RING_SHARE 256   // Запросов всех соединений в работе у сервера одновременно
+
+// Сокеты Unix и TCP: один поток на epoll принимает соединения, читает кадры
+// и кладет запросы в то же кольцо, что и клиенты общей памяти. У соединения
+// до PIPELINE_DEPTH запросов в работе; ответы пишутся по мере готовности,
+// клиент сопоставляет их по номеру запроса. Пока все места заняты,
+// следующие кадры остаются в буфере сокета. Всем соединениям вместе в кольце
+// сервера отведено SOCKET_RING_SHARE запросов, остальные ждут в pending.
+class SocketTransport : public Transport {
+public:
+    SocketTransport() : ring(nullptr), onSessionClosed(nullptr), epollFd(-1), wakeFd(-1), unixFd(-1), tcpFd(-1), wakePending(false),
+                        inRing(0) {
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            connections[i] = nullptr;
+        }
+    }
+
+    // Открываем сокеты и запускаем поток epoll; запросы пойдут в requestRing.
+    // tcpAddress - "host:port" (см. splitHostPort); sessionClosed вызывается
+    // потоком epoll при закрытии соединения, через которое вошел игрок
+    bool start(RequestRing* requestRing, const char* unixPath, const std::string& tcpAddress,
+               SessionClosed sessionClosed) {
+        ring = requestRing;
+        onSessionClosed = sessionClosed;
+        completions.init();
+
+        epollFd = epoll_create1(0);
+        wakeFd = eventfd(0, EFD_NONBLOCK);
+        if (epollFd == -1 || wakeFd == -1) {
+            return false;
+        }
+        watch(wakeFd, EPOLLIN, WAKE_TAG);
+
+        unixFd = listenUnix(unixPath);
+        tcpFd = listenTcp(tcpAddress);
+        if (unixFd == -1 && tcpFd == -1) {
+            return false;
+        }
+        if (unixFd != -1) {
+            watch(unixFd, EPOLLIN, UNIX_LISTEN_TAG);
+        }
+        if (tcpFd != -1) {
+            watch(tcpFd, EPOLLIN, TCP_LISTEN_TAG);
+        }
+
+        std::thread(&SocketTransport::run, this).detach();
+        return true;
+    }
+
+    // Кадр уже разобран потоком epoll. Номер игрока в запросе не доверяем:
+    // соединение говорит только от имени игрока, вошедшего через него
+    Message* receive(uint32_t localId) override {
+        Message* msg = message(localId);
+        if (msg == nullptr) {
+            return nullptr;
+        }
+        uint32_t id = localId / PIPELINE_DEPTH;
+        Connection& conn = *connections[id];
+        if (msg->type != Message::LOGIN) {
+            msg->playerId = conn.player.load(std::memory_order_acquire);
+        }
+        msg->session = makeSession(TRANSPORT_SOCKET, id, conn.generation.load(std::memory_order_acquire));
+        return msg;
+    }
+
+    Message* message(uint32_t localId) override {
+        uint32_t id = localId / PIPELINE_DEPTH;
+        if (id >= MAX_CONNECTIONS || connections[id] == nullptr) {
+            return nullptr;
+        }
+        return connections[id]->requests[localId % PIPELINE_DEPTH];
+    }
+
+    void complete(uint32_t localId) override {
+        // Вход удался - дальше запросы соединения идут от имени этого игрока
+        const Message& response = *message(localId);
+        if (response.type == Message::LOGIN_RESPONSE && response.playerId != NO_PLAYER) {
+            connections[localId / PIPELINE_DEPTH]->player.store(response.playerId, std::memory_order_release);
+        }
+
+        while (!completions.push(localId)) {
+            sched_yield(); // поток epoll еще не разобрал прошлые ответы
+        }
+
+        // Будим поток epoll, если его еще никто не разбудил
+        if (!wakePending.exchange(true, std::memory_order_seq_cst)) {
+            uint64_t one = 1;
+            ssize_t n = write(wakeFd, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    // Поколение соединения меняется при его открытии и закрытии
+    bool sessionAlive(uint32_t channel, uint32_t generation) override {
+        if (channel >= MAX_CONNECTIONS || connections[channel] == nullptr) {
+            return false;
+        }
+        return connections[channel]->generation.load(std::memory_order_acquire) == generation;
+    }
+
+private:
+    // Метки событий epoll для служебных дескрипторов (соединения - своими номерами)
+    static const uint64_t WAKE_TAG = MAX_CONNECTIONS;
+    static const uint64_t UNIX_LISTEN_TAG = MAX_CONNECTIONS + 1;
+    static const uint64_t TCP_LISTEN_TAG = MAX_CONNECTIONS + 2;
+
+    struct Connection {
+        int fd;
+        uint32_t busy;            // Маска мест запросов, отданных шардам
+        bool closing;             // Клиент отключился, пока запросы были у шардов
+        std::atomic<PlayerId> player;  // Вошедший через соединение игрок, NO_PLAYER - еще не вошел
+        std::atomic<uint32_t> generation;  // Поколение сессии: +1 при открытии и при закрытии
+        uint8_t in[SOCKET_INPUT_SIZE];  // Прочитанное, но еще не разобранное
+        size_t inStart;
+        size_t inEnd;
+        Message* requests[PIPELINE_DEPTH];  // Запрос, а после обработки - ответ
+        std::vector<uint8_t> out; // Недописанные в сокет ответы
+        size_t outPos;
+    };
+
+    void watch(int fd, uint32_t events, uint64_t tag) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.u64 = tag;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    static int listenUnix(const char* path) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+            return -1;
+        }
+        strcpy(addr.sun_path, path);
+        unlink(path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd == -1) {
+            return -1;
+        }
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+            std::cerr << "Error: Cannot listen on " << path << ": " << strerror(errno) << std::endl;
+            close(fd);
+            return -1;
+        }
+        chmod(path, 0666);
+        return fd;
+    }
+
+    static int listenTcp(const std::string& address) {
+        std::string host, port;
+        splitHostPort(address, host, port);
+
+        struct addrinfo hints;
+        struct addrinfo* result = nullptr;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || result == nullptr) {
+            std::cerr << "Error: Cannot resolve TCP address " << address << std::endl;
+            return -1;
+        }
+
+        int fd = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd != -1) {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, result->ai_addr, result->ai_addrlen) == -1 || listen(fd, SOMAXCONN) == -1) {
+                std::cerr << "Error: Cannot listen on TCP " << address << ": " << strerror(errno) << std::endl;
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(result);
+        return fd;
+    }
+
+    void run() {
+        struct epoll_event events[SOCKET_EVENTS];
+        while (true) {
+            // Запросы, не влезшие в кольцо, пробуем отдать снова - и не спим долго
+            flushPending();
+            int count = epoll_wait(epollFd, events, SOCKET_EVENTS, pending.empty() ? -1 : 1);
+
+            for (int i = 0; i < count; i++) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == WAKE_TAG) {
+                    uint64_t value;
+                    ssize_t n = read(wakeFd, &value, sizeof(value));
+                    (void)n;
+                    wakePending.store(false, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                } else if (tag == UNIX_LISTEN_TAG) {
+                    acceptAll(unixFd, false);
+                } else if (tag == TCP_LISTEN_TAG) {
+                    acceptAll(tcpFd, true);
+                } else {
+                    uint32_t id = (uint32_t)tag;
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                        readRequest(id);
+                    }
+                    if (connections[id] != nullptr && (events[i].events & EPOLLOUT)) {
+                        writeResponse(id);
+                    }
+                }
+            }
+
+            // Ответы шардов (после сброса флага, чтобы не потерять пробуждение)
+            uint32_t done[MAX_CLIENTS];
+            int doneCount;
+            while ((doneCount = completions.popBatch(done, MAX_CLIENTS)) > 0) {
+                for (int i = 0; i < doneCount; i++) {
+                    finishRequest(done[i]);
+                }
+            }
+        }
+    }
+
+    void acceptAll(int listenFd, bool tcp) {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1) {
+                if (errno == EMFILE || errno == ENFILE) {
+                    std::cerr << "Warning: Out of file descriptors, connection refused." << std::endl;
+                }
+                return;
+            }
+            if (freeIds.empty() && nextId >= MAX_CONNECTIONS) {
+                close(fd); // все соединения заняты
+                continue;
+            }
+            if (tcp) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+
+            uint32_t id;
+            if (!freeIds.empty()) {
+                id = freeIds.front();
+                freeIds.pop_front();
+            } else {
+                id = nextId++;
+                connections[id] = new Connection();
+                for (int i = 0; i < PIPELINE_DEPTH; i++) {
+                    connections[id]->requests[i] = new Message();
+                }
+            }
+            Connection& conn = *connections[id];
+            conn.fd = fd;
+            conn.busy = 0;
+            conn.closing = false;
+            conn.player.store(NO_PLAYER, std::memory_order_relaxed);
+            conn.generation.fetch_add(1, std::memory_order_release);
+            conn.inStart = 0;
+            conn.inEnd = 0;
+            conn.out.clear();
+            conn.outPos = 0;
+            watch(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, id);
+        }
+    }
+
+    // Читаем из сокета и отдаем шардам все целые кадры, пока есть свободные места
+    void readRequest(uint32_t id) {
+        Connection& conn = *connections[id];
+        while (conn.fd != -1 && !conn.closing) {
+            if (!parseRequests(id) || conn.busy == (1u << PIPELINE_DEPTH) - 1) {
+                return; // остальное дочитаем, когда освободится место
+            }
+
+            if (conn.inStart > 0) {
+                memmove(conn.in, conn.in + conn.inStart, conn.inEnd - conn.inStart);
+                conn.inEnd -= conn.inStart;
+                conn.inStart = 0;
+            }
+            ssize_t n = read(conn.fd, conn.in + conn.inEnd, SOCKET_INPUT_SIZE - conn.inEnd);
+            if (n > 0) {
+                conn.inEnd += (size_t)n;
+            } else if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+                return;
+            } else {
+                closeConnection(id);
+                return;
+            }
+        }
+    }
+
+    // Разбираем целые кадры из буфера чтения; false - соединение закрыто
+    bool parseRequests(uint32_t id) {
+        Connection& conn = *connections[id];
+        while (conn.inEnd - conn.inStart >= WIRE_HEADER_SIZE && conn.busy != (1u << PIPELINE_DEPTH) - 1) {
+            size_t frameSize = wireFrameSize(conn.in + conn.inStart);
+            if (frameSize == 0) {
+                closeConnection(id); // чужой протокол или другая версия
+                return false;
+            }
+            if (conn.inEnd - conn.inStart < frameSize) {
+                break;
+            }
+
+            int place = __builtin_ctz(~conn.busy);
+            Message& request = *conn.requests[place];
+            if (!decodeMessage(conn.in + conn.inStart, frameSize, request)) {
+                request.type = Message::ERROR;
+            }
+            conn.inStart += frameSize;
+            conn.busy |= 1u << place;
+            submit(makeRequestId(TRANSPORT_SOCKET, id * PIPELINE_DEPTH + place));
+        }
+        return true;
+    }
+
+    void submit(uint32_t requestId) {
+        if (!pending.empty() || !pushToRing(requestId)) {
+            pending.push_back(requestId); // доля кольца занята - отдадим позже
+        }
+    }
+
+    void flushPending() {
+        while (!pending.empty() && pushToRing(pending.front())) {
+            pending.pop_front();
+        }
+    }
+
+    bool pushToRing(uint32_t requestId) {
+        if (inRing >= SOCKET_RING_SHARE || !ring->push(requestId)) {
+            return false;
+        }
+        inRing++;
+        return true;
+    }
+
+    // Ответ готов: пишем его и читаем следующий запрос, если он уже пришел
+    void finishRequest(uint32_t localId) {
+        uint32_t id = localId / PIPELINE_DEPTH;
+        int place = localId % PIPELINE_DEPTH;
+        Connection& conn = *connections[id];
+        conn.busy &= ~(1u << place);
+        inRing--;
+        if (conn.closing) {
+            if (conn.busy == 0) {
+                conn.closing = false;
+                release(id);
+            }
+            return;
+        }
+
+        size_t used = conn.out.size();
+        conn.out.resize(used + WIRE_MAX_FRAME);
+        conn.out.resize(used + encodeResponse(*conn.requests[place], conn.out.data() + used, WIRE_MAX_FRAME));
+        writeResponse(id);
+        if (conn.fd != -1) {
+            readRequest(id);
+        }
+    }
+
+    void writeResponse(uint32_t id) {
+        Connection& conn = *connections[id];
+        while (conn.fd != -1 && conn.outPos < conn.out.size()) {
+            ssize_t n = write(conn.fd, conn.out.data() + conn.outPos, conn.out.size() - conn.outPos);
+            if (n > 0) {
+                conn.outPos += (size_t)n;
+            } else if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+                return; // допишем по EPOLLOUT
+            } else {
+                closeConnection(id);
+                return;
+            }
+        }
+        conn.out.clear();
+        conn.outPos = 0;
+    }
+
+    void closeConnection(uint32_t id) {
+        Connection& conn = *connections[id];
+
+        // Сессия кончилась: вошедший через нее игрок больше не в сети
+        uint32_t generation = conn.generation.fetch_add(1, std::memory_order_acq_rel);
+        PlayerId player = conn.player.exchange(NO_PLAYER, std::memory_order_acq_rel);
+        if (player != NO_PLAYER && onSessionClosed != nullptr) {
+            onSessionClosed(player, makeSession(TRANSPORT_SOCKET, id, generation));
+        }
+
+        if (conn.busy != 0) {
+            conn.closing = true; // номер освободим, когда шарды ответят
+            close(conn.fd);
+            conn.fd = -1;
+            return;
+        }
+        release(id);
+    }
+
+    void release(uint32_t id) {
+        Connection& conn = *connections[id];
+        if (conn.fd != -1) {
+            close(conn.fd);
+            conn.fd = -1;
+        }
+        conn.out.clear();
+        conn.outPos = 0;
+        freeIds.push_back(id);
+    }
+
+    RequestRing* ring;             // Кольцо запросов сервера
+    SessionClosed onSessionClosed;
+    RequestRing completions;       // Номера соединений с готовым ответом (от шардов)
+    int epollFd;
+    int wakeFd;                    // eventfd: шарды будят поток epoll
+    int unixFd;
+    int tcpFd;
+    std::atomic<bool> wakePending;
+    Connection* connections[MAX_CONNECTIONS];
+    std::deque<uint32_t> freeIds;  // Освобожденные номера соединений
+    uint32_t nextId = 0;
+    std::deque<uint32_t> pending;  // Запросы, ждущие места в кольце
+    uint32_t inRing;               // Запросов соединений у сервера (не больше SOCKET_RING_SHARE)
+};
+
+#endif // TRANSPORT_H
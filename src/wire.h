@@ -0,0 +1,437 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "common.h"
+#include "net.h"
+
+// Двоичный формат сообщения между клиентом и сервером (общая память и сокеты).
+// Кадр: заголовок WIRE_HEADER_SIZE байт - версия, тип сообщения, длина полезной
+// нагрузки и номер запроса (little-endian) - и поля. Поле - байт тега (вид значения в старших
+// битах, номер поля в младших) и значение: число varint или байты с длиной.
+// Нулевые поля (нули, пустые строки и доски) не передаются, неизвестные поля
+// пропускаются по виду значения - новые поля не ломают старых клиентов.
+
+#define WIRE_VERSION 2
+
+// Вид значения поля
+enum WireKind {
+    WIRE_VARINT = 0,   // Целое varint (знаковые - zigzag)
+    WIRE_BYTES = 1     // Длина varint, затем байты
+};
+
+// Номера полей Message
+enum WireField {
+    WIRE_USERNAME = 1,
+    WIRE_DATA = 2,
+    WIRE_NEW_USER = 3,
+    WIRE_GAME_NAME = 4,
+    WIRE_GAME_HANDLE = 5,
+    WIRE_X = 6,
+    WIRE_Y = 7,
+    WIRE_SHIP_LENGTH = 8,
+    WIRE_SHIP_HORIZONTAL = 9,
+    WIRE_HIT_RESULT = 10,
+    WIRE_GAME_STATE = 11,
+    WIRE_OPPONENT = 12,
+    WIRE_FLEET = 13,        // Корабли подряд: x, y, длина, ориентация (varint)
+    WIRE_FLEET_SIZE = 14,
+    WIRE_MARK_READY = 15,
+    WIRE_PLAYER = 16,
+    WIRE_OWN_CELLS = 17,    // Клетки по 4 бита, хвост из пустых клеток не передается
+    WIRE_ENEMY_CELLS = 18,
+    WIRE_EVENT_SEQ = 19,
+    WIRE_EVENTS = 20,       // Ходы подряд по 4 байта: стрелок, x, y, результат; номера идут до eventSeq
+    WIRE_EVENTS_LOST = 21,
+    WIRE_PLAYER_ID = 22,    // Номер игрока + 1: "нет номера" (NO_PLAYER) не передается
+    WIRE_RULES = 23         // Вариант игры; классика (0) не передается, доски - по размеру варианта
+};
+
+#define WIRE_TAG(kind, field) ((uint8_t)(((kind) << 6) | (field)))
+
+// Знаковые числа в varint: 0, -1, 1, -2... -> 0, 1, 2, 3...
+inline uint64_t wireZigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t wireUnzigzag(uint64_t value) {
+    return (int32_t)((uint32_t)value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Запись кадра в буфер; при нехватке места ok сбрасывается
+struct WireWriter {
+    uint8_t* out;
+    size_t capacity;
+    size_t pos;
+    bool ok;
+
+    WireWriter(uint8_t* out, size_t capacity) : out(out), capacity(capacity), pos(0), ok(true) {}
+
+    void byte(uint8_t value) {
+        if (pos >= capacity) {
+            ok = false;
+            return;
+        }
+        out[pos++] = value;
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            byte((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        byte((uint8_t)value);
+    }
+
+    void bytes(const void* data, size_t size) {
+        if (size > capacity - pos) {
+            ok = false;
+            return;
+        }
+        memcpy(out + pos, data, size);
+        pos += size;
+    }
+
+    void uintField(WireField field, uint64_t value) {
+        if (value != 0) {
+            byte(WIRE_TAG(WIRE_VARINT, field));
+            varint(value);
+        }
+    }
+
+    void intField(WireField field, int32_t value) {
+        uintField(field, wireZigzag(value));
+    }
+
+    void stringField(WireField field, const char* value, size_t maxSize) {
+        size_t size = strnlen(value, maxSize - 1);
+        if (size != 0) {
+            byte(WIRE_TAG(WIRE_BYTES, field));
+            varint(size);
+            bytes(value, size);
+        }
+    }
+
+    // Клетки доски boardSize x boardSize построчно
+    void cellsField(WireField field, const CellState cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int boardSize) {
+        int count = boardSize * boardSize;
+        while (count > 0 && cells[(count - 1) / boardSize][(count - 1) % boardSize] == EMPTY) {
+            count--;
+        }
+        if (count == 0) {
+            return;
+        }
+
+        size_t size = (size_t)(count + 1) / 2;
+        byte(WIRE_TAG(WIRE_BYTES, field));
+        varint(size);
+        for (int i = 0; i < count; i += 2) {
+            uint8_t low = (uint8_t)cells[i / boardSize][i % boardSize];
+            uint8_t high = i + 1 < count ? (uint8_t)cells[(i + 1) / boardSize][(i + 1) % boardSize] : 0;
+            byte((uint8_t)(low | (high << 4)));
+        }
+    }
+};
+
+// Чтение кадра; при выходе за границы ok сбрасывается
+struct WireReader {
+    const uint8_t* in;
+    size_t size;
+    size_t pos;
+    bool ok;
+
+    WireReader(const uint8_t* in, size_t size) : in(in), size(size), pos(0), ok(true) {}
+
+    bool atEnd() const {
+        return pos >= size;
+    }
+
+    uint8_t byte() {
+        if (pos >= size) {
+            ok = false;
+            return 0;
+        }
+        return in[pos++];
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && ok; shift += 7) {
+            uint8_t b = byte();
+            value |= (uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    int32_t zigzag() {
+        return wireUnzigzag(varint());
+    }
+
+    // Байтовое значение: начало и длина
+    const uint8_t* bytes(size_t& length) {
+        length = (size_t)varint();
+        if (!ok || length > size - pos) {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t* start = in + pos;
+        pos += length;
+        return start;
+    }
+};
+
+inline void wireReadString(const uint8_t* value, size_t length, char* out, size_t outSize) {
+    size_t n = length < outSize - 1 ? length : outSize - 1;
+    memcpy(out, value, n);
+    out[n] = '\0';
+}
+
+inline bool wireReadCells(const uint8_t* value, size_t length, CellState cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE],
+                          int boardSize) {
+    size_t count = (size_t)boardSize * boardSize;
+    if (length > (count + 1) / 2) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        uint8_t low = value[i] & 0x0f;
+        uint8_t high = value[i] >> 4;
+        if (low > DESTROYED || high > DESTROYED || (2 * i + 1 >= count && high != EMPTY)) {
+            return false;
+        }
+        cells[2 * i / boardSize][2 * i % boardSize] = (CellState)low;
+        if (2 * i + 1 < count) {
+            cells[(2 * i + 1) / boardSize][(2 * i + 1) % boardSize] = (CellState)high;
+        }
+    }
+    return true;
+}
+
+// Полная длина кадра по заголовку; 0 - заголовок неверен
+inline size_t wireFrameSize(const uint8_t* header) {
+    size_t length = header[2] | ((size_t)header[3] << 8);
+    if (header[0] != WIRE_VERSION || length > WIRE_MAX_FRAME - WIRE_HEADER_SIZE) {
+        return 0;
+    }
+    return WIRE_HEADER_SIZE + length;
+}
+
+// Кодируем сообщение в кадр; возвращает размер кадра, 0 - не влезло в capacity
+// (или неизвестный вариант игры)
+inline size_t encodeMessage(const Message& msg, uint8_t* frame, size_t capacity) {
+    if (capacity < WIRE_HEADER_SIZE) {
+        return 0;
+    }
+    WireWriter w(frame + WIRE_HEADER_SIZE, capacity - WIRE_HEADER_SIZE);
+
+    w.stringField(WIRE_USERNAME, msg.username, sizeof(msg.username));
+    w.uintField(WIRE_PLAYER_ID, (uint32_t)(msg.playerId + 1));
+    w.stringField(WIRE_DATA, msg.data, sizeof(msg.data));
+    w.uintField(WIRE_NEW_USER, msg.newUser);
+    w.stringField(WIRE_GAME_NAME, msg.gameName, sizeof(msg.gameName));
+    w.uintField(WIRE_GAME_HANDLE, msg.gameHandle);
+    w.intField(WIRE_X, msg.x);
+    w.intField(WIRE_Y, msg.y);
+    w.intField(WIRE_SHIP_LENGTH, msg.shipLength);
+    w.uintField(WIRE_SHIP_HORIZONTAL, msg.shipHorizontal);
+    w.intField(WIRE_HIT_RESULT, msg.hitResult);
+    w.uintField(WIRE_GAME_STATE, (uint32_t)msg.gameState);
+    w.stringField(WIRE_OPPONENT, msg.opponent, sizeof(msg.opponent));
+    w.uintField(WIRE_RULES, (uint32_t)msg.rules);
+
+    int fleetSize = msg.fleetSize < 0 ? 0 : (msg.fleetSize > MAX_FLEET_SHIPS ? MAX_FLEET_SHIPS : msg.fleetSize);
+    if (fleetSize > 0) {
+        // Размер флота в байтах известен только после записи - пишем во временный буфер
+        uint8_t fleet[MAX_FLEET_SHIPS * 16];
+        WireWriter f(fleet, sizeof(fleet));
+        for (int i = 0; i < fleetSize; i++) {
+            const ShipPlacement& ship = msg.fleet[i];
+            f.varint(wireZigzag(ship.x));
+            f.varint(wireZigzag(ship.y));
+            f.varint(wireZigzag(ship.length));
+            f.varint(ship.horizontal);
+        }
+        w.byte(WIRE_TAG(WIRE_BYTES, WIRE_FLEET));
+        w.varint(f.pos);
+        w.bytes(fleet, f.pos);
+    }
+    w.intField(WIRE_FLEET_SIZE, msg.fleetSize);
+    w.uintField(WIRE_MARK_READY, msg.markReady);
+    w.intField(WIRE_PLAYER, msg.player);
+    if (!isValidRules(msg.rules)) {
+        return 0;
+    }
+    int boardSize = g_rulesInfo[msg.rules].boardSize;
+    w.cellsField(WIRE_OWN_CELLS, msg.ownCells, boardSize);
+    w.cellsField(WIRE_ENEMY_CELLS, msg.enemyCells, boardSize);
+    w.uintField(WIRE_EVENT_SEQ, msg.eventSeq);
+    int eventCount = msg.eventCount < 0 ? 0 : (msg.eventCount > GAME_EVENT_RING ? GAME_EVENT_RING : msg.eventCount);
+    if (eventCount > 0) {
+        w.byte(WIRE_TAG(WIRE_BYTES, WIRE_EVENTS));
+        w.varint((uint64_t)eventCount * 4);
+        for (int i = 0; i < eventCount; i++) {
+            const MoveEvent& event = msg.events[i];
+            w.byte(event.shooter);
+            w.byte(event.x);
+            w.byte(event.y);
+            w.byte((uint8_t)event.result);
+        }
+    }
+    w.uintField(WIRE_EVENTS_LOST, msg.eventsLost);
+
+    if (!w.ok || w.pos > WIRE_MAX_FRAME - WIRE_HEADER_SIZE) {
+        return 0;
+    }
+    frame[0] = WIRE_VERSION;
+    frame[1] = (uint8_t)msg.type;
+    frame[2] = (uint8_t)w.pos;
+    frame[3] = (uint8_t)(w.pos >> 8);
+    for (int i = 0; i < 4; i++) {
+        frame[4 + i] = (uint8_t)(msg.requestId >> (8 * i));
+    }
+    return WIRE_HEADER_SIZE + w.pos;
+}
+
+// Разбираем кадр (size - сколько байт доступно); false - кадр поврежден
+inline bool decodeMessage(const uint8_t* frame, size_t size, Message& msg) {
+    memset(&msg, 0, sizeof(msg));
+    if (size < WIRE_HEADER_SIZE) {
+        return false;
+    }
+    size_t frameSize = wireFrameSize(frame);
+    if (frameSize == 0 || frameSize > size) {
+        return false;
+    }
+    msg.type = (Message::Type)frame[1];
+    msg.playerId = NO_PLAYER;
+    msg.requestId = frame[4] | ((uint32_t)frame[5] << 8) | ((uint32_t)frame[6] << 16) | ((uint32_t)frame[7] << 24);
+
+    // Доски разбираем в конце, когда известен вариант игры (их размер)
+    const uint8_t* ownCells = nullptr;
+    const uint8_t* enemyCells = nullptr;
+    size_t ownLength = 0;
+    size_t enemyLength = 0;
+    uint64_t rules = RULES_CLASSIC;
+
+    WireReader r(frame + WIRE_HEADER_SIZE, frameSize - WIRE_HEADER_SIZE);
+    while (r.ok && !r.atEnd()) {
+        uint8_t tag = r.byte();
+        uint8_t field = tag & 0x3f;
+
+        if ((tag >> 6) == WIRE_VARINT) {
+            uint64_t value = r.varint();
+            int32_t signedValue = wireUnzigzag(value);
+            switch (field) {
+                case WIRE_NEW_USER: msg.newUser = value != 0; break;
+                case WIRE_GAME_HANDLE: msg.gameHandle = value; break;
+                case WIRE_X: msg.x = signedValue; break;
+                case WIRE_Y: msg.y = signedValue; break;
+                case WIRE_SHIP_LENGTH: msg.shipLength = signedValue; break;
+                case WIRE_SHIP_HORIZONTAL: msg.shipHorizontal = value != 0; break;
+                case WIRE_HIT_RESULT: msg.hitResult = signedValue; break;
+                case WIRE_GAME_STATE: msg.gameState = (GameState)value; break;
+                case WIRE_FLEET_SIZE: msg.fleetSize = signedValue; break;
+                case WIRE_MARK_READY: msg.markReady = value != 0; break;
+                case WIRE_PLAYER: msg.player = signedValue; break;
+                case WIRE_EVENT_SEQ: msg.eventSeq = (uint32_t)value; break;
+                case WIRE_EVENTS_LOST: msg.eventsLost = value != 0; break;
+                case WIRE_PLAYER_ID: msg.playerId = (PlayerId)value - 1; break;
+                case WIRE_RULES: rules = value; break;
+                default: break; // неизвестное поле
+            }
+        } else if ((tag >> 6) == WIRE_BYTES) {
+            size_t length;
+            const uint8_t* value = r.bytes(length);
+            if (!r.ok) {
+                break;
+            }
+            switch (field) {
+                case WIRE_USERNAME: wireReadString(value, length, msg.username, sizeof(msg.username)); break;
+                case WIRE_DATA: wireReadString(value, length, msg.data, sizeof(msg.data)); break;
+                case WIRE_GAME_NAME: wireReadString(value, length, msg.gameName, sizeof(msg.gameName)); break;
+                case WIRE_OPPONENT: wireReadString(value, length, msg.opponent, sizeof(msg.opponent)); break;
+                case WIRE_FLEET:
+                    {
+                        WireReader f(value, length);
+                        int count = 0;
+                        while (f.ok && !f.atEnd() && count < MAX_FLEET_SHIPS) {
+                            ShipPlacement& ship = msg.fleet[count++];
+                            ship.x = f.zigzag();
+                            ship.y = f.zigzag();
+                            ship.length = f.zigzag();
+                            ship.horizontal = f.varint() != 0;
+                        }
+                        if (!f.ok) {
+                            return false;
+                        }
+                    }
+                    break;
+                case WIRE_OWN_CELLS:
+                    ownCells = value;
+                    ownLength = length;
+                    break;
+                case WIRE_ENEMY_CELLS:
+                    enemyCells = value;
+                    enemyLength = length;
+                    break;
+                case WIRE_EVENTS:
+                    if (length % 4 != 0 || length / 4 > GAME_EVENT_RING) {
+                        return false;
+                    }
+                    msg.eventCount = (int)(length / 4);
+                    for (int i = 0; i < msg.eventCount; i++) {
+                        MoveEvent& event = msg.events[i];
+                        event.shooter = value[4 * i];
+                        event.x = value[4 * i + 1];
+                        event.y = value[4 * i + 2];
+                        event.result = (int8_t)value[4 * i + 3];
+                    }
+                    break;
+                default: break; // неизвестное поле
+            }
+        } else {
+            return false; // вид значения, который не умеем пропустить
+        }
+    }
+    if (rules >= RULES_COUNT) {
+        return false; // вариант, которого мы не знаем: досок не разобрать
+    }
+    msg.rules = (int)rules;
+    int boardSize = g_rulesInfo[msg.rules].boardSize;
+    if ((ownCells != nullptr && !wireReadCells(ownCells, ownLength, msg.ownCells, boardSize)) ||
+        (enemyCells != nullptr && !wireReadCells(enemyCells, enemyLength, msg.enemyCells, boardSize))) {
+        return false;
+    }
+
+    // Номера ходов не передаются: они идут подряд и заканчиваются на eventSeq
+    for (int i = 0; i < msg.eventCount; i++) {
+        msg.events[i].seq = msg.eventSeq - (uint32_t)(msg.eventCount - 1 - i);
+    }
+    return r.ok;
+}
+
+// Блокирующий обмен кадрами по сокету (драйверы проверок).
+// Пишем сообщение в соединение; false - кадр не собрался или соединение закрыто
+inline bool sendMessage(int fd, const Message& msg) {
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t size = encodeMessage(msg, frame, sizeof(frame));
+    return size != 0 && writeAll(fd, frame, size);
+}
+
+// Читаем одно сообщение; false - соединение закрыто или кадр поврежден
+inline bool readMessage(int fd, Message& msg) {
+    uint8_t frame[WIRE_MAX_FRAME];
+    if (!readAll(fd, frame, WIRE_HEADER_SIZE)) {
+        return false;
+    }
+    size_t size = wireFrameSize(frame);
+    return size != 0 && readAll(fd, frame + WIRE_HEADER_SIZE, size - WIRE_HEADER_SIZE) &&
+           decodeMessage(frame, size, msg);
+}
+
+#endif // WIRE_H